@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Helpers shared by the on-disk caches: compiled Hyperscan databases, the result cache
+// and the known-file index.
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+
+// 64-bit FNV-1a, chained through `h` (start from FNV_OFFSET). Keys cache files and their
+// entries; stable across runs and platforms of the same endianness.
+inline uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+// Strings are length-prefixed so that ("AB","C") and ("A","BC") hash differently.
+inline uint64_t fnv1a(uint64_t h, const std::string& s) {
+    uint64_t len = s.size();
+    return fnv1a(fnv1a(h, &len, sizeof(len)), s.data(), s.size());
+}
+
+// Write-then-rename: a cache file is written under this name, unique per process, thread
+// and call, next to `target` and then renamed over it, so a concurrent reader (thread or
+// process) sees either the old file or the new one, whole, never a partial write.
+inline std::filesystem::path temp_path_for(const std::filesystem::path& target) {
+#ifdef _WIN32
+    const long long pid = _getpid();
+#else
+    const long long pid = getpid();
+#endif
+    std::filesystem::path tmp = target;
+    tmp += ".tmp" + std::to_string(pid) + "."
+         + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())
+                          ^ static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    return tmp;
+}
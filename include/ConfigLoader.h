@@ -2,10 +2,12 @@
 
 #include <vector>
 #include <string>
+#include <map>
 #include <set>
 #include <fstream>
 #include <iostream>
 #include <cctype>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 #include "Scanner.h"
 
@@ -68,6 +70,30 @@ public:
                     def.deduct_from = item["deduct_from"].get<std::string>();
                 }
 
+                def.max_gap = read_bound(item, "max_gap", def.name);
+                def.min_length = read_bound(item, "min_length", def.name);
+                def.max_offset = read_bound(item, "max_offset", def.name);
+                if (def.max_gap > SignatureDefinition::MAX_GAP) {
+                    std::cerr << "[ConfigLoader] Warning: '" << def.name << "' max_gap above "
+                              << SignatureDefinition::MAX_GAP << ", ignored\n";
+                    def.max_gap = 0;
+                }
+                if (def.windowed() && (def.type != SignatureType::BINARY || def.hex_head.empty()
+                                       || (def.hex_tail.empty() && def.text_pattern.empty()))) {
+                    std::cerr << "[ConfigLoader] Warning: '" << def.name
+                              << "' max_gap/min_length need hex_head and hex_tail or text_pattern, ignored\n";
+                    def.max_gap = def.min_length = 0;
+                }
+
+                def.offset = read_offset(item, def.name);
+                if (def.anchored() && (def.type != SignatureType::BINARY || def.hex_head.empty()
+                                       || !def.hex_tail.empty() || !def.text_pattern.empty()
+                                       || def.windowed() || def.max_offset)) {
+                    std::cerr << "[ConfigLoader] Warning: '" << def.name
+                              << "' offset needs a binary signature of hex_head alone, ignored\n";
+                    def.offset = SignatureDefinition::ANYWHERE;
+                }
+
                 sigs.push_back(def);
             }
 
@@ -80,12 +106,25 @@ public:
                 }
             }
             // Validate deduct_from references
+            std::set<std::string> related;
             for (const auto& s : sigs) {
                 if (!s.deduct_from.empty() && names.find(s.deduct_from) == names.end()) {
                     std::cerr << "[ConfigLoader] Warning: '" << s.name
                               << "' references deduct_from '" << s.deduct_from
                               << "' which does not exist\n";
                 }
+                if (!s.deduct_from.empty()) {
+                    related.insert(s.name);
+                    related.insert(s.deduct_from);
+                }
+            }
+            // Deduction needs match positions; an anchored signature has none to compare.
+            for (auto& s : sigs) {
+                if (s.anchored() && related.count(s.name)) {
+                    std::cerr << "[ConfigLoader] Warning: '" << s.name
+                              << "' is in a deduct_from relation, offset ignored\n";
+                    s.offset = SignatureDefinition::ANYWHERE;
+                }
             }
         }
         catch (const std::exception& e) {
@@ -94,7 +133,70 @@ public:
         return sigs;
     }
 
+    // Groups the subtypes that repeat a magic (see SignatureTree). A group needs at least
+    // two members: the subtypes plus the signature that is the bare magic, if any.
+    static SignatureTree build_tree(const std::vector<SignatureDefinition>& sigs) {
+        SignatureTree tree;
+        tree.group_of.assign(sigs.size(), -1);
+        // Bounded subtypes are evaluated on their own: the first magic is not enough.
+        auto is_child = [](const SignatureDefinition& s) {
+            return s.type == SignatureType::BINARY && !s.hex_head.empty()
+                && s.hex_tail.empty() && !s.text_pattern.empty()
+                && !s.windowed() && s.max_offset == 0;
+        };
+        auto upper = [](std::string hex) {
+            for (auto& c : hex) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            return hex;
+        };
+
+        std::map<std::string, SignatureTree::Group> by_head;
+        for (uint32_t i = 0; i < sigs.size(); ++i) {
+            if (!is_child(sigs[i])) continue;
+            auto& g = by_head[upper(sigs[i].hex_head)];
+            g.hex_head = upper(sigs[i].hex_head);
+            g.children.push_back(i);
+        }
+        for (uint32_t i = 0; i < sigs.size(); ++i) {
+            const auto& s = sigs[i];
+            if (is_child(s) || s.type != SignatureType::BINARY || s.hex_head.empty()) continue;
+            auto it = by_head.find(upper(s.hex_head));
+            if (it == by_head.end()) continue;
+            // Prefer the signature the subtypes deduct from.
+            const bool named = s.name == sigs[it->second.children.front()].deduct_from;
+            if (it->second.parent < 0 || named) it->second.parent = static_cast<int>(i);
+        }
+        for (auto& [head, g] : by_head) {
+            if (g.children.size() + (g.parent >= 0 ? 1 : 0) < 2) continue;
+            for (uint32_t c : g.children) tree.group_of[c] = static_cast<int>(tree.groups.size());
+            tree.groups.push_back(std::move(g));
+        }
+        return tree;
+    }
+
 private:
+    // Non-negative integer field, 0 when absent or invalid (with a warning).
+    static uint64_t read_bound(const nlohmann::json& item, const char* field, const std::string& sig_name) {
+        if (!item.contains(field)) return 0;
+        const auto& v = item[field];
+        if (!v.is_number_unsigned()) {
+            std::cerr << "[ConfigLoader] Warning: '" << sig_name << "' " << field
+                      << " must be a non-negative integer, ignored\n";
+            return 0;
+        }
+        return v.get<uint64_t>();
+    }
+
+    // "offset": an integer (negative: from the end) or "anywhere" (the default).
+    static int64_t read_offset(const nlohmann::json& item, const std::string& sig_name) {
+        if (!item.contains("offset")) return SignatureDefinition::ANYWHERE;
+        const auto& v = item["offset"];
+        if (v.is_number_integer() && v.get<int64_t>() != SignatureDefinition::ANYWHERE) return v.get<int64_t>();
+        if (v.is_string() && v.get<std::string>() == "anywhere") return SignatureDefinition::ANYWHERE;
+        std::cerr << "[ConfigLoader] Warning: '" << sig_name
+                  << "' offset must be an integer or \"anywhere\", ignored\n";
+        return SignatureDefinition::ANYWHERE;
+    }
+
     static bool validate_hex(const std::string& hex, const std::string& sig_name, const char* field) {
         if (hex.empty()) return true;
         if (hex.length() % 2 != 0) {
@@ -103,6 +205,7 @@ private:
             return false;
         }
         for (size_t i = 0; i < hex.length(); ++i) {
+            if (hex[i] == '?' && hex[i ^ 1] == '?') continue; // "??": any byte
             if (!std::isxdigit(static_cast<unsigned char>(hex[i]))) {
                 std::cerr << "[ConfigLoader] Warning: '" << sig_name << "' " << field
                           << " has non-hex char at pos " << i << "\n";
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Scanner.h"
+
+// XXH64 of a buffer: a fast non-cryptographic hash, several GB/s per core, so hashing a
+// file costs a small fraction of scanning it.
+inline uint64_t content_hash(const void* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t P1 = 0x9E3779B185EBCA87ull, P2 = 0xC2B2AE3D27D4EB4Full, P3 = 0x165667B19E3779F9ull,
+                       P4 = 0x85EBCA77C2B2AE63ull, P5 = 0x27D4EB2F165667C5ull;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+    auto read32 = [](const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; };
+    auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; };
+    auto merge = [&](uint64_t acc, uint64_t v) { return (acc ^ round(0, v)) * P1 + P4; };
+
+    const auto* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        for (const unsigned char* limit = end - 32; p <= limit; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    }
+    else {
+        h = seed + P5;
+    }
+    h += size;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p) h = rotl(h ^ (*p * P5), 11) * P1;
+    h ^= h >> 33; h *= P2;
+    h ^= h >> 29; h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Per-run map from file content (hash + size) to the counts it produced, so identical
+// files are scanned once and every later copy reuses the first result. Sharded by hash;
+// each shard has its own mutex, so workers rarely contend.
+//
+// A copy that arrives while the first one is still being scanned is scanned as well
+// rather than waiting for it: no worker ever blocks on another.
+class ContentDedup {
+public:
+    enum class Claim {
+        REUSED,      // identical content already scanned: its counts were added to `stats`
+        FIRST,       // first copy: scan it, then publish() the counts
+        IN_PROGRESS  // first copy is still being scanned: scan this one too, no publish()
+    };
+
+    explicit ContentDedup(std::shared_ptr<const SignatureNames> names) : m_names(std::move(names)) {}
+
+    Claim acquire(uint64_t hash, uint64_t size, ScanStats& stats) {
+        Shard& shard = m_shards[hash >> 58]; // top bits: the map's buckets use the low ones
+        std::vector<std::pair<uint32_t, int32_t>> hits;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto [it, inserted] = shard.map.try_emplace(Key{hash, size});
+            if (inserted) return Claim::FIRST;
+            if (!it->second.ready) return Claim::IN_PROGRESS;
+            hits = it->second.hits;
+        }
+        stats.bind(m_names);
+        for (const auto& [id, n] : hits) stats.hit(id, n);
+        m_reused.fetch_add(1, std::memory_order_relaxed);
+        m_bytes_skipped.fetch_add(size, std::memory_order_relaxed);
+        return Claim::REUSED;
+    }
+
+    // `stats` must hold the counts of that one file. Counts outside this id space cannot
+    // be replayed, so such a file is forgotten and later copies are scanned.
+    void publish(uint64_t hash, uint64_t size, const ScanStats& stats) {
+        std::vector<std::pair<uint32_t, int32_t>> hits;
+        const bool replayable = stats.names == m_names && stats.counts.empty();
+        if (replayable) {
+            for (size_t id = 0; id < stats.hits.size(); ++id)
+                if (stats.hits[id] != 0) hits.emplace_back(static_cast<uint32_t>(id), stats.hits[id]);
+        }
+        Shard& shard = m_shards[hash >> 58];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!replayable) {
+            shard.map.erase(Key{hash, size});
+            return;
+        }
+        Entry& e = shard.map[Key{hash, size}];
+        e.hits = std::move(hits);
+        e.ready = true;
+    }
+
+    // The FIRST copy could not be scanned: forget the claim, so the next copy is scanned
+    // and published in its place.
+    void release(uint64_t hash, uint64_t size) {
+        Shard& shard = m_shards[hash >> 58];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(Key{hash, size});
+        if (it != shard.map.end() && !it->second.ready) shard.map.erase(it);
+    }
+
+    size_t reused_files() const { return m_reused.load(std::memory_order_relaxed); }
+    uint64_t bytes_skipped() const { return m_bytes_skipped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t SHARDS = 64; // indexed by the top 6 bits of the hash
+
+    struct Key {
+        uint64_t hash;
+        uint64_t size;
+        bool operator==(const Key& o) const { return hash == o.hash && size == o.size; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return static_cast<size_t>(k.hash ^ (k.size * 0x9E3779B97F4A7C15ull)); }
+    };
+    struct Entry {
+        bool ready = false;
+        std::vector<std::pair<uint32_t, int32_t>> hits; // non-zero counters only
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> map;
+    };
+
+    std::shared_ptr<const SignatureNames> m_names;
+    std::array<Shard, SHARDS> m_shards;
+    std::atomic<size_t> m_reused{0};
+    std::atomic<uint64_t> m_bytes_skipped{0};
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <functional>
+
+// A file found by DirWalker, with the metadata of the single stat() done during traversal.
+// The scan path takes the size from here instead of stat'ing the file again.
+struct FileEntry {
+    std::string path;
+    uint64_t size = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;  // 0 where the platform has no inode numbers
+    int64_t mtime = 0;   // seconds since epoch
+};
+
+// Parallel recursive directory walker. Directories are shared between `threads` workers
+// (the calling thread is one of them), so wide trees are listed concurrently. On Linux
+// each directory is opened with openat() relative to its parent's descriptor, which stays
+// open while its subdirectories are queued, and read with getdents64(); every file is
+// stat'ed exactly once with fstatat() relative to the open directory. Elsewhere
+// std::filesystem is used.
+// Symlinks are not followed and unreadable directories are skipped.
+class DirWalker {
+public:
+    // Invoked concurrently from the walker threads for every regular file.
+    using Callback = std::function<void(FileEntry&&)>;
+
+    // Walks `root` (a directory, or a single regular file) and returns the number of files
+    // reported.
+    static size_t walk(const std::string& root, unsigned threads, const Callback& emit);
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Scanner.h"
+
+// -e auto: which engine gets through this run fastest. Each candidate is prepared and
+// timed on a sample of the target (a few MB from the first files found); the estimate is
+// its prepare time plus its sample scan time scaled up to the bytes the run will read, so
+// compile cost decides small runs and throughput decides large ones. The winner is kept
+// in the cache directory per signature set (signature_set_hash) and mode (scan or
+// classify), so only the first run over a set pays for the trials.
+class EngineTuner {
+public:
+    struct Trial {
+        EngineType engine;
+        std::unique_ptr<Scanner> scanner; // prepared; reused as the run's engine if it wins
+        double prepare_ms = 0;
+        double scan_ms = 0;               // the faster of two passes over the sample
+        bool ok = false;                  // prepared with a usable signature table
+    };
+
+    // Engines -e auto chooses from (LITERAL is RE2 with its kernel fixed, so not a separate one).
+    static const std::vector<EngineType>& candidates();
+
+    // Prepares each of `engines` and times scan() (or classify()) over every buffer of `sample`.
+    static std::vector<Trial> measure(const std::vector<SignatureDefinition>& sigs,
+                                      const std::vector<std::string>& sample, const std::string& cache_dir,
+                                      bool classify, const std::vector<EngineType>& engines = candidates());
+
+    // Index of the trial with the least prepare_ms + scale * scan_ms among those ok, where
+    // `scale` is the run's bytes over the sample's; trials.size() when none is.
+    static size_t pick(const std::vector<Trial>& trials, double scale);
+
+    // The -e keyword of an engine ("hs", "re2", ...) and back.
+    static std::string key(EngineType engine);
+    static bool from_key(const std::string& key, EngineType& engine);
+
+    // Choice remembered for a signature set in scan or classify mode; false when there is
+    // none (or it is unreadable).
+    static bool load(const std::string& dir, uint64_t sig_hash, bool classify, EngineType& engine);
+    static bool save(const std::string& dir, uint64_t sig_hash, bool classify, EngineType engine);
+};
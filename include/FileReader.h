@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "DirWalker.h"
+
+enum class IoBackend {
+    MMAP,   // mmap per file, madvise(SEQUENTIAL) and a huge-page hint for large files
+    PREAD,  // pread into a buffer reused for every file the worker reads
+    URING   // io_uring: a batch of files in flight at once (Linux; otherwise PREAD)
+};
+
+// Whole-file reads for the scan workers. One reader per worker thread: it owns the
+// buffers (and the io_uring ring) it reuses across files, so it is not thread-safe.
+class FileReader {
+public:
+    // Data is valid only during the call.
+    using Consume = std::function<void(const FileEntry& file, const char* data, size_t size)>;
+    using Fail = std::function<void(const FileEntry& file, const std::string& error)>;
+
+    // Files above this size are mapped whatever the backend: copying them into a buffer
+    // costs more than the page faults it saves.
+    static constexpr size_t MAX_BUFFERED_BYTES = 64 * 1024 * 1024;
+
+    virtual ~FileReader() = default;
+    virtual std::string name() const = 0;
+
+    // How many files read() should be given at once to keep the device busy.
+    virtual size_t batch_size() const { return 1; }
+
+    // Reads every file whole (sizes come from FileEntry) and calls `consume` or `fail`
+    // exactly once per file on the calling thread, in completion order.
+    virtual void read(const FileEntry* files, size_t count, const Consume& consume, const Fail& fail) = 0;
+
+    // Falls back to PREAD when the backend is not available here (io_uring off Linux,
+    // or disabled by the kernel).
+    static std::unique_ptr<FileReader> create(IoBackend backend, size_t queue_depth = 32);
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace boost { namespace iostreams { class mapped_file_source; } }
+
+// Allowlist of known-good file contents (OS images, vendor packages): a file whose size
+// and SHA-256 are in the index is not scanned (--allowlist).
+//
+// On disk: a header, a table of 65537 offsets bucketing the records by the top 16 bits of
+// their XXH64 (content_hash()), then the records (XXH64, size, SHA-256) sorted. The file
+// is mapped read-only, so opening takes milliseconds and only the pages touched by lookups
+// become resident. The XXH64 only narrows the search: a file is known when its size and
+// SHA-256 match a record too, so an XXH64 collision never skips a scan.
+class KnownFileIndex {
+public:
+    ~KnownFileIndex();
+
+    // Null (with a warning) when the file is missing or not a valid index.
+    static std::unique_ptr<KnownFileIndex> open(const std::string& path);
+
+    // Hashes every regular file under `root` with `threads` threads and writes the index
+    // to `out` (write-then-rename). Unreadable files are skipped with a warning; empty
+    // files are not indexed. Returns the number of distinct contents written; throws
+    // std::runtime_error when the index cannot be written.
+    static size_t build(const std::string& root, const std::string& out, unsigned threads);
+
+    // `hash` is content_hash(data, size); the SHA-256 is computed only on an XXH64 hit.
+    bool contains(const char* data, size_t size, uint64_t hash) const;
+    size_t size() const { return m_count; }
+
+    using Digest = std::array<unsigned char, 32>;
+    static Digest sha256(const void* data, size_t size);
+
+private:
+    struct Record {
+        uint64_t hash;
+        uint64_t size;
+        Digest digest;
+    };
+
+    KnownFileIndex() = default;
+
+    std::unique_ptr<boost::iostreams::mapped_file_source> m_map;
+    const uint64_t* m_buckets = nullptr; // BUCKETS + 1 offsets into m_records
+    const Record* m_records = nullptr;
+    size_t m_count = 0;
+};
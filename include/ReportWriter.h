@@ -1,16 +1,19 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <fstream>
 #include <iomanip>
 #include <nlohmann/json.hpp>
 #include "Scanner.h"
 
+// `fallbacks`: files that ran past the per-file time budget and were rescanned with RE2.
 class ReportWriter {
 public:
     static void write_json(const std::string& path,
                            const ScanStats& results,
                            const std::string& target,
-                           const std::string& engine_name)
+                           const std::string& engine_name,
+                           const std::vector<std::string>& fallbacks = {})
     {
         nlohmann::json j;
         j["scan_target"] = target;
@@ -18,10 +21,11 @@ public:
         j["total_files_processed"] = results.total_files_processed;
 
         nlohmann::json det = nlohmann::json::object();
-        for (const auto& [name, count] : results.counts) {
+        for (const auto& [name, count] : results.totals()) {
             if (count > 0) det[name] = count;
         }
         j["detections"] = det;
+        j["budget_fallbacks"] = fallbacks;
 
         std::ofstream f(path, std::ios::out | std::ios::trunc);
         if (f.is_open()) f << j.dump(2) << "\n";
@@ -30,7 +34,8 @@ public:
     static void write_txt(const std::string& path,
                           const ScanStats& results,
                           const std::string& target,
-                          const std::string& engine_name)
+                          const std::string& engine_name,
+                          const std::vector<std::string>& fallbacks = {})
     {
         std::ofstream f(path, std::ios::out | std::ios::trunc);
         if (!f.is_open()) return;
@@ -42,11 +47,15 @@ public:
         f << "--------------------------\n";
         f << std::left << std::setw(15) << "Тип файла" << " | " << "Найдено\n";
         f << "--------------------------\n";
-        for (const auto& [name, count] : results.counts) {
+        for (const auto& [name, count] : results.totals()) {
             if (count > 0)
                 f << std::left << std::setw(15) << name << " | " << count << "\n";
         }
         f << "--------------------------\n";
         f << "Всего файлов обработано: " << results.total_files_processed << "\n";
+        if (!fallbacks.empty()) {
+            f << "Превышен бюджет времени, пересканировано RE2: " << fallbacks.size() << "\n";
+            for (const auto& file : fallbacks) f << "  " << file << "\n";
+        }
     }
 };
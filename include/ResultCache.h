@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <ctime>
+#include "DirWalker.h"
+#include "Scanner.h"
+
+namespace boost { namespace iostreams { class mapped_file_source; } }
+
+// Per-file scan results kept between runs, so a rescan of a mostly unchanged tree reads
+// only the files that changed (--incremental). A file is identified by device, inode and
+// path, and its counts are reused while its size and mtime are the same.
+//
+// On disk: one file per engine in the cache directory, a header followed by fixed-size
+// records (file identity + one int32 counter per signature id). The file is mapped
+// read-only and indexed once at construction; lookups never take a lock. It is ignored
+// (and replaced by save()) when it was written for another signature set, engine or
+// signature id layout, so editing signatures.json invalidates every entry. Each record
+// remembers the scan root it was stored under, so save() can drop the entries of files
+// that are gone from that root.
+class ResultCache {
+public:
+    // mtime granularity is one second: a file modified this close to the scan start may
+    // change again without its mtime moving, so it is not stored.
+    static constexpr int64_t RACY_SECONDS = 2;
+
+    // `names` is the scanner's id space (Scanner::signature_names()), `sig_hash` is
+    // signature_set_hash() of the loaded signatures, `root` the path this run scans.
+    ResultCache(const std::string& dir, const std::string& engine,
+                std::shared_ptr<const SignatureNames> names, uint64_t sig_hash, const std::string& root);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Adds the stored counts of `file` to `stats` and returns true when it is unchanged
+    // since it was stored. Safe to call from any number of threads.
+    bool lookup(const FileEntry& file, ScanStats& stats) const;
+
+    // Records the counts of a file just scanned; `stats` must hold that one file only.
+    // Thread-safe. Files modified within RACY_SECONDS of the cache's creation are skipped.
+    void store(const FileEntry& file, const ScanStats& stats);
+
+    // Writes every stored entry plus the loaded ones not superseded by store(), then drops
+    // the mapping: lookup() finds nothing afterwards. Loaded entries of this run's root that
+    // no lookup() found unchanged (deleted, renamed or rescanned files) are dropped; those of
+    // other roots are kept. Call it only after a complete run over the root. Returns false
+    // (with a warning) on I/O error.
+    bool save();
+
+    size_t loaded() const { return m_count; }
+    size_t stored() const;
+    const std::string& path() const { return m_path; }
+
+private:
+    struct Key;
+    const char* record(size_t index) const;
+    size_t find(const Key& key) const;
+    bool encode(const FileEntry& file, const ScanStats& stats, std::vector<char>& out) const;
+
+    std::string m_path;
+    std::shared_ptr<const SignatureNames> m_names;
+    uint64_t m_sig_hash = 0;
+    uint64_t m_table_hash = 0;
+    uint64_t m_root_hash = 0;
+    std::time_t m_started = 0;
+
+    std::unique_ptr<boost::iostreams::mapped_file_source> m_map;
+    const char* m_records = nullptr;
+    size_t m_count = 0;
+    size_t m_stride = 0;
+    std::vector<uint32_t> m_index; // open addressing: record number + 1, 0 = empty
+    std::unique_ptr<std::atomic<bool>[]> m_visited; // by record: found unchanged this run
+
+    mutable std::mutex m_mutex;
+    std::vector<char> m_pending; // records from store(), same layout as on disk
+};
@@ -2,7 +2,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <chrono>
+#include <stdexcept>
 #include <boost/regex.hpp>
 
 namespace re2 { class RE2; }
@@ -10,7 +17,7 @@ struct hs_database;
 struct hs_scratch;
 
 enum class SignatureType { BINARY, TEXT };
-enum class EngineType { BOOST, RE2, HYPERSCAN };
+enum class EngineType { BOOST, RE2, HYPERSCAN, LITERAL, HYBRID };
 
 struct SignatureDefinition {
     std::string name;
@@ -19,71 +26,597 @@ struct SignatureDefinition {
     std::string text_pattern;
     SignatureType type = SignatureType::BINARY;
     std::string deduct_from;
+    // Bounds, 0 = none: max bytes between head and tail/marker, min match length, max end offset.
+    // max_gap is capped at the largest {0,n} repeat the regex syntax allows.
+    static constexpr uint64_t MAX_GAP = 65535;
+    uint64_t max_gap = 0;
+    uint64_t min_length = 0;
+    uint64_t max_offset = 0;
+    // hex_head position: ANYWHERE, `offset` from the start (>= 0) or `-offset` from the end.
+    // `??` in hex_head/hex_tail matches any byte.
+    static constexpr int64_t ANYWHERE = INT64_MIN;
+    int64_t offset = ANYWHERE;
+
+    bool windowed() const { return max_gap != 0 || min_length != 0; }
+    bool anchored() const { return offset != ANYWHERE; }
 };
 
+// Signature id -> name. Built once by prepare() and shared by the scanner, its forks and
+// every ScanStats they fill.
+using SignatureNames = std::vector<std::string>;
+
+// Engines count into `hits`, indexed by signature id; names resolve on merge/get()/resolve().
 struct ScanStats {
-    std::map<std::string, int> counts;
+    std::map<std::string, int> counts;             // by name (generator, deduction, reports)
+    std::vector<int> hits;                         // by signature id of `names`
+    std::shared_ptr<const SignatureNames> names;
     int total_files_processed = 0;
 
     void add(const std::string& name) { counts[name]++; }
-    void reset() { counts.clear(); total_files_processed = 0; }
+    void hit(uint32_t id) { ++hits[id]; }
+    void hit(uint32_t id, int n) { hits[id] += n; }
+
+    // Switches the dense counters to another id space; O(1) when already bound.
+    void bind(const std::shared_ptr<const SignatureNames>& table) {
+        if (names == table) return;
+        resolve();
+        names = table;
+        hits.assign(table ? table->size() : 0, 0);
+    }
+
+    // Moves dense counters into `counts`.
+    ScanStats& resolve() {
+        for (size_t id = 0; id < hits.size(); ++id) {
+            if (hits[id] == 0) continue;
+            counts[(*names)[id]] += hits[id];
+            hits[id] = 0;
+        }
+        return *this;
+    }
+
+    int get(const std::string& name) const {
+        auto it = counts.find(name);
+        int total = it != counts.end() ? it->second : 0;
+        for (size_t id = 0; id < hits.size(); ++id)
+            if ((*names)[id] == name) total += hits[id];
+        return total;
+    }
+
+    std::map<std::string, int> totals() const {
+        std::map<std::string, int> merged = counts;
+        for (size_t id = 0; id < hits.size(); ++id)
+            if (hits[id] != 0) merged[(*names)[id]] += hits[id];
+        return merged;
+    }
+
+    void reset() { counts.clear(); hits.assign(hits.size(), 0); total_files_processed = 0; }
 
     ScanStats& operator+=(const ScanStats& other) {
+        if (other.names && !names) bind(other.names);
+        if (other.names == names) {
+            // Same id space (scanner and its forks): a plain array add.
+            int* dst = hits.data();
+            const int* src = other.hits.data();
+            for (size_t id = 0, n = hits.size(); id < n; ++id) dst[id] += src[id];
+        }
+        else {
+            for (size_t id = 0; id < other.hits.size(); ++id)
+                if (other.hits[id] != 0) counts[(*other.names)[id]] += other.hits[id];
+        }
         for (const auto& [name, count] : other.counts) counts[name] += count;
         total_files_processed += other.total_files_processed;
         return *this;
     }
 };
 
+// Flat deduction on aggregated, name-keyed counts: each parent loses its children's counts.
+// Scanners already deduct per file (DeductionPlan); this is for counts from elsewhere.
 void apply_deduction(ScanStats& stats, const std::vector<SignatureDefinition>& sigs);
 
+// deduct_from relations by signature id, children first: a ZIP match containing a DOCX match
+// counts as the DOCX only (a header-only parent is claimed by a child at the same header).
+class DeductionPlan {
+public:
+    // `defs[id]` is the signature with that id. Cycles are broken with a warning.
+    static DeductionPlan build(const std::vector<SignatureDefinition>& defs);
+
+    bool empty() const { return m_order.empty(); }
+    bool tracks(uint32_t id) const { return id < m_tracked.size() && m_tracked[id]; }
+    // Some signature deducts from `id`.
+    bool is_parent(uint32_t id) const { return id < m_is_parent.size() && m_is_parent[id]; }
+    // `id` deducts from `ancestor`, directly or through a chain.
+    bool descends(uint32_t id, uint32_t ancestor) const;
+
+    // Leftmost match of `id` starting at or after `from`, as [begin, end).
+    using Find = std::function<bool(uint32_t id, size_t from, size_t& begin, size_t& end)>;
+
+    // Counts the tracked signatures of one file into `stats`; a claimed parent match is skipped
+    // and its search resumes after the claiming match.
+    void count(size_t size, const Find& find, ScanStats& stats) const;
+
+private:
+    std::vector<char> m_tracked;     // by id: parent or child in some relation
+    std::vector<int> m_parent;       // by id, -1 = none
+    std::vector<char> m_header_only; // by id: binary signature matched by its header alone
+    std::vector<char> m_is_parent;   // by id
+    std::vector<uint32_t> m_order;   // tracked ids, every child before its parent
+};
+
+// First-match classification (Scanner::classify), fed matches by end offset: the first match
+// wins, except that a deduct_from parent (ZIP) yields to its first matching descendant (DOCX).
+class FirstMatch {
+public:
+    explicit FirstMatch(const DeductionPlan& plan) : m_plan(plan) {}
+    // Returns true once the type is decided: no later match can change it.
+    bool add(uint32_t id) {
+        if (m_decided >= 0) return true;
+        if (m_pending >= 0 && !m_plan.descends(id, static_cast<uint32_t>(m_pending))) return false;
+        if (m_plan.is_parent(id)) {
+            m_pending = static_cast<int>(id);
+            return false;
+        }
+        m_decided = static_cast<int>(id);
+        return true;
+    }
+    bool decided() const { return m_decided >= 0; }
+    // The type after the last match (or once decided), -1 = no match at all.
+    int result() const { return m_decided >= 0 ? m_decided : m_pending; }
+
+private:
+    const DeductionPlan& m_plan;
+    int m_pending = -1; // parent waiting for a descendant
+    int m_decided = -1;
+};
+
+// Leftmost-first, non-overlapping counts (as Boost and RE2 count) from Hyperscan's SOM_LEFTMOST
+// matches; a lazy `head.*?tail` is fed as its two pieces (split()).
+class LeftmostCount {
+public:
+    // `head.*?tail` at the top level of `pattern` with a head and a tail of bounded length:
+    // true, with the pieces.
+    static bool split(const std::string& pattern, std::string& head, std::string& tail);
+
+    void reset(size_t patterns) {
+        m_cursor.assign(patterns, 0);
+        m_open.assign(patterns, NONE);
+    }
+    // A match [from, to) of a whole pattern; true when it counts.
+    bool match(uint32_t id, uint64_t from, uint64_t to) {
+        if (from < m_cursor[id]) return false;
+        m_cursor[id] = to > from ? to : from + 1;
+        return true;
+    }
+    // Pieces of a split pattern: the first head at or after the cursor opens a match, and
+    // the first tail starting at or after that head's end closes it (true: it counts).
+    void head(uint32_t id, uint64_t from, uint64_t to) {
+        if (m_open[id] == NONE && from >= m_cursor[id]) m_open[id] = to;
+    }
+    bool tail(uint32_t id, uint64_t from, uint64_t to) {
+        if (m_open[id] == NONE || from < m_open[id]) return false;
+        m_open[id] = NONE;
+        m_cursor[id] = to;
+        return true;
+    }
+
+private:
+    static constexpr uint64_t NONE = UINT64_MAX;
+    std::vector<uint64_t> m_cursor; // by id: end of the last match counted
+    std::vector<uint64_t> m_open;   // by id, split patterns: end of the open head, NONE = none
+};
+
+// Stable 64-bit hash of a loaded signature set; keys on-disk caches so that any edit
+// to signatures.json invalidates them.
+uint64_t signature_set_hash(const std::vector<SignatureDefinition>& sigs);
+
+// How the matches of one signature relate to segment boundaries when a single buffer is
+// scanned by several threads (Scanner::scan_parallel).
+struct SignatureShape {
+    enum class Kind {
+        BOUNDED,    // no match is longer than max_len: overlapping segments see every match whole
+        HEAD_TAIL,  // literal head, `.*?`, tail no longer than tail_len (build_pattern's head/tail form)
+        SEQUENTIAL  // unbounded otherwise: counted by one pass over the whole buffer
+    };
+    Kind kind = Kind::SEQUENTIAL;
+    size_t max_len = 0;   // BOUNDED
+    // SEQUENTIAL: a top-level greedy `.*` or `.+` lets the first match swallow every later
+    // one, so there is at most one match.
+    bool single = false;
+    // Head/tail signatures (HEAD_TAIL, and bounded ones of any kind):
+    size_t head_len = 0;
+    size_t tail_len = 0;  // UNBOUNDED for an unbounded marker
+    std::string head;     // regex of the head alone
+    std::string tail;     // regex of the tail alone
+};
+
+SignatureShape signature_shape(const SignatureDefinition& def);
+
+// max_gap / min_length / max_offset of one signature (see SignatureDefinition).
+struct SignatureBounds {
+    uint64_t max_gap = 0;
+    uint64_t min_length = 0;
+    uint64_t max_offset = 0;
+
+    static SignatureBounds of(const SignatureDefinition& def) { return {def.max_gap, def.min_length, def.max_offset}; }
+    bool windowed() const { return max_gap != 0 || min_length != 0; }
+    // End of the searchable data for a buffer of `size` bytes starting at file offset `base`.
+    size_t limit(size_t size, uint64_t base = 0) const {
+        if (max_offset == 0) return size;
+        return max_offset <= base ? 0 : static_cast<size_t>(std::min<uint64_t>(size, max_offset - base));
+    }
+};
+
+// Container subtypes grouped under the magic they share (DOCX/XLSX/PPTX under ZIP), so engines
+// run a subtype's discriminator only after a magic hit. Indexes are signature ids.
+struct SignatureTree {
+    struct Group {
+        std::string hex_head;         // the shared magic
+        int parent = -1;              // signature that is the magic itself (OLE, ZIP), -1 = none
+        std::vector<uint32_t> children;
+    };
+    std::vector<Group> groups;
+    std::vector<int> group_of; // by index: group of a subtype, -1 = evaluated on its own
+
+    bool is_child(uint32_t id) const { return id < group_of.size() && group_of[id] >= 0; }
+};
+
+// History RE2/Boost streams keep between chunks; longer non-head/tail matches are missed.
+static constexpr size_t STREAM_CARRY_BYTES = 1024 * 1024;
+
+// Engines without a vectored mode join the pieces of a Scanner::scan_vectored() input up to
+// this many bytes; a larger input is streamed.
+static constexpr size_t VECTORED_JOIN_BYTES = 256 * 1024 * 1024;
+
+// Incremental scan of one input delivered in chunks; a match across chunks counts once.
+// Writes into the ScanStats passed to Scanner::open_stream(), which must outlive it.
+class ScanStream {
+public:
+    virtual ~ScanStream() = default;
+    virtual void write(const char* data, size_t size) = 0;
+    virtual void close() = 0; // flushes end-of-data matches; called by the destructor if omitted
+};
+
+// One piece of a scattered buffer (Scanner::scan_vectored), as in struct iovec.
+struct ScanSpan {
+    const char* data;
+    size_t size;
+};
+
+// Signatures anchored at a fixed offset: one masked compare each, never searched for.
+// Engines compile the others and give these the last ids (order()).
+class AnchoredSignatures {
+public:
+    // Copy of `sigs` with the anchored ones last; only an unbounded binary hex_head with no
+    // deduct_from relation keeps its anchor.
+    static std::vector<SignatureDefinition> order(const std::vector<SignatureDefinition>& sigs);
+
+    void add(uint32_t id, const SignatureDefinition& def);
+    bool empty() const { return m_magics.empty(); }
+    // Bytes of the start / of the end of a file that the anchors look at.
+    size_t head_bytes() const { return m_head; }
+    size_t tail_bytes() const { return m_tail; }
+
+    // Counts the anchors that match one whole file (at most one hit each) into `stats`,
+    // already bound to the scanner's names.
+    void scan(const char* data, size_t size, ScanStats& stats) const {
+        check(data, data + size - std::min(size, m_tail), size, stats);
+    }
+    // Same, from the first min(size, head_bytes()) and the last min(size, tail_bytes())
+    // bytes of a file of `size` bytes (streams keep only those).
+    void check(const char* head, const char* tail, uint64_t size, ScanStats& stats) const;
+    // Anchors matching one whole file, as (match end, id) pairs appended to `out`.
+    void matches(const char* data, size_t size, std::vector<std::pair<size_t, uint32_t>>& out) const;
+
+private:
+    struct Magic {
+        uint32_t id;
+        int64_t offset;
+        std::string bytes; // pre-masked
+        std::string mask;  // 0x00 for `??`, 0xFF otherwise
+    };
+    // Start of `m` in a file of `size` bytes given its head/tail views, or SIZE_MAX.
+    size_t locate(const Magic& m, const char* head, const char* tail, uint64_t size) const;
+    std::vector<Magic> m_magics;
+    size_t m_head = 0;
+    size_t m_tail = 0;
+};
+
+// The literal each signature's matches start with, found for all signatures in one pass;
+// the engine's regex confirms a hit only where the literal alone is not the match.
+class LeadingLiterals {
+public:
+    enum class Kind : char {
+        NONE,    // no leading literal
+        LITERAL, // the pattern is the literal itself
+        PAIR,    // `head.*?tail` of two literals, or `head.*?rest` with rest starting with a literal
+        CONFIRM  // the engine confirms a match at the literal
+    };
+    // A match of signature `id` (bounds applied): for `at`, the one anchored at `p`; for
+    // `from`, the leftmost from `p` (tree subtypes included).
+    using Match = std::function<bool(uint32_t id, size_t p, size_t& begin, size_t& end)>;
+    // Per-scan state, kept by the caller so that its buffers are reused.
+    struct Cursors {
+        std::vector<size_t> next;               // by id: next match start, SIZE_MAX = done
+        std::vector<size_t> pending;            // by id, PAIR: open head, SIZE_MAX = none
+        std::vector<std::vector<size_t>> heads; // by id, deduct_from signatures: every head
+        std::vector<std::vector<size_t>> tails; // by id, deduct_from signatures: every tail
+    };
+    // How count() locates the literals: Teddy nibble tables over 16/32 positions, or SCALAR
+    // first-byte-pair bitmaps (also used when there are too many literals).
+    enum class Kernel : char { SCALAR, SSSE3, AVX2 };
+    static Kernel best_kernel(); // the widest kernel this CPU runs
+
+    // Literals of the first `count` of `defs` (the searched signature ids).
+    static LeadingLiterals build(const std::vector<SignatureDefinition>& defs, size_t count, const SignatureTree& tree);
+
+    Kind kind(uint32_t id) const { return m_kinds[id]; }
+    bool all() const { return m_all; } // no signature is Kind::NONE
+
+    // Counts the signatures with a leading literal; those `plan` tracks go to `cursors`.
+    // A kernel the CPU lacks falls back to best_kernel().
+    void count(const char* data, size_t size, const DeductionPlan& plan, Cursors& cursors,
+               const Match& at, const Match& from, ScanStats& stats, Kernel kernel = best_kernel()) const;
+    // Leftmost match of a tracked signature from `from`, after count() of the same buffer.
+    bool find(uint32_t id, size_t from, size_t size, const Cursors& cursors, const Match& at, const Match& search,
+              size_t& begin, size_t& end) const;
+
+private:
+    struct Literal {
+        std::string bytes;
+        bool fold = false;           // ASCII case-insensitive (text signatures)
+        std::vector<uint32_t> heads; // ids whose matches start with it
+        std::vector<uint32_t> tails; // PAIR ids whose matches end with it
+        // First four bytes as one compare: ((bytes at p | prefix_fold) & prefix_mask) == prefix.
+        uint32_t prefix = 0;
+        uint32_t prefix_mask = 0;    // 0xff per byte of the literal
+        uint32_t prefix_fold = 0;    // 0x20 per letter when `fold`; prefix holds it lower case
+    };
+    void add(uint32_t id, const std::string& bytes, bool fold, bool tail);
+    void group();
+
+    std::vector<Literal> m_literals;                // one per distinct literal
+    std::vector<std::vector<uint32_t>> m_buckets;   // 256, by first byte: indexes into m_literals
+    std::vector<uint64_t> m_pairs;                  // 65536-bit set of the first two bytes of a literal
+    std::vector<std::vector<uint32_t>> m_groups;    // 16 Teddy groups: indexes into m_literals
+    std::vector<unsigned char> m_nibbles;           // [groups 0-7, 8-15][byte 0..2][low, high nibble][16]: bit g % 8
+    bool m_teddy = false;                           // the tables filter well enough for the SIMD kernels
+    std::vector<Kind> m_kinds;                      // by id
+    std::vector<size_t> m_head_lens;                // by id: LITERAL, PAIR
+    std::vector<size_t> m_tail_lens;                // by id: PAIR
+    std::vector<char> m_exact;                      // by id, PAIR: the tail ends the pattern (else the engine confirms)
+    std::vector<char> m_searches;                   // by id, CONFIRM: matched by `from`, not `at` (tree subtypes, windows)
+    std::vector<char> m_chained;                    // by id, CONFIRM: no match at a head means none at a later one
+    std::vector<SignatureBounds> m_bounds;          // by id
+    bool m_all = true;
+};
+
+// A file's scan ran past the time budget (or Boost's step bound): its counts are incomplete
+// and the caller rescans it with RE2.
+class ScanBudgetExceeded : public std::runtime_error {
+public:
+    explicit ScanBudgetExceeded(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Per-file time budget (Scanner::set_time_budget), started by each scan of a buffer or by
+// open_stream(). Boost tests it before every search it runs, Hyperscan from its match callback.
+class ScanDeadline {
+public:
+    void set(std::chrono::milliseconds budget) { m_budget = budget; }
+    bool armed() const { return m_budget.count() > 0; }
+    void start() {
+        if (armed()) m_at = std::chrono::steady_clock::now() + m_budget;
+    }
+    bool expired() const { return armed() && std::chrono::steady_clock::now() >= m_at; }
+    void check() const {
+        if (expired()) throw ScanBudgetExceeded("over the " + std::to_string(m_budget.count()) + " ms budget");
+    }
+
+private:
+    std::chrono::milliseconds m_budget{0};
+    std::chrono::steady_clock::time_point m_at;
+};
+
 class Scanner {
 public:
     virtual ~Scanner() = default;
     virtual void prepare(const std::vector<SignatureDefinition>& sigs) = 0;
     virtual void scan(const char* data, size_t size, ScanStats& stats) = 0;
+    // Adds 1 to the file's type (FirstMatch), nothing when none matches; stops at the answer.
+    virtual void classify(const char* data, size_t size, ScanStats& stats) = 0;
+    virtual std::unique_ptr<ScanStream> open_stream(ScanStats& stats) = 0;
+    // scan() over overlapping segments on up to `threads` threads (0 bytes = auto).
+    virtual void scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                               size_t segment_bytes = 0) = 0;
+    // scan() of the pieces joined; the default joins up to VECTORED_JOIN_BYTES and streams past it.
+    virtual void scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats);
+    // New scanner sharing this one's compiled (immutable) state, with its own per-thread
+    // scan context. Compile once with prepare(), then fork() per worker thread.
+    virtual std::unique_ptr<Scanner> fork() const = 0;
     virtual std::string name() const = 0;
+    // Id space of the ScanStats this scanner fills (null before a successful prepare()).
+    virtual std::shared_ptr<const SignatureNames> signature_names() const = 0;
+    // Directory for persisted compiled databases (empty disables). Must be set before
+    // prepare(); engines without a serializable form ignore it.
+    virtual void set_cache_dir(const std::string&) {}
+    // Per-file time budget (0 = none); past it a scan or stream throws ScanBudgetExceeded.
+    // Forks keep it; linear-time engines (RE2, literal) ignore it.
+    virtual void set_time_budget(std::chrono::milliseconds) {}
     static std::unique_ptr<Scanner> create(EngineType type);
 };
 
 class BoostScanner : public Scanner {
 public:
+    enum class Matching {
+        PER_SIGNATURE, // one regex_search pass over the buffer per signature
+        COMBINED       // one pass for the leading literals of all, one alternation of the rest
+    };
+    explicit BoostScanner(Matching matching = Matching::COMBINED) : m_matching(matching) {}
     void prepare(const std::vector<SignatureDefinition>& sigs) override;
     void scan(const char* data, size_t size, ScanStats& stats) override;
+    void classify(const char* data, size_t size, ScanStats& stats) override;
+    std::unique_ptr<ScanStream> open_stream(ScanStats& stats) override;
+    void scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                       size_t segment_bytes = 0) override;
+    std::unique_ptr<Scanner> fork() const override;
     std::string name() const override;
+    std::shared_ptr<const SignatureNames> signature_names() const override;
+    void set_time_budget(std::chrono::milliseconds budget) override { m_deadline.set(budget); }
+
+    struct Compiled {
+        std::vector<boost::regex> regexes; // index == signature id
+        std::vector<boost::regex> heads;   // head/tail signatures: head alone (empty regex otherwise)
+        std::vector<boost::regex> tails;   // head/tail signatures: tail alone (empty regex otherwise)
+        std::vector<SignatureShape> shapes;
+        size_t overlap = 0;
+        std::shared_ptr<const SignatureNames> names;
+        DeductionPlan deduction;
+        SignatureTree tree;
+        std::vector<boost::regex> magics; // by tree group
+        std::vector<boost::regex> discs;  // tree children: text_pattern alone (empty regex otherwise)
+        std::vector<SignatureBounds> bounds; // by id
+        AnchoredSignatures anchored;         // ids from regexes.size() on
+        LeadingLiterals leads; // COMBINED
+        // COMBINED: `(sig)|(sig)|...` of the unbounded signatures without a leading literal
+        boost::regex combined;
+        std::vector<uint32_t> combined_ids;    // by alternative
+        std::vector<size_t> combined_groups;   // by alternative: its marked sub-expression
+        std::vector<int> combined_alternative; // by id: -1 when counted on its own
+
+        // Leftmost match of signature `id` (bounds applied, but not max_offset: that is the
+        // caller's `end`) in data[from, end), as offsets from `data`, where the input starts.
+        bool find(uint32_t id, const char* data, size_t from, size_t end, size_t& mb, size_t& me) const;
+    };
 private:
-    std::vector<std::pair<boost::regex, std::string>> m_regexes;
-};
+    void scan_each(const char* data, size_t size, ScanStats& stats) const;
+    void scan_combined(const char* data, size_t size, ScanStats& stats) const;
 
-// RE2::Set is a nested class and cannot be forward-declared; use type-erased deleter.
-struct Re2SetDeleter { void operator()(void* p) const noexcept; };
+    std::shared_ptr<const Compiled> m_compiled;
+    Matching m_matching;
+    ScanDeadline m_deadline; // armed only with a budget, so a budgetless instance is never written to
+};
 
+// Like HsScanner, one instance must not scan() from two threads at once: it keeps its
+// scan buffers between calls. Forks share the compiled state and get their own.
 class Re2Scanner : public Scanner {
 public:
-    Re2Scanner();           // defined in Scanner.cpp where re2::RE2 is complete
-    ~Re2Scanner() override; // defined in Scanner.cpp where re2::RE2 is complete
+    enum class Counting {
+        SINGLE_PASS, // one pass finds every signature's leading literal; RE2 confirms there if needed
+        TWO_PHASE    // RE2::Set over the buffer, then one counting pass per matched pattern
+    };
+    // Both defined in Scanner.cpp where re2::RE2 is complete.
+    explicit Re2Scanner(Counting counting = Counting::SINGLE_PASS);
+    ~Re2Scanner() override;
     void prepare(const std::vector<SignatureDefinition>& sigs) override;
     void scan(const char* data, size_t size, ScanStats& stats) override;
+    void classify(const char* data, size_t size, ScanStats& stats) override;
+    std::unique_ptr<ScanStream> open_stream(ScanStats& stats) override;
+    void scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                       size_t segment_bytes = 0) override;
+    std::unique_ptr<Scanner> fork() const override;
     std::string name() const override;
+    std::shared_ptr<const SignatureNames> signature_names() const override;
+
+    struct Compiled; // RE2::Set + per-pattern RE2 objects; RE2::Set cannot be forward-declared
+protected:
+    Re2Scanner(Counting counting, LeadingLiterals::Kernel kernel);
+
+    std::shared_ptr<const Compiled> m_compiled;
+    Counting m_counting;
+    LeadingLiterals::Kernel m_kernel; // single-pass counting
 private:
-    std::unique_ptr<void, Re2SetDeleter> m_set;
-    std::vector<std::string> m_sig_names;
-    std::vector<std::pair<std::unique_ptr<re2::RE2>, std::string>> m_regexes;
+    void count_single_pass(const char* data, size_t size, ScanStats& stats);
+    void count_two_phase(const char* data, size_t size, ScanStats& stats);
+
+    // Scan buffers, reused by every scan() of this instance
+    std::vector<int> m_entries;                   // RE2::Set matches
+    std::vector<char> m_matched;                  // by id
+    LeadingLiterals::Cursors m_cursors;
+};
+
+// Literal prefilter engine (-e literal): Re2Scanner with a pinned LeadingLiterals kernel;
+// RE2 runs only where a literal needs confirming.
+class LiteralScanner : public Re2Scanner {
+public:
+    explicit LiteralScanner(LeadingLiterals::Kernel kernel = LeadingLiterals::best_kernel());
+    std::unique_ptr<Scanner> fork() const override;
+    std::string name() const override;
 };
 
 // NOTE: HsScanner is NOT thread-safe for concurrent scan() calls on a single instance.
-// hs_scratch is not shareable between threads. Each thread must own its own HsScanner.
-// In main_cli.cpp every worker thread calls Scanner::create() independently — this is correct.
+// hs_scratch is not shareable between threads. The compiled database is: worker threads
+// call fork() on one prepared instance and each gets a cloned scratch (see main_cli.cpp).
 class HsScanner : public Scanner {
 public:
     HsScanner();
     ~HsScanner() override;
+    HsScanner(const HsScanner&) = delete;
+    HsScanner& operator=(const HsScanner&) = delete;
     void prepare(const std::vector<SignatureDefinition>& sigs) override;
     void scan(const char* data, size_t size, ScanStats& stats) override;
+    void classify(const char* data, size_t size, ScanStats& stats) override;
+    std::unique_ptr<ScanStream> open_stream(ScanStats& stats) override;
+    void scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                       size_t segment_bytes = 0) override;
+    // One hs_scan_vector() call over the pieces (HS_MODE_VECTORED database).
+    void scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats) override;
+    std::unique_ptr<Scanner> fork() const override;
     std::string name() const override;
+    std::shared_ptr<const SignatureNames> signature_names() const override;
+    void set_cache_dir(const std::string& dir) override { m_cache_dir = dir; }
+    void set_time_budget(std::chrono::milliseconds budget) override { m_deadline.set(budget); }
+
+    // Match callbacks per MB over this instance's scan() calls: what counting costs on top
+    // of the automaton (every end a pattern matches at is one call).
+    double callbacks_per_mb() const {
+        return m_scanned_bytes ? m_callbacks * (1024.0 * 1024.0) / static_cast<double>(m_scanned_bytes) : 0.0;
+    }
 private:
-    hs_database* db = nullptr;
+    struct Database; // block/stream hs_database + pattern metadata, shared by forks
+    std::shared_ptr<Database> m_db;
     hs_scratch* scratch = nullptr;
-    std::vector<std::string> m_sig_names;
-    std::vector<std::string> m_temp_patterns;
+    bool m_stream_scratch = false;   // scratch has also been sized for the stream database
+    bool m_classify_scratch = false; // ... and for the classify database
+    bool m_vectored_scratch = false; // ... and for the vectored database
+    std::string m_cache_dir;
+    ScanDeadline m_deadline;
+    uint64_t m_callbacks = 0;     // callbacks_per_mb()
+    uint64_t m_scanned_bytes = 0;
+
+    bool ensure_stream_scratch();
+    bool ensure_classify_scratch();
+    bool ensure_vectored_scratch();
+};
+
+// Hybrid engine (-e hybrid): pure-literal signatures go to a LiteralScanner, the rest to `regex`.
+// classify() runs `regex` over the whole set, prepared on first use.
+class HybridScanner : public Scanner {
+public:
+    // `regex`: HYPERSCAN, RE2 or BOOST.
+    explicit HybridScanner(EngineType regex = EngineType::HYPERSCAN) : m_engine(regex) {}
+    void prepare(const std::vector<SignatureDefinition>& sigs) override;
+    void scan(const char* data, size_t size, ScanStats& stats) override;
+    void classify(const char* data, size_t size, ScanStats& stats) override;
+    std::unique_ptr<ScanStream> open_stream(ScanStats& stats) override;
+    void scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                       size_t segment_bytes = 0) override;
+    void scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats) override;
+    std::unique_ptr<Scanner> fork() const override;
+    std::string name() const override;
+    std::shared_ptr<const SignatureNames> signature_names() const override;
+    void set_cache_dir(const std::string& dir) override { m_cache_dir = dir; }
+    // The regex half's: the literal pass is linear.
+    void set_time_budget(std::chrono::milliseconds budget) override;
+
+    // Which half counts `def`: true for the literal pass. `parents` are the deduct_from targets.
+    static bool literal_only(const SignatureDefinition& def, const std::set<std::string>& parents);
+
+    struct Split; // merged names and id offsets, the whole set for classify(); shared by forks
+private:
+    std::shared_ptr<Split> m_split;
+    EngineType m_engine;
+    std::unique_ptr<Scanner> m_regex;    // ids [0, literal_base)
+    std::unique_ptr<Scanner> m_literals; // ids [literal_base, n)
+    std::unique_ptr<Scanner> m_whole;    // classify(): this instance's fork of Split::whole
+    ScanStats m_parts[2];                // regex, literals: reused by every scan
+    std::string m_cache_dir;
+    std::chrono::milliseconds m_budget{0};
 };
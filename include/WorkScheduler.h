@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+
+// Work-stealing scheduler over job indices [0, weights.size()).
+// Every worker owns a deque and takes jobs from its front; a worker whose deque is empty
+// steals from the back of another worker's deque. Idle workers therefore keep pulling
+// work until nothing is left anywhere, and the tail of a run is bounded by the largest
+// single job rather than by the unluckiest static partition.
+class WorkScheduler {
+public:
+    enum class Order {
+        AS_GIVEN,      // contiguous blocks in input order (keeps directory locality)
+        LARGEST_FIRST  // LPT: heaviest jobs first, each to the least-loaded worker by weight
+    };
+
+    WorkScheduler(const std::vector<uint64_t>& weights, unsigned workers, Order order)
+        : m_queues(workers == 0 ? 1 : workers) {
+        for (auto& q : m_queues) q = std::make_unique<Queue>();
+        const size_t n = weights.size();
+        const size_t w = m_queues.size();
+
+        if (order == Order::LARGEST_FIRST) {
+            std::vector<size_t> idx(n);
+            std::iota(idx.begin(), idx.end(), size_t{0});
+            std::stable_sort(idx.begin(), idx.end(),
+                             [&](size_t a, size_t b) { return weights[a] > weights[b]; });
+            std::vector<uint64_t> load(w, 0);
+            for (size_t i : idx) {
+                size_t target = static_cast<size_t>(std::min_element(load.begin(), load.end()) - load.begin());
+                m_queues[target]->jobs.push_back(i);
+                load[target] += std::max<uint64_t>(weights[i], 1);
+            }
+        }
+        else {
+            size_t chunk = (n + w - 1) / w;
+            for (size_t i = 0; i < n; ++i) m_queues[i / chunk]->jobs.push_back(i);
+        }
+    }
+
+    // Next job for `worker`; false once every deque is empty.
+    bool next(unsigned worker, size_t& job) {
+        const size_t w = m_queues.size();
+        worker %= w;
+        {
+            Queue& own = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = own.jobs.front();
+                own.jobs.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < w; ++k) {
+            Queue& victim = *m_queues[(worker + k) % w];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<std::unique_ptr<Queue>> m_queues;
+};
@@ -0,0 +1,205 @@
+#include "DirWalker.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t DENTS_BUFFER_BYTES = 64 * 1024; // getdents64 batch (Linux only)
+
+#ifdef __linux__
+
+// Layout of the records returned by getdents64(2); glibc does not export it.
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+FileEntry make_entry(std::string path, const struct stat& st) {
+    FileEntry e;
+    e.path = std::move(path);
+    e.size = static_cast<uint64_t>(st.st_size);
+    e.device = static_cast<uint64_t>(st.st_dev);
+    e.inode = static_cast<uint64_t>(st.st_ino);
+    e.mtime = static_cast<int64_t>(st.st_mtime);
+    return e;
+}
+
+// An open directory, closed once the last of its queued subdirectories has been opened.
+struct DirHandle {
+    int fd;
+    explicit DirHandle(int f) : fd(f) {}
+    ~DirHandle() { ::close(fd); }
+    DirHandle(const DirHandle&) = delete;
+    DirHandle& operator=(const DirHandle&) = delete;
+};
+
+// A directory waiting to be listed: opened by name relative to its parent's descriptor,
+// so a path component renamed or swapped for a symlink after the parent was listed
+// cannot redirect the walk, and no path is resolved from the root again.
+struct PendingDir {
+    std::string path;
+    std::shared_ptr<DirHandle> parent; // null for the root
+    size_t name_at = 0;                // path.substr(name_at) is the name inside `parent`
+};
+
+int open_dir(const PendingDir& dir) {
+    constexpr int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW;
+    if (!dir.parent) return ::openat(AT_FDCWD, dir.path.c_str(), flags);
+    return ::openat(dir.parent->fd, dir.path.c_str() + dir.name_at, flags);
+}
+
+// Lists one directory: files go to `emit`, subdirectories to `subdirs`.
+template <typename Emit>
+void list_dir(const PendingDir& dir, std::vector<char>& buf, std::vector<PendingDir>& subdirs, Emit&& emit) {
+    int fd = open_dir(dir);
+    if (fd < 0) return;
+    auto self = std::make_shared<DirHandle>(fd);
+    const std::string prefix = dir.path.back() == '/' ? dir.path : dir.path + '/';
+
+    for (;;) {
+        long n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<LinuxDirent64*>(buf.data() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+            if (d->d_type == DT_DIR) {
+                subdirs.push_back({prefix + name, self, prefix.size()});
+                continue;
+            }
+            if (d->d_type != DT_REG && d->d_type != DT_UNKNOWN) continue; // symlinks, devices, fifos
+
+            struct stat st;
+            if (::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            if (S_ISREG(st.st_mode)) emit(make_entry(prefix + name, st));
+            else if (S_ISDIR(st.st_mode)) subdirs.push_back({prefix + name, self, prefix.size()});
+        }
+    }
+}
+
+bool stat_root(const std::string& root, struct stat& st) {
+    return ::fstatat(AT_FDCWD, root.c_str(), &st, 0) == 0;
+}
+
+#else
+
+struct PendingDir {
+    std::string path;
+};
+
+template <typename Emit>
+void list_dir(const PendingDir& dir, std::vector<char>&, std::vector<PendingDir>& subdirs, Emit&& emit) {
+    std::error_code ec;
+    fs::directory_iterator it(fs::path(dir.path), fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        // On Windows the directory listing already carries status and size: no extra stat.
+        auto st = it->symlink_status(ec);
+        if (ec) continue;
+        if (fs::is_directory(st)) {
+            subdirs.push_back({it->path().string()});
+        }
+        else if (fs::is_regular_file(st)) {
+            FileEntry e;
+            e.path = it->path().string();
+            e.size = it->file_size(ec);
+            if (ec) continue;
+            e.mtime = std::chrono::duration_cast<std::chrono::seconds>(
+                it->last_write_time(ec).time_since_epoch()).count();
+            emit(std::move(e));
+        }
+    }
+}
+
+#endif
+
+} // namespace
+
+size_t DirWalker::walk(const std::string& root, unsigned threads, const Callback& emit) {
+    if (threads == 0) threads = 1;
+    std::atomic<size_t> found{0};
+    auto report = [&](FileEntry&& e) {
+        found.fetch_add(1, std::memory_order_relaxed);
+        emit(std::move(e));
+    };
+
+#ifdef __linux__
+    struct stat root_st;
+    if (!stat_root(root, root_st)) return 0;
+    if (S_ISREG(root_st.st_mode)) {
+        report(make_entry(root, root_st));
+        return 1;
+    }
+    if (!S_ISDIR(root_st.st_mode)) return 0;
+#else
+    std::error_code ec;
+    auto root_path = fs::path(root);
+    if (fs::is_regular_file(root_path, ec)) {
+        FileEntry e;
+        e.path = root;
+        e.size = fs::file_size(root_path, ec);
+        report(std::move(e));
+        return 1;
+    }
+    if (!fs::is_directory(root_path, ec)) return 0;
+#endif
+
+    // Pending directories are shared; a worker sleeps only while the queue is empty and
+    // another worker may still add to it. The walk ends when both are false.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<PendingDir> pending(1);
+    pending.front().path = root;
+    unsigned busy = 0;
+
+    auto worker = [&] {
+        std::vector<char> buf(DENTS_BUFFER_BYTES);
+        std::vector<PendingDir> subdirs;
+        for (;;) {
+            PendingDir dir;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+                if (pending.empty()) return;
+                dir = std::move(pending.back()); // depth-first keeps the queue short
+                pending.pop_back();
+                ++busy;
+            }
+            subdirs.clear();
+            list_dir(dir, buf, subdirs, report);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& s : subdirs) pending.push_back(std::move(s));
+                --busy;
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    for (unsigned t = 1; t < threads; ++t) helpers.emplace_back(worker);
+    worker();
+    for (auto& t : helpers) t.join();
+    return found.load();
+}
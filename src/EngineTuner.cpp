@@ -0,0 +1,119 @@
+#include "EngineTuner.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const std::pair<EngineType, const char*> KEYS[] = {
+        { EngineType::HYPERSCAN, "hs" },
+        { EngineType::RE2, "re2" },
+        { EngineType::BOOST, "boost" },
+        { EngineType::LITERAL, "literal" },
+        { EngineType::HYBRID, "hybrid" },
+    };
+
+    double ms_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A winner timed on classify() says nothing about scan(), and the reverse.
+    fs::path choice_path(const std::string& dir, uint64_t sig_hash, bool classify) {
+        std::ostringstream name;
+        name << "engine_" << std::hex << std::setw(16) << std::setfill('0') << sig_hash
+             << (classify ? "_classify" : "") << ".txt";
+        return fs::path(dir) / name.str();
+    }
+}
+
+const std::vector<EngineType>& EngineTuner::candidates() {
+    static const std::vector<EngineType> engines = {
+        EngineType::HYPERSCAN, EngineType::RE2, EngineType::BOOST, EngineType::HYBRID
+    };
+    return engines;
+}
+
+std::vector<EngineTuner::Trial> EngineTuner::measure(const std::vector<SignatureDefinition>& sigs,
+                                                     const std::vector<std::string>& sample,
+                                                     const std::string& cache_dir, bool classify,
+                                                     const std::vector<EngineType>& engines) {
+    std::vector<Trial> trials;
+    for (EngineType engine : engines) {
+        Trial t{engine, Scanner::create(engine)};
+        t.scanner->set_cache_dir(cache_dir);
+        auto start = std::chrono::steady_clock::now();
+        t.scanner->prepare(sigs);
+        t.prepare_ms = ms_since(start);
+        t.ok = t.scanner->signature_names() != nullptr;
+        // The first pass also faults the sample and the engine's tables in; the second is
+        // the steady state the run will see.
+        t.scan_ms = std::numeric_limits<double>::max();
+        for (int pass = 0; t.ok && pass < 2; ++pass) {
+            ScanStats stats;
+            start = std::chrono::steady_clock::now();
+            for (const auto& buf : sample) {
+                if (classify) t.scanner->classify(buf.data(), buf.size(), stats);
+                else t.scanner->scan(buf.data(), buf.size(), stats);
+            }
+            t.scan_ms = std::min(t.scan_ms, ms_since(start));
+        }
+        trials.push_back(std::move(t));
+    }
+    return trials;
+}
+
+size_t EngineTuner::pick(const std::vector<Trial>& trials, double scale) {
+    size_t best = trials.size();
+    double best_ms = 0;
+    for (size_t i = 0; i < trials.size(); ++i) {
+        if (!trials[i].ok) continue;
+        const double ms = trials[i].prepare_ms + scale * trials[i].scan_ms;
+        if (best == trials.size() || ms < best_ms) {
+            best = i;
+            best_ms = ms;
+        }
+    }
+    return best;
+}
+
+std::string EngineTuner::key(EngineType engine) {
+    for (const auto& [type, name] : KEYS)
+        if (type == engine) return name;
+    return "";
+}
+
+bool EngineTuner::from_key(const std::string& key, EngineType& engine) {
+    for (const auto& [type, name] : KEYS) {
+        if (key != name) continue;
+        engine = type;
+        return true;
+    }
+    return false;
+}
+
+bool EngineTuner::load(const std::string& dir, uint64_t sig_hash, bool classify, EngineType& engine) {
+    if (dir.empty()) return false;
+    std::ifstream in(choice_path(dir, sig_hash, classify));
+    std::string word;
+    return in >> word && from_key(word, engine);
+}
+
+bool EngineTuner::save(const std::string& dir, uint64_t sig_hash, bool classify, EngineType engine) {
+    if (dir.empty()) return false;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    const fs::path path = choice_path(dir, sig_hash, classify);
+    std::ofstream out(path, std::ios::trunc);
+    out << key(engine) << "\n";
+    if (!out) {
+        std::cerr << "[EngineTuner] Warning: cannot write " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,343 @@
+#include "FileReader.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#ifdef _WIN32
+#include <boost/iostreams/device/mapped_file.hpp>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define DEVSCAN_IO_URING 1
+#endif
+#endif
+
+namespace {
+
+constexpr size_t HUGEPAGE_HINT_BYTES = 4 * 1024 * 1024; // madvise(MADV_HUGEPAGE) from this size
+
+#ifndef _WIN32
+
+std::string errno_text(int err) { return std::strerror(err); }
+
+// Maps the file read-only for the duration of `consume`.
+void map_file(const FileEntry& file, const FileReader::Consume& consume, const FileReader::Fail& fail) {
+    if (file.size == 0) return consume(file, nullptr, 0);
+    int fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return fail(file, errno_text(errno));
+    const size_t size = static_cast<size_t>(file.size);
+    void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (p == MAP_FAILED) return fail(file, errno_text(err));
+
+    // Sequential: aggressive readahead, pages behind the scan are dropped first.
+    ::madvise(p, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (size >= HUGEPAGE_HINT_BYTES) ::madvise(p, size, MADV_HUGEPAGE);
+#endif
+    struct Unmap {
+        void* p;
+        size_t size;
+        ~Unmap() { ::munmap(p, size); }
+    } unmap{ p, size };
+    consume(file, static_cast<const char*>(p), size);
+}
+
+// Reads the whole file into `buf`, which only ever grows. A file that shrank since it
+// was listed is scanned up to its current end.
+void pread_file(const FileEntry& file, std::vector<char>& buf, const FileReader::Consume& consume,
+                const FileReader::Fail& fail) {
+    int fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return fail(file, errno_text(errno));
+    const size_t size = static_cast<size_t>(file.size);
+    if (buf.size() < size) buf.resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, buf.data() + done, size - done, static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            int err = errno;
+            ::close(fd);
+            return fail(file, errno_text(err));
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    consume(file, buf.data(), done);
+}
+
+#else
+
+void map_file(const FileEntry& file, const FileReader::Consume& consume, const FileReader::Fail& fail) {
+    try {
+        boost::iostreams::mapped_file_source mmap(file.path);
+        if (mmap.is_open()) consume(file, mmap.data(), mmap.size());
+    }
+    catch (const std::exception& e) {
+        fail(file, e.what());
+    }
+}
+
+void pread_file(const FileEntry& file, std::vector<char>& buf, const FileReader::Consume& consume,
+                const FileReader::Fail& fail) {
+    std::ifstream in(file.path, std::ios::binary);
+    if (!in) return fail(file, "cannot open for reading");
+    const size_t size = static_cast<size_t>(file.size);
+    if (buf.size() < size) buf.resize(size);
+    in.read(buf.data(), static_cast<std::streamsize>(size));
+    consume(file, buf.data(), static_cast<size_t>(in.gcount()));
+}
+
+#endif
+
+// Small files through the reusable buffer, large ones mapped.
+void read_one(const FileEntry& file, std::vector<char>& buf, const FileReader::Consume& consume,
+              const FileReader::Fail& fail) {
+    if (file.size > FileReader::MAX_BUFFERED_BYTES) map_file(file, consume, fail);
+    else pread_file(file, buf, consume, fail);
+}
+
+class MmapReader : public FileReader {
+public:
+    std::string name() const override { return "mmap"; }
+    void read(const FileEntry* files, size_t count, const Consume& consume, const Fail& fail) override {
+        for (size_t i = 0; i < count; ++i) map_file(files[i], consume, fail);
+    }
+};
+
+class PreadReader : public FileReader {
+public:
+    std::string name() const override { return "pread"; }
+    void read(const FileEntry* files, size_t count, const Consume& consume, const Fail& fail) override {
+        for (size_t i = 0; i < count; ++i) read_one(files[i], m_buf, consume, fail);
+    }
+
+private:
+    std::vector<char> m_buf;
+};
+
+#ifdef DEVSCAN_IO_URING
+
+// io_uring through the raw syscalls (no liburing dependency). Up to `depth` files are
+// open at once, each with one IORING_OP_READ in flight into its own reusable buffer;
+// a file is scanned as soon as its last read completes while the others keep loading.
+// Files above MAX_BUFFERED_BYTES / depth are read synchronously by read_one().
+class UringReader : public FileReader {
+public:
+    // nullptr when the kernel refuses io_uring (too old, disabled, seccomp); `err` says why.
+    static std::unique_ptr<UringReader> open(size_t depth, int& err) {
+        std::unique_ptr<UringReader> r(new UringReader(depth));
+        if (r->setup()) return r;
+        err = errno;
+        return nullptr;
+    }
+
+    ~UringReader() override {
+        if (m_sqes) ::munmap(m_sqes, m_sqes_bytes);
+        if (m_cq_ring && m_cq_ring != m_sq_ring) ::munmap(m_cq_ring, m_cq_ring_bytes);
+        if (m_sq_ring) ::munmap(m_sq_ring, m_sq_ring_bytes);
+        if (m_ring >= 0) ::close(m_ring);
+    }
+
+    std::string name() const override { return "io_uring"; }
+    size_t batch_size() const override { return m_slots.size(); }
+
+    void read(const FileEntry* files, size_t count, const Consume& consume, const Fail& fail) override {
+        const size_t slot_limit = MAX_BUFFERED_BYTES / m_slots.size();
+        size_t next = 0, in_flight = 0;
+        while (next < count || in_flight > 0) {
+            // Top up the ring.
+            for (Slot& slot : m_slots) {
+                if (slot.file) continue;
+                while (next < count) {
+                    const FileEntry& file = files[next++];
+                    if (file.size > slot_limit || m_broken) {
+                        read_one(file, m_fallback, consume, fail);
+                        continue;
+                    }
+                    int fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (fd < 0) {
+                        fail(file, errno_text(errno));
+                        continue;
+                    }
+                    slot.file = &file;
+                    slot.fd = fd;
+                    slot.done = 0;
+                    if (slot.buf.size() < file.size) slot.buf.resize(static_cast<size_t>(file.size));
+                    queue_read(slot);
+                    in_flight++;
+                    break;
+                }
+            }
+            if (in_flight == 0) continue;
+
+            if (!enter(1)) {
+                // The ring itself failed: finish what is in flight synchronously.
+                m_broken = true;
+                for (Slot& slot : m_slots) {
+                    if (!slot.file) continue;
+                    ::close(slot.fd);
+                    read_one(*slot.file, m_fallback, consume, fail);
+                    slot.file = nullptr;
+                }
+                in_flight = 0;
+                continue;
+            }
+
+            unsigned head = *m_cq_head;
+            const unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+                Slot& slot = m_slots[cqe.user_data];
+                const int res = cqe.res;
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+
+                const FileEntry& file = *slot.file;
+                if (res == -EINTR || res == -EAGAIN) {
+                    queue_read(slot);
+                    continue;
+                }
+                if (res > 0) {
+                    slot.done += static_cast<size_t>(res);
+                    if (slot.done < file.size) {
+                        queue_read(slot); // short read
+                        continue;
+                    }
+                }
+                ::close(slot.fd);
+                slot.file = nullptr;
+                in_flight--;
+                if (res == -EINVAL && slot.done == 0) read_one(file, m_fallback, consume, fail); // no IORING_OP_READ (< 5.6)
+                else if (res < 0) fail(file, errno_text(-res));
+                else consume(file, slot.buf.data(), slot.done); // res == 0: file shrank, scan what is there
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        const FileEntry* file = nullptr; // null when free
+        int fd = -1;
+        size_t done = 0;
+        std::vector<char> buf;
+    };
+
+    explicit UringReader(size_t depth) : m_slots(std::max<size_t>(depth, 1)) {}
+
+    bool setup() {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        m_ring = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(m_slots.size()), &p));
+        if (m_ring < 0) return false;
+
+        m_sq_ring_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cq_ring_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) m_sq_ring_bytes = m_cq_ring_bytes = std::max(m_sq_ring_bytes, m_cq_ring_bytes);
+
+        m_sq_ring = map_ring(m_sq_ring_bytes, IORING_OFF_SQ_RING);
+        if (!m_sq_ring) return false;
+        m_cq_ring = single ? m_sq_ring : map_ring(m_cq_ring_bytes, IORING_OFF_CQ_RING);
+        if (!m_cq_ring) return false;
+        m_sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(map_ring(m_sqes_bytes, IORING_OFF_SQES));
+        if (!m_sqes) return false;
+
+        auto* sq = static_cast<char*>(m_sq_ring);
+        auto* cq = static_cast<char*>(m_cq_ring);
+        m_sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        m_sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        m_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        m_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        m_cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    void* map_ring(size_t bytes, off_t offset) const {
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    // Each slot has at most one read outstanding, so the queue never overflows.
+    void queue_read(Slot& slot) {
+        const unsigned tail = *m_sq_tail;
+        const unsigned idx = tail & *m_sq_mask;
+        io_uring_sqe& sqe = m_sqes[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = slot.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(slot.buf.data() + slot.done);
+        sqe.len = static_cast<unsigned>(slot.file->size - slot.done);
+        sqe.off = slot.done;
+        sqe.user_data = static_cast<uint64_t>(&slot - m_slots.data());
+        m_sq_array[idx] = idx;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        m_pending++;
+    }
+
+    // Submits queued reads and waits for at least `wait` completions.
+    bool enter(unsigned wait) {
+        for (;;) {
+            long n = ::syscall(__NR_io_uring_enter, m_ring, m_pending, wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n >= 0) {
+                m_pending -= static_cast<unsigned>(n);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<char> m_fallback;
+    int m_ring = -1;
+    bool m_broken = false;
+    unsigned m_pending = 0;
+    void* m_sq_ring = nullptr;
+    void* m_cq_ring = nullptr;
+    size_t m_sq_ring_bytes = 0, m_cq_ring_bytes = 0, m_sqes_bytes = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+    unsigned *m_sq_tail = nullptr, *m_sq_mask = nullptr, *m_sq_array = nullptr;
+    unsigned *m_cq_head = nullptr, *m_cq_tail = nullptr, *m_cq_mask = nullptr;
+};
+
+#endif
+
+} // namespace
+
+std::unique_ptr<FileReader> FileReader::create(IoBackend backend, size_t queue_depth) {
+    switch (backend) {
+    case IoBackend::MMAP: return std::make_unique<MmapReader>();
+    case IoBackend::URING: {
+#ifdef DEVSCAN_IO_URING
+        int err = 0;
+        if (auto reader = UringReader::open(queue_depth, err)) return reader;
+        std::string reason = errno_text(err);
+#else
+        (void)queue_depth;
+        std::string reason = "not supported on this platform";
+#endif
+        static std::once_flag warned;
+        std::call_once(warned, [&] {
+            std::cerr << "[FileReader] Warning: io_uring unavailable (" << reason << "), using pread\n";
+        });
+        return std::make_unique<PreadReader>();
+    }
+    case IoBackend::PREAD:
+    default: return std::make_unique<PreadReader>();
+    }
+}
@@ -0,0 +1,207 @@
+#include "KnownFileIndex.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "CacheFiles.h"
+#include "ContentDedup.h"
+#include "DirWalker.h"
+#include "FileReader.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr uint64_t MAGIC = 0x3158444E574B4544ull; // "DEKWNDX1"
+    constexpr uint32_t VERSION = 2;
+    constexpr unsigned BUCKET_BITS = 16;
+    constexpr size_t BUCKETS = size_t{1} << BUCKET_BITS;
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t bucket_bits;
+        uint64_t count;
+    };
+
+    size_t bucket_of(uint64_t hash) { return static_cast<size_t>(hash >> (64 - BUCKET_BITS)); }
+
+    constexpr uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    // One 64-byte block of FIPS 180-4 SHA-256.
+    void sha256_block(uint32_t state[8], const unsigned char* p) {
+        auto rotr = [](uint32_t x, int r) { return (x >> r) | (x << (32 - r)); };
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = uint32_t{p[4 * i]} << 24 | uint32_t{p[4 * i + 1]} << 16 | uint32_t{p[4 * i + 2]} << 8 | p[4 * i + 3];
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+KnownFileIndex::Digest KnownFileIndex::sha256(const void* data, size_t size) {
+    uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    const auto* p = static_cast<const unsigned char*>(data);
+    size_t left = size;
+    for (; left >= 64; left -= 64, p += 64) sha256_block(state, p);
+
+    // Padding: 0x80, zeros, then the message length in bits, big-endian.
+    unsigned char tail[128] = {};
+    if (left) std::memcpy(tail, p, left);
+    tail[left] = 0x80;
+    const size_t blocks = left + 9 > 64 ? 2 : 1;
+    const uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; ++i) tail[blocks * 64 - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    for (size_t b = 0; b < blocks; ++b) sha256_block(state, tail + 64 * b);
+
+    Digest digest;
+    for (int i = 0; i < 32; ++i) digest[i] = static_cast<unsigned char>(state[i / 4] >> (24 - 8 * (i % 4)));
+    return digest;
+}
+
+KnownFileIndex::~KnownFileIndex() = default;
+
+std::unique_ptr<KnownFileIndex> KnownFileIndex::open(const std::string& path) {
+    std::unique_ptr<KnownFileIndex> index(new KnownFileIndex());
+    try {
+        index->m_map = std::make_unique<boost::iostreams::mapped_file_source>(path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[KnownFileIndex] Warning: cannot map " << path << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+    const char* base = index->m_map->data();
+    const size_t size = index->m_map->size();
+    const size_t table = (BUCKETS + 1) * sizeof(uint64_t);
+    Header h{};
+    if (size >= sizeof(Header)) std::memcpy(&h, base, sizeof(h));
+    if (size < sizeof(Header) + table || h.magic != MAGIC || h.version != VERSION
+        || h.bucket_bits != BUCKET_BITS || size != sizeof(Header) + table + h.count * sizeof(Record)) {
+        std::cerr << "[KnownFileIndex] Warning: " << path << " is not a valid index" << std::endl;
+        return nullptr;
+    }
+    // The header is 24 bytes and the mapping page-aligned, so both arrays are 8-aligned.
+    index->m_buckets = reinterpret_cast<const uint64_t*>(base + sizeof(Header));
+    index->m_records = reinterpret_cast<const Record*>(base + sizeof(Header) + table);
+    index->m_count = static_cast<size_t>(h.count);
+    if (index->m_buckets[BUCKETS] != index->m_count) {
+        std::cerr << "[KnownFileIndex] Warning: " << path << " is not a valid index" << std::endl;
+        return nullptr;
+    }
+    return index;
+}
+
+bool KnownFileIndex::contains(const char* data, size_t size, uint64_t hash) const {
+    const size_t b = bucket_of(hash);
+    const Record* first = m_records + m_buckets[b];
+    const Record* last = m_records + m_buckets[b + 1];
+    first = std::lower_bound(first, last, hash, [](const Record& r, uint64_t h) { return r.hash < h; });
+    bool hashed = false;
+    Digest digest{};
+    for (; first != last && first->hash == hash; ++first) {
+        if (first->size != size) continue;
+        if (!hashed) { digest = sha256(data, size); hashed = true; }
+        if (first->digest == digest) return true;
+    }
+    return false;
+}
+
+size_t KnownFileIndex::build(const std::string& root, const std::string& out, unsigned threads) {
+    static_assert(sizeof(Record) == 48, "records are written and mapped as raw bytes");
+    if (threads == 0) threads = 1;
+    std::vector<FileEntry> files;
+    std::mutex files_mutex;
+    DirWalker::walk(root, threads, [&](FileEntry&& file) {
+        if (file.size == 0) return;
+        std::lock_guard<std::mutex> lock(files_mutex);
+        files.push_back(std::move(file));
+    });
+
+    // Each thread reads a strided share of the files in reader-sized batches.
+    std::vector<std::vector<Record>> partial(threads);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            auto reader = FileReader::create(IoBackend::PREAD);
+            std::vector<FileEntry> batch;
+            auto flush = [&] {
+                reader->read(batch.data(), batch.size(),
+                    [&](const FileEntry&, const char* data, size_t size) {
+                        partial[t].push_back(Record{ content_hash(data, size), size, sha256(data, size) });
+                    },
+                    [&](const FileEntry& file, const std::string& error) {
+                        std::cerr << "[KnownFileIndex] Warning: skipped " << file.path << ": " << error << std::endl;
+                    });
+                batch.clear();
+            };
+            for (size_t i = t; i < files.size(); i += threads) {
+                batch.push_back(files[i]);
+                if (batch.size() >= reader->batch_size()) flush();
+            }
+            flush();
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    auto key = [](const Record& r) { return std::tie(r.hash, r.size, r.digest); };
+    std::vector<Record> records;
+    for (auto& p : partial) records.insert(records.end(), p.begin(), p.end());
+    std::sort(records.begin(), records.end(), [&](const Record& a, const Record& b) { return key(a) < key(b); });
+    records.erase(std::unique(records.begin(), records.end(),
+                              [&](const Record& a, const Record& b) { return key(a) == key(b); }),
+                  records.end());
+
+    std::vector<uint64_t> buckets(BUCKETS + 1, 0);
+    for (const Record& r : records) ++buckets[bucket_of(r.hash) + 1];
+    for (size_t b = 1; b <= BUCKETS; ++b) buckets[b] += buckets[b - 1];
+
+    Header h{MAGIC, VERSION, BUCKET_BITS, records.size()};
+    std::error_code ec;
+    fs::path target(out);
+    if (target.has_parent_path()) fs::create_directories(target.parent_path(), ec);
+    const fs::path tmp = temp_path_for(target);
+    bool ok;
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        f.write(reinterpret_cast<const char*>(buckets.data()), static_cast<std::streamsize>(buckets.size() * sizeof(uint64_t)));
+        f.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        ok = static_cast<bool>(f);
+    }
+    if (ok) fs::rename(tmp, target, ec);
+    if (!ok || ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("cannot write " + out);
+    }
+    return records.size();
+}
@@ -0,0 +1,236 @@
+#include "ResultCache.h"
+#include "CacheFiles.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr uint64_t MAGIC = 0x3153455243534544ull; // "DESCRES1"
+    constexpr uint32_t VERSION = 3; // 2: counts are deducted per file; 3: scan root per record
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t width;      // counters per record (signature ids)
+        uint64_t sig_hash;   // signature_set_hash()
+        uint64_t table_hash; // engine name + id -> name layout
+        uint64_t count;      // records
+    };
+
+}
+
+struct ResultCache::Key {
+    // Identity
+    uint64_t device;
+    uint64_t inode;
+    uint64_t path_hash;
+    // Validity: the stored counts hold while both are unchanged
+    uint64_t size;
+    int64_t mtime;
+    // Scan root the record was stored under
+    uint64_t root_hash;
+
+    static Key of(const FileEntry& file, uint64_t root_hash) {
+        return {file.device, file.inode, fnv1a(FNV_OFFSET, file.path), file.size, file.mtime, root_hash};
+    }
+    bool same_file(const Key& o) const {
+        return device == o.device && inode == o.inode && path_hash == o.path_hash;
+    }
+    uint64_t slot_hash() const {
+        uint64_t h = fnv1a(FNV_OFFSET, &device, sizeof(device));
+        h = fnv1a(h, &inode, sizeof(inode));
+        return h ^ path_hash;
+    }
+};
+
+ResultCache::ResultCache(const std::string& dir, const std::string& engine,
+                         std::shared_ptr<const SignatureNames> names, uint64_t sig_hash, const std::string& root)
+    : m_names(std::move(names)), m_sig_hash(sig_hash), m_started(std::time(nullptr)) {
+    std::error_code root_ec;
+    const fs::path absolute_root = fs::weakly_canonical(fs::absolute(root, root_ec), root_ec);
+    m_root_hash = fnv1a(FNV_OFFSET, root_ec ? root : absolute_root.string());
+    m_table_hash = fnv1a(FNV_OFFSET, engine);
+    const size_t width = m_names ? m_names->size() : 0;
+    if (m_names)
+        for (const auto& n : *m_names) m_table_hash = fnv1a(m_table_hash, n);
+    m_stride = (sizeof(Key) + width * sizeof(int32_t) + 7) / 8 * 8;
+
+    std::ostringstream name;
+    name << "results_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(FNV_OFFSET, engine) << ".bin";
+    m_path = (fs::path(dir) / name.str()).string();
+
+    std::error_code ec;
+    if (!m_names || !fs::exists(m_path, ec) || fs::file_size(m_path, ec) < sizeof(Header)) return;
+    try {
+        m_map = std::make_unique<boost::iostreams::mapped_file_source>(m_path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ResultCache] Warning: cannot map " << m_path << ": " << e.what() << std::endl;
+        m_map.reset();
+        return;
+    }
+    Header h;
+    std::memcpy(&h, m_map->data(), sizeof(h));
+    if (h.magic != MAGIC || h.version != VERSION || h.width != width
+        || h.sig_hash != m_sig_hash || h.table_hash != m_table_hash
+        || m_map->size() != sizeof(Header) + h.count * m_stride) {
+        // Another signature set or layout: every entry is stale. save() replaces the file.
+        m_map.reset();
+        return;
+    }
+    m_records = m_map->data() + sizeof(Header);
+    m_count = static_cast<size_t>(h.count);
+    m_visited = std::make_unique<std::atomic<bool>[]>(m_count);
+
+    size_t slots = 16;
+    while (slots < m_count * 2) slots <<= 1;
+    m_index.assign(slots, 0);
+    for (size_t i = 0; i < m_count; ++i) {
+        Key k;
+        std::memcpy(&k, record(i), sizeof(k));
+        size_t s = k.slot_hash() & (slots - 1);
+        while (m_index[s] != 0) s = (s + 1) & (slots - 1);
+        m_index[s] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+ResultCache::~ResultCache() = default;
+
+const char* ResultCache::record(size_t index) const { return m_records + index * m_stride; }
+
+size_t ResultCache::find(const Key& key) const {
+    if (m_index.empty()) return SIZE_MAX;
+    const size_t mask = m_index.size() - 1;
+    for (size_t s = key.slot_hash() & mask; m_index[s] != 0; s = (s + 1) & mask) {
+        Key k;
+        std::memcpy(&k, record(m_index[s] - 1), sizeof(k));
+        if (k.same_file(key)) return m_index[s] - 1;
+    }
+    return SIZE_MAX;
+}
+
+bool ResultCache::lookup(const FileEntry& file, ScanStats& stats) const {
+    const Key key = Key::of(file, m_root_hash);
+    size_t i = find(key);
+    if (i == SIZE_MAX) return false;
+    const char* rec = record(i);
+    Key k;
+    std::memcpy(&k, rec, sizeof(k));
+    if (k.size != key.size || k.mtime != key.mtime) return false;
+    m_visited[i].store(true, std::memory_order_relaxed);
+
+    stats.bind(m_names);
+    const char* counts = rec + sizeof(Key);
+    for (uint32_t id = 0, n = static_cast<uint32_t>(m_names->size()); id < n; ++id) {
+        int32_t c;
+        std::memcpy(&c, counts + id * sizeof(int32_t), sizeof(c));
+        if (c != 0) stats.hit(id, c);
+    }
+    return true;
+}
+
+// Appends the record of `file` to `out`. Counts in another id space are mapped by name;
+// a name this cache has no id for makes the file uncacheable.
+bool ResultCache::encode(const FileEntry& file, const ScanStats& stats, std::vector<char>& out) const {
+    const size_t width = m_names->size();
+    std::vector<int32_t> counts(width, 0);
+    auto add_named = [&](const std::string& name, int n) {
+        auto it = std::find(m_names->begin(), m_names->end(), name);
+        if (it == m_names->end()) return false;
+        counts[static_cast<size_t>(it - m_names->begin())] += n;
+        return true;
+    };
+    if (stats.names == m_names) {
+        for (size_t id = 0; id < width; ++id) counts[id] += stats.hits[id];
+    }
+    else {
+        for (size_t id = 0; id < stats.hits.size(); ++id)
+            if (stats.hits[id] != 0 && !add_named((*stats.names)[id], stats.hits[id])) return false;
+    }
+    for (const auto& [name, n] : stats.counts)
+        if (n != 0 && !add_named(name, n)) return false;
+
+    const Key key = Key::of(file, m_root_hash);
+    const size_t at = out.size();
+    out.resize(at + m_stride, 0);
+    std::memcpy(out.data() + at, &key, sizeof(key));
+    std::memcpy(out.data() + at + sizeof(key), counts.data(), width * sizeof(int32_t));
+    return true;
+}
+
+void ResultCache::store(const FileEntry& file, const ScanStats& stats) {
+    if (!m_names || file.mtime >= static_cast<int64_t>(m_started) - RACY_SECONDS) return;
+    std::vector<char> rec;
+    if (!encode(file, stats, rec)) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.insert(m_pending.end(), rec.begin(), rec.end());
+}
+
+size_t ResultCache::stored() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stride ? m_pending.size() / m_stride : 0;
+}
+
+bool ResultCache::save() {
+    if (!m_names) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t pending = m_pending.size() / m_stride;
+
+    // The newest record of each file wins. A loaded record of this root that no lookup()
+    // found unchanged belongs to a file that is gone, so the cache does not grow with
+    // every deleted or renamed file.
+    auto identity = [](const char* rec) {
+        return std::string(rec, offsetof(Key, size));
+    };
+    std::unordered_set<std::string> seen;
+    std::vector<const char*> out;
+    for (size_t i = pending; i-- > 0;) {
+        const char* rec = m_pending.data() + i * m_stride;
+        if (seen.insert(identity(rec)).second) out.push_back(rec);
+    }
+    for (size_t i = 0; i < m_count; ++i) {
+        Key k;
+        std::memcpy(&k, record(i), sizeof(k));
+        if (k.root_hash == m_root_hash && !m_visited[i].load(std::memory_order_relaxed)) continue;
+        if (!seen.count(identity(record(i)))) out.push_back(record(i));
+    }
+
+    Header h{MAGIC, VERSION, static_cast<uint32_t>(m_names->size()), m_sig_hash, m_table_hash, out.size()};
+
+    // A concurrent run maps either the old file or the new one, whole.
+    std::error_code ec;
+    fs::path target(m_path);
+    fs::create_directories(target.parent_path(), ec);
+    const fs::path tmp = temp_path_for(target);
+    bool ok;
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        for (const char* rec : out) f.write(rec, static_cast<std::streamsize>(m_stride));
+        ok = static_cast<bool>(f);
+    }
+
+    m_index.clear();
+    m_visited.reset();
+    m_records = nullptr;
+    m_count = 0;
+    m_map.reset();
+    m_pending.clear();
+
+    if (ok) fs::rename(tmp, target, ec);
+    if (!ok || ec) {
+        fs::remove(tmp, ec);
+        std::cerr << "[ResultCache] Warning: cannot write " << m_path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -1,13 +1,41 @@
 #include "Scanner.h"
+#include "CacheFiles.h"
+#include "ConfigLoader.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <mutex>
+#include <thread>
 #include <re2/re2.h>
 #include <re2/set.h>
 #include <hs/hs.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#define DEVSCAN_X86 1
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace fs = std::filesystem;
 
 namespace {
+    // "??" is a wildcard byte; every engine compiles with dot-matches-all over bytes.
     std::string hex_to_regex_str(const std::string& hex) {
         if (hex.empty()) return "";
         if (hex.length() % 2 != 0) {
@@ -17,6 +45,10 @@ namespace {
         std::ostringstream ss;
         for (size_t i = 0; i + 1 < hex.length(); i += 2) {
             char c1 = hex[i], c2 = hex[i + 1];
+            if (c1 == '?' && c2 == '?') {
+                ss << '.';
+                continue;
+            }
             if (!std::isxdigit(static_cast<unsigned char>(c1)) ||
                 !std::isxdigit(static_cast<unsigned char>(c2))) {
                 std::cerr << "[Scanner] Warning: non-hex chars at pos " << i
@@ -43,177 +75,3397 @@ namespace {
 
         return "";
     }
-}
 
-// NOTE: deduction is single-pass (flat). Transitive chains (A deducts B, B deducts C)
-// are not supported — if such chains are added to signatures.json, a topological-sort
-// pass will be required here.
-void apply_deduction(ScanStats& stats, const std::vector<SignatureDefinition>& sigs) {
-    for (const auto& def : sigs) {
-        if (!def.deduct_from.empty()) {
-            const std::string& child = def.name;
-            const std::string& parent = def.deduct_from;
-            if (stats.counts.count(child) && stats.counts.count(parent)) {
-                int child_count = stats.counts[child];
-                stats.counts[parent] = std::max(0, stats.counts[parent] - child_count);
+    // What a search looks for: a whole signature, or the head or the tail of a `head.*?tail` one.
+    enum class MatchPart { WHOLE, HEAD, TAIL };
+
+    // Matches of deduct_from signatures (absolute offsets), kept where the buffer cannot be
+    // searched again (streams, Hyperscan, segments) so DeductionPlan::count() can place them.
+    class TrackedSpans {
+    public:
+        explicit TrackedSpans(size_t ids = 0) : m_whole(ids), m_heads(ids), m_tails(ids) {}
+
+        void whole(uint32_t id, uint64_t from, uint64_t to) { m_whole[id].emplace_back(from, to); }
+        void head(uint32_t id, uint64_t from, uint64_t to) { m_heads[id].emplace_back(from, to); }
+        void tail(uint32_t id, uint64_t from, uint64_t to) { m_tails[id].emplace_back(from, to); }
+        void merge(const TrackedSpans& other) {
+            auto append = [](std::vector<std::vector<Span>>& to, const std::vector<std::vector<Span>>& from) {
+                for (size_t id = 0; id < from.size(); ++id)
+                    to[id].insert(to[id].end(), from[id].begin(), from[id].end());
+            };
+            append(m_whole, other.m_whole);
+            append(m_heads, other.m_heads);
+            append(m_tails, other.m_tails);
+        }
+
+        // Counts the tracked signatures of one input of `size` bytes into `stats`.
+        void count(const DeductionPlan& plan, uint64_t size, ScanStats& stats) {
+            if (plan.empty()) return;
+            for (auto* spans : {&m_whole, &m_heads, &m_tails})
+                for (auto& of_id : *spans) std::sort(of_id.begin(), of_id.end());
+            plan.count(static_cast<size_t>(size), [this](uint32_t id, size_t from, size_t& mb, size_t& me) {
+                if (const Span* w = first_from(m_whole[id], from)) {
+                    mb = static_cast<size_t>(w->first);
+                    me = static_cast<size_t>(w->second);
+                    return true;
+                }
+                const Span* h = first_from(m_heads[id], from);
+                const Span* t = h ? first_from(m_tails[id], h->second) : nullptr;
+                if (!t) return false;
+                mb = static_cast<size_t>(h->first);
+                me = static_cast<size_t>(t->second);
+                return true;
+            }, stats);
+        }
+
+    private:
+        using Span = std::pair<uint64_t, uint64_t>; // [from, to)
+
+        static const Span* first_from(const std::vector<Span>& spans, uint64_t from) {
+            auto it = std::lower_bound(spans.begin(), spans.end(), Span{from, 0});
+            return it == spans.end() ? nullptr : &*it;
+        }
+
+        std::vector<std::vector<Span>> m_whole, m_heads, m_tails; // by id
+    };
+
+    // Carry-over streaming for RE2/Boost: each window is the new bytes plus STREAM_CARRY_BYTES of
+    // history, searched from per-pattern absolute cursors so a match is counted once.
+    class CarryOverStream : public ScanStream {
+    public:
+        using Part = MatchPart;
+
+        // `plan`, `bounds` and `shapes` must outlive the stream (they belong to the compiled
+        // state the derived stream holds).
+        CarryOverStream(std::shared_ptr<const SignatureNames> names, const DeductionPlan& plan,
+                        const std::vector<SignatureBounds>& bounds, const std::vector<SignatureShape>& shapes,
+                        ScanStats& stats)
+            : m_stats(stats), m_names(std::move(names)), m_plan(plan), m_bounds(bounds), m_shapes(shapes),
+              m_cursors(bounds.size(), 0), m_tails(bounds.size(), 0), m_active(bounds.size(), 1),
+              m_held(bounds.size(), 0), m_done(bounds.size(), 0), m_tracked(m_names->size()) {
+            for (size_t i = 0; i < shapes.size(); ++i)
+                if (shapes[i].kind == SignatureShape::Kind::HEAD_TAIL && !plan.tracks(static_cast<uint32_t>(i)))
+                    m_tails[i] = NO_HEAD;
+        }
+
+        void write(const char* data, size_t size) override {
+            if (m_closed || size == 0) return;
+            m_stats.bind(m_names);
+            try {
+                consume(data, size);
+            }
+            catch (...) {
+                m_closed = true; // a find threw (time budget): the stream is dropped, not closed again
+                throw;
+            }
+        }
+
+        void close() override {
+            if (m_closed) return;
+            m_closed = true;
+            m_stats.bind(m_names);
+            if (m_pending) search(m_buf.data(), m_buf.size(), m_base, m_buf.size());
+            // What was held back at the end of the last window is whole now.
+            search(m_buf.data(), m_buf.size(), m_base, m_buf.size(), true);
+            m_tracked.count(m_plan, m_base + m_buf.size(), m_stats);
+            m_buf.clear();
+            m_buf.shrink_to_fit();
+        }
+
+    private:
+        static constexpr uint64_t NO_HEAD = UINT64_MAX; // m_tails: no head open
+
+        void consume(const char* data, size_t size) {
+            // Searching the carry again on every packet-sized write would cost a carry per
+            // write; a batch costs it once per STREAM_CARRY_BYTES written.
+            if (size <= STREAM_CARRY_BYTES) {
+                m_buf.append(data, size);
+                m_pending += size;
+                if (m_pending < STREAM_CARRY_BYTES) return;
+                search(m_buf.data(), m_buf.size(), m_base, m_buf.size());
+                m_pending = 0;
+                if (m_buf.size() > STREAM_CARRY_BYTES) {
+                    size_t drop = m_buf.size() - STREAM_CARRY_BYTES;
+                    m_buf.erase(0, drop);
+                    m_base += drop;
+                }
+                return;
+            }
+            // A large chunk is searched where it lies. Only the matches starting in the
+            // carry need the two joined, and those end within the carry's reach.
+            const uint64_t chunk_base = m_base + m_buf.size();
+            if (!m_buf.empty()) {
+                const size_t seam = m_buf.size();
+                m_buf.append(data, STREAM_CARRY_BYTES);
+                search(m_buf.data(), m_buf.size(), m_base, seam);
+            }
+            search(data, size, chunk_base, size);
+            m_pending = 0;
+            m_buf.assign(data + size - STREAM_CARRY_BYTES, STREAM_CARRY_BYTES);
+            m_base = chunk_base + size - STREAM_CARRY_BYTES;
+        }
+
+        static size_t rel(uint64_t at, uint64_t base) { return at > base ? static_cast<size_t>(at - base) : 0; }
+
+        // window[0, size) at stream offset `base`.
+        struct Window {
+            const char* begin;
+            size_t size;
+            uint64_t base;
+            size_t starts_before;
+            bool last;
+
+            // Matches starting before this are whole in the window; later ones of up to
+            // `len` bytes may be cut short by its end.
+            size_t whole(size_t len) const {
+                if (last || len >= STREAM_CARRY_BYTES) return starts_before;
+                return std::min(starts_before, size - std::min(size, len));
+            }
+        };
+
+        // Counts window[0, size) (stream offset `base`) from each cursor up to `starts_before`;
+        // `last` ends the stream, releasing held-back matches.
+        void search(const char* begin, size_t size, uint64_t base, size_t starts_before, bool last = false) {
+            const char* end = begin + size;
+            uint64_t min_cursor = UINT64_MAX;
+            for (uint64_t c : m_cursors) min_cursor = std::min(min_cursor, c);
+            size_t min_rel = rel(min_cursor, base);
+            std::fill(m_active.begin(), m_active.end(), 1);
+            if (min_rel < size && !last) select(begin + min_rel, end, m_active);
+
+            for (size_t i = 0; i < m_cursors.size(); ++i) {
+                if (m_done[i] || (last && !m_held[i])) continue;
+                m_held[i] = 0;
+                const Window w{begin, size, base, starts_before, last};
+                if (m_shapes[i].kind != SignatureShape::Kind::HEAD_TAIL) whole(i, w);
+                else if (!m_plan.tracks(static_cast<uint32_t>(i))) pair(i, w);
+                else {
+                    gather(i, Part::HEAD, w, m_cursors[i]);
+                    gather(i, Part::TAIL, w, m_tails[i]);
+                }
+            }
+        }
+
+        // BOUNDED and SEQUENTIAL signatures: leftmost non-overlapping matches from the cursor.
+        void whole(size_t i, const Window& w) {
+            const auto id = static_cast<uint32_t>(i);
+            const SignatureShape& shape = m_shapes[i];
+            const bool bounded = shape.kind == SignatureShape::Kind::BOUNDED;
+            const size_t whole = bounded ? w.whole(shape.max_len) : w.starts_before;
+            const size_t stop = m_bounds[i].limit(w.size, w.base); // max_offset
+            size_t cur = rel(m_cursors[i], w.base);
+            const char* mb = nullptr;
+            const char* me = nullptr;
+            while (m_active[i] && cur < stop
+                   && find(i, Part::WHOLE, w.begin, w.begin + cur, w.begin + stop, mb, me)) {
+                const auto at = static_cast<size_t>(mb - w.begin);
+                if (at >= whole) {
+                    if (at < w.starts_before) m_held[i] = 1;
+                    break;
+                }
+                if (m_plan.tracks(id)) m_tracked.whole(id, w.base + at, w.base + static_cast<size_t>(me - w.begin));
+                else m_stats.hit(id);
+                cur = at + std::max<size_t>(1, static_cast<size_t>(me - mb));
+                if (shape.single) {
+                    m_done[i] = 1;
+                    break;
+                }
+            }
+            // No BOUNDED match starts in [cur, whole): later windows need not look there.
+            if (bounded) cur = std::max(cur, whole);
+            m_cursors[i] = w.base + cur;
+        }
+
+        // Untracked HEAD_TAIL: the first head from the cursor opens, the first tail after
+        // it closes the match; m_tails[i] is where the open head's tail search resumes.
+        void pair(size_t i, const Window& w) {
+            size_t cur = rel(m_cursors[i], w.base), at, to;
+            for (;;) {
+                if (m_tails[i] == NO_HEAD) {
+                    if (!next(i, Part::HEAD, w, cur, at, to)) break;
+                    m_tails[i] = w.base + to;
+                }
+                size_t from = rel(m_tails[i], w.base);
+                if (!next(i, Part::TAIL, w, from, at, to)) {
+                    m_tails[i] = w.base + from;
+                    break;
+                }
+                m_stats.hit(static_cast<uint32_t>(i));
+                m_tails[i] = NO_HEAD;
+                cur = to;
+            }
+            m_cursors[i] = w.base + cur;
+        }
+
+        // Tracked HEAD_TAIL: records every start of one part from `cursor` on.
+        void gather(size_t i, Part part, const Window& w, uint64_t& cursor) {
+            const auto id = static_cast<uint32_t>(i);
+            size_t cur = rel(cursor, w.base), at, to;
+            while (next(i, part, w, cur, at, to)) {
+                if (part == Part::HEAD) m_tracked.head(id, w.base + at, w.base + to);
+                else m_tracked.tail(id, w.base + at, w.base + to);
+                cur = at + 1;
+            }
+            cursor = w.base + cur;
+        }
+
+        // First `part` of pattern `i` starting at or after `cur` that the window holds
+        // whole, as [at, to). Without one, `cur` moves past the starts ruled out.
+        bool next(size_t i, Part part, const Window& w, size_t& cur, size_t& at, size_t& to) {
+            const size_t whole = w.whole(part == Part::HEAD ? m_shapes[i].head_len : m_shapes[i].tail_len);
+            const char* mb = nullptr;
+            const char* me = nullptr;
+            if (cur < w.size && find(i, part, w.begin, w.begin + cur, w.begin + w.size, mb, me)) {
+                at = static_cast<size_t>(mb - w.begin);
+                if (at < whole) {
+                    to = static_cast<size_t>(me - w.begin);
+                    return true;
+                }
+                if (at < w.starts_before) m_held[i] = 1;
+            }
+            cur = std::max(cur, whole);
+            return false;
+        }
+
+    protected:
+        // First match of `part` of pattern `idx` starting at or after `from` and ending by
+        // `end`. `begin` is the start of the window searched.
+        virtual bool find(size_t idx, Part part, const char* begin, const char* from, const char* end,
+                          const char*& m_begin, const char*& m_end) = 0;
+        // Optional prefilter over the region that can still yield matches: clear
+        // active[i] for patterns that certainly do not match there.
+        virtual void select(const char*, const char*, std::vector<char>&) {}
+
+    private:
+        ScanStats& m_stats;
+        std::shared_ptr<const SignatureNames> m_names;
+        const DeductionPlan& m_plan;
+        const std::vector<SignatureBounds>& m_bounds;
+        const std::vector<SignatureShape>& m_shapes;
+        std::string m_buf;
+        uint64_t m_base = 0;   // stream offset of m_buf[0]
+        size_t m_pending = 0;  // bytes at the end of m_buf not searched yet
+        std::vector<uint64_t> m_cursors; // HEAD_TAIL: of the heads
+        std::vector<uint64_t> m_tails;   // HEAD_TAIL: of the tails (NO_HEAD: untracked, none open)
+        std::vector<char> m_active;
+        std::vector<char> m_held;        // something was held back for the next window
+        std::vector<char> m_done;        // SignatureShape::single, counted
+        TrackedSpans m_tracked;
+        bool m_closed = false;
+    };
+
+    // ---- Intra-buffer parallelism (scan_parallel) ----
+
+    constexpr size_t UNBOUNDED = SIZE_MAX;
+    constexpr size_t MIN_SEGMENT_BYTES = 4 * 1024 * 1024;
+    constexpr size_t MAX_SEGMENT_BYTES = 1024 * 1024 * 1024; // hs_scan takes a 32-bit length
+    constexpr size_t RESYNC_MATCHES = 16;  // BOUNDED matches remembered per segment for the merge
+    constexpr size_t INDEXED_STARTS = 1024; // HEAD_TAIL head/tail starts indexed per segment
+
+    // Longest match of a signature regex in bytes, or UNBOUNDED when it cannot tell.
+    class MaxLength {
+    public:
+        explicit MaxLength(const std::string& re) : m_re(re) {}
+
+        size_t run() {
+            size_t n = alternation();
+            return m_failed || m_pos != m_re.size() ? UNBOUNDED : n;
+        }
+
+    private:
+        static size_t add(size_t a, size_t b) { return a == UNBOUNDED || b == UNBOUNDED ? UNBOUNDED : a + b; }
+        static size_t mul(size_t a, size_t b) {
+            if (a == 0 || b == 0) return 0;
+            return a == UNBOUNDED || b == UNBOUNDED || a > UNBOUNDED / b ? UNBOUNDED : a * b;
+        }
+        bool more() const { return !m_failed && m_pos < m_re.size(); }
+        char peek() const { return m_re[m_pos]; }
+        size_t fail() { m_failed = true; return UNBOUNDED; }
+
+        size_t alternation() {
+            size_t best = sequence();
+            while (more() && peek() == '|') {
+                ++m_pos;
+                best = std::max(best, sequence());
+            }
+            return best;
+        }
+
+        size_t sequence() {
+            size_t total = 0;
+            while (more() && peek() != '|' && peek() != ')') total = add(total, quantified(atom()));
+            return total;
+        }
+
+        size_t atom() {
+            char c = m_re[m_pos++];
+            switch (c) {
+            case '(': {
+                if (more() && peek() == '?') {
+                    ++m_pos;
+                    while (more() && (std::isalpha(static_cast<unsigned char>(peek())) || peek() == '-')) ++m_pos;
+                    if (more() && peek() == ')') { ++m_pos; return 0; } // inline flags, e.g. (?i)
+                    if (!more() || peek() != ':') return fail();        // lookaround, named group
+                    ++m_pos;
+                }
+                size_t n = alternation();
+                if (!more() || peek() != ')') return fail();
+                ++m_pos;
+                return n;
+            }
+            case '[': {
+                if (more() && peek() == '^') ++m_pos;
+                if (more() && peek() == ']') ++m_pos;
+                while (more() && peek() != ']') {
+                    if (peek() == '\\') ++m_pos;
+                    else if (peek() == '[' && m_pos + 1 < m_re.size() && m_re[m_pos + 1] == ':') {
+                        size_t close = m_re.find(":]", m_pos + 2);
+                        if (close == std::string::npos) return fail();
+                        m_pos = close + 1;
+                    }
+                    ++m_pos;
+                }
+                if (!more()) return fail();
+                ++m_pos;
+                return 1;
+            }
+            case '\\': {
+                if (!more()) return fail();
+                char e = m_re[m_pos++];
+                if (e == 'x') {
+                    if (more() && peek() == '{') {
+                        size_t close = m_re.find('}', m_pos);
+                        if (close == std::string::npos) return fail();
+                        m_pos = close + 1;
+                    }
+                    else {
+                        m_pos = std::min(m_pos + 2, m_re.size());
+                    }
+                    return 1;
+                }
+                if (e == 'b' || e == 'B' || e == 'A' || e == 'z' || e == 'Z' || e == 'G') return 0;
+                if (std::isdigit(static_cast<unsigned char>(e))) return fail(); // backreference
+                if (e == 'Q') {
+                    size_t close = m_re.find("\\E", m_pos);
+                    size_t stop = close == std::string::npos ? m_re.size() : close;
+                    size_t n = stop - m_pos;
+                    m_pos = close == std::string::npos ? stop : close + 2;
+                    return n;
+                }
+                return 1;
+            }
+            case '^':
+            case '$':
+                return 0;
+            case '*':
+            case '+':
+            case '?':
+                return fail();
+            default:
+                return 1;
+            }
+        }
+
+        size_t quantified(size_t n) {
+            if (!more()) return n;
+            size_t r;
+            char c = peek();
+            if (c == '*' || c == '+') {
+                ++m_pos;
+                r = n == 0 ? 0 : UNBOUNDED;
+            }
+            else if (c == '?') {
+                ++m_pos;
+                r = n;
+            }
+            else if (c == '{') {
+                // {n}, {n,}, {n,m}; anything else is a literal brace
+                size_t close = m_re.find('}', m_pos);
+                if (close == std::string::npos) return n;
+                std::string body = m_re.substr(m_pos + 1, close - m_pos - 1);
+                size_t comma = body.find(',');
+                std::string lo = body.substr(0, comma);
+                std::string hi = comma == std::string::npos ? lo : body.substr(comma + 1);
+                auto digits = [](const std::string& d) {
+                    return std::all_of(d.begin(), d.end(), [](char ch) { return std::isdigit(static_cast<unsigned char>(ch)) != 0; });
+                };
+                if (lo.empty() || !digits(lo) || !digits(hi)) return n;
+                m_pos = close + 1;
+                r = hi.empty() ? (n == 0 ? 0 : UNBOUNDED) : mul(n, std::stoull(hi));
+            }
+            else {
+                return n;
             }
+            if (more() && (peek() == '?' || peek() == '+')) ++m_pos; // lazy / possessive
+            return r;
         }
+
+        const std::string& m_re;
+        size_t m_pos = 0;
+        bool m_failed = false;
+    };
+
+    // Bytes a segment's window reaches past its end so BOUNDED and HEAD_TAIL matches starting in it
+    // are seen whole.
+    size_t shapes_overlap(const std::vector<SignatureShape>& shapes) {
+        size_t overlap = 0;
+        for (const auto& s : shapes) {
+            if (s.kind == SignatureShape::Kind::BOUNDED) overlap = std::max(overlap, s.max_len);
+            if (s.kind == SignatureShape::Kind::HEAD_TAIL) overlap = std::max(overlap, s.head_len + s.tail_len);
+        }
+        return overlap + 1;
     }
-}
 
-std::unique_ptr<Scanner> Scanner::create(EngineType type) {
-    switch (type) {
-    case EngineType::BOOST: return std::make_unique<BoostScanner>();
-    case EngineType::RE2:   return std::make_unique<Re2Scanner>();
-    case EngineType::HYPERSCAN: return std::make_unique<HsScanner>();
-    default: return std::make_unique<HsScanner>();
+    // Segment k is [starts[k], starts[k + 1]); starts.back() == size.
+    std::vector<size_t> plan_segments(size_t size, unsigned threads, size_t overlap, size_t segment_bytes) {
+        if (segment_bytes == 0)
+            segment_bytes = std::max(MIN_SEGMENT_BYTES, size / (std::max(threads, 1u) * size_t{4}) + 1);
+        segment_bytes = std::min(std::max(segment_bytes, overlap * 2), MAX_SEGMENT_BYTES);
+        std::vector<size_t> starts;
+        for (size_t s = 0; s < size; s += segment_bytes) starts.push_back(s);
+        starts.push_back(size);
+        return starts;
     }
-}
 
-// === Boost ===
-std::string BoostScanner::name() const { return "Boost.Regex"; }
-void BoostScanner::prepare(const std::vector<SignatureDefinition>& sigs) {
-    m_regexes.clear();
-    for (const auto& s : sigs) {
-        std::string pat = build_pattern(s);
-        if (pat.empty()) continue;
-        try {
-            auto flags = boost::regex::optimize | boost::regex::mod_s;
-            if (s.type == SignatureType::TEXT) flags |= boost::regex::icase;
-            m_regexes.emplace_back(boost::regex(pat, flags), s.name);
+    // Runs job(index, worker) for [0, count) on up to `threads` threads (caller is worker 0);
+    // the first exception stops the rest and is rethrown after the join.
+    template <typename Job>
+    void run_jobs(size_t count, unsigned threads, Job&& job) {
+        const unsigned workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&](unsigned w) {
+            try {
+                for (size_t i; (i = next.fetch_add(1)) < count;) job(i, w);
+            }
+            catch (...) {
+                next = count;
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        };
+        std::vector<std::thread> helpers;
+        for (unsigned w = 1; w < workers; ++w) helpers.emplace_back(worker, w);
+        worker(0);
+        for (auto& t : helpers) t.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Exact segment parallelism for RE2/Boost: BOUNDED segments are stitched at the true resume
+    // cursor, HEAD_TAIL chains indexed heads and tails, SEQUENTIAL runs once over the buffer.
+    class LeftmostSegments {
+    public:
+        using Part = MatchPart;
+        // Leftmost match of a part of pattern `id` starting at or after `from` in data[0, end).
+        using Find = std::function<bool(uint32_t id, Part part, size_t from, size_t end, size_t& mb, size_t& me)>;
+        // Clears active[id] for patterns without a match in data[from, end).
+        using Select = std::function<void(size_t from, size_t end, std::vector<char>& active)>;
+
+        LeftmostSegments(const std::vector<SignatureShape>& shapes, const DeductionPlan& plan, size_t size,
+                         std::vector<size_t> starts, size_t overlap, Find find, Select select)
+            : m_shapes(shapes), m_plan(plan), m_size(size), m_starts(std::move(starts)), m_overlap(overlap),
+              m_find(std::move(find)), m_select(std::move(select)) {}
+
+        std::vector<uint64_t> run(unsigned threads) {
+            const size_t n = m_shapes.size();
+            const size_t segments = m_starts.size() - 1;
+            std::vector<uint32_t> sequential, merged;
+            for (uint32_t id = 0; id < n; ++id)
+                if (!m_plan.tracks(id))
+                    (m_shapes[id].kind == SignatureShape::Kind::SEQUENTIAL ? sequential : merged).push_back(id);
+
+            std::vector<uint64_t> totals(n, 0);
+            m_runs.assign(segments, std::vector<Run>(n));
+            run_jobs(segments + sequential.size(), threads, [&](size_t job, unsigned) {
+                if (job < segments) scan_segment(job);
+                else totals[sequential[job - segments]] = count_all(sequential[job - segments]);
+            });
+            run_jobs(merged.size(), threads, [&](size_t i, unsigned) {
+                const uint32_t id = merged[i];
+                totals[id] = m_shapes[id].kind == SignatureShape::Kind::HEAD_TAIL ? chain(id) : merge(id);
+            });
+            return totals;
         }
-        catch (const std::exception& e) {
-            std::cerr << "[BoostScanner] Failed to compile pattern for '"
-                      << s.name << "': " << e.what() << "\n";
+
+        // Counts the tracked signatures into `stats` (bound to the scanner's names), after run().
+        void count_tracked(ScanStats& stats) const {
+            m_plan.count(m_size, [this](uint32_t id, size_t from, size_t& mb, size_t& me) {
+                switch (m_shapes[id].kind) {
+                case SignatureShape::Kind::HEAD_TAIL:
+                    return head_tail(id, from, mb, me);
+                case SignatureShape::Kind::BOUNDED:
+                    for (size_t k = segment_of(from); k + 1 < m_starts.size(); from = m_starts[++k])
+                        if (step(id, from, k, mb, me)) return true;
+                    return false;
+                default:
+                    return from < m_size && m_find(id, Part::WHOLE, from, m_size, mb, me);
+                }
+            }, stats);
+        }
+
+    private:
+        // Starts of one part inside a segment; complete below `until`, past which the
+        // segment is searched again on demand (parts too frequent to index).
+        struct Starts {
+            std::vector<size_t> at;
+            size_t until = 0;
+        };
+
+        struct Run {
+            // BOUNDED
+            uint64_t count = 0;
+            size_t last_end = 0; // resume cursor after the segment's last match
+            std::vector<std::pair<size_t, size_t>> first; // first RESYNC_MATCHES matches
+            // HEAD_TAIL
+            Starts heads, tails;
+        };
+
+        size_t window_end(size_t k) const { return std::min(m_size, m_starts[k + 1] + m_overlap); }
+        size_t part_len(uint32_t id, Part part) const {
+            return part == Part::HEAD ? m_shapes[id].head_len : m_shapes[id].tail_len;
+        }
+        static size_t advance(size_t mb, size_t me) { return me > mb ? me : mb + 1; }
+
+        // Next BOUNDED match of `id` from `from` that starts in segment k.
+        bool step(uint32_t id, size_t from, size_t k, size_t& mb, size_t& me) const {
+            const size_t hi = m_starts[k + 1];
+            return from < hi && m_find(id, Part::WHOLE, from, window_end(k), mb, me) && mb < hi;
+        }
+
+        // First start of `part` in [from, hi) of segment k, searched directly.
+        bool search_part(uint32_t id, Part part, size_t from, size_t k, size_t& at) const {
+            const size_t hi = m_starts[k + 1];
+            size_t me;
+            return from < hi && m_find(id, part, from, std::min(m_size, hi + part_len(id, part) + 1), at, me) && at < hi;
+        }
+
+        void index_part(uint32_t id, Part part, size_t k, Starts& out) const {
+            out.until = m_starts[k + 1];
+            size_t at;
+            for (size_t from = m_starts[k]; search_part(id, part, from, k, at); from = at + 1) {
+                if (out.at.size() == INDEXED_STARTS) {
+                    out.until = at;
+                    return;
+                }
+                out.at.push_back(at);
+            }
+        }
+
+        // Segment holding offset `at`.
+        size_t segment_of(size_t at) const {
+            const auto after = std::upper_bound(m_starts.begin(), m_starts.end(), at);
+            return after == m_starts.begin() ? 0 : static_cast<size_t>(after - m_starts.begin()) - 1;
+        }
+
+        // First start of `part` at or after `from`, anywhere in the buffer.
+        bool next_part(uint32_t id, Part part, size_t from, size_t& at) const {
+            for (size_t k = segment_of(from); k + 1 < m_starts.size(); ++k, from = m_starts[k]) {
+                const Run& run = m_runs[k][id];
+                const Starts& starts = part == Part::HEAD ? run.heads : run.tails;
+                if (from < starts.until) {
+                    auto it = std::lower_bound(starts.at.begin(), starts.at.end(), from);
+                    if (it != starts.at.end()) {
+                        at = *it;
+                        return true;
+                    }
+                    from = starts.until;
+                }
+                if (search_part(id, part, from, k, at)) return true;
+            }
+            return false;
         }
+
+        void scan_segment(size_t k) {
+            const size_t lo = m_starts[k];
+            std::vector<char> active(m_shapes.size(), 1);
+            if (m_select) m_select(lo, window_end(k), active);
+
+            for (uint32_t id = 0; id < m_shapes.size(); ++id) {
+                Run& run = m_runs[k][id];
+                if (m_shapes[id].kind == SignatureShape::Kind::HEAD_TAIL) {
+                    index_part(id, Part::HEAD, k, run.heads);
+                    index_part(id, Part::TAIL, k, run.tails);
+                    continue;
+                }
+                if (m_shapes[id].kind != SignatureShape::Kind::BOUNDED || m_plan.tracks(id)) continue;
+                run.last_end = lo;
+                if (!active[id]) continue;
+                size_t mb, me;
+                while (step(id, run.last_end, k, mb, me)) {
+                    if (run.first.size() < RESYNC_MATCHES) run.first.emplace_back(mb, me);
+                    run.count++;
+                    run.last_end = advance(mb, me);
+                }
+            }
+        }
+
+        uint64_t merge(uint32_t id) const {
+            uint64_t total = 0;
+            size_t cur = 0; // resume cursor of the single-threaded match sequence
+            for (size_t k = 0; k + 1 < m_starts.size(); ++k) {
+                const size_t lo = m_starts[k], hi = m_starts[k + 1];
+                if (cur >= hi) continue;
+                const Run& run = m_runs[k][id];
+                if (cur <= lo) {
+                    total += run.count;
+                    cur = run.last_end;
+                    continue;
+                }
+                size_t j = 0, mb, me;
+                while (step(id, cur, k, mb, me)) {
+                    while (j < run.first.size() && run.first[j].first < mb) ++j;
+                    if (j < run.first.size() && run.first[j].first == mb) {
+                        total += run.count - j;
+                        cur = run.last_end;
+                        break;
+                    }
+                    total++;
+                    cur = advance(mb, me);
+                }
+            }
+            return total;
+        }
+
+        // Leftmost HEAD_TAIL match from `from`.
+        bool head_tail(uint32_t id, size_t from, size_t& mb, size_t& me) const {
+            size_t tail, tb;
+            return next_part(id, Part::HEAD, from, mb)
+                && next_part(id, Part::TAIL, mb + m_shapes[id].head_len, tail)
+                && m_find(id, Part::TAIL, tail, std::min(m_size, tail + m_overlap), tb, me);
+        }
+
+        uint64_t chain(uint32_t id) const {
+            uint64_t total = 0;
+            size_t cur = 0, mb, me;
+            while (head_tail(id, cur, mb, me)) {
+                total++;
+                cur = me;
+            }
+            return total;
+        }
+
+        uint64_t count_all(uint32_t id) const {
+            uint64_t total = 0;
+            size_t cur = 0, mb, me;
+            while (cur < m_size && m_find(id, Part::WHOLE, cur, m_size, mb, me)) {
+                total++;
+                cur = advance(mb, me);
+            }
+            return total;
+        }
+
+        const std::vector<SignatureShape>& m_shapes;
+        const DeductionPlan& m_plan;
+        size_t m_size;
+        std::vector<size_t> m_starts;
+        size_t m_overlap;
+        Find m_find;
+        Select m_select;
+        std::vector<std::vector<Run>> m_runs; // [segment][pattern]
+    };
+
+    // Leftmost bounded head/tail match in [from, end); the tail search stops at max_gap.
+    template <typename Part>
+    bool find_windowed(const SignatureBounds& b, size_t tail_len, size_t from, size_t end,
+                       const Part& head, const Part& tail, size_t& mb, size_t& me) {
+        size_t hb = 0, he = 0, tb = 0, te = 0;
+        while (from < end && head(from, end, hb, he)) {
+            const size_t last = b.max_gap ? static_cast<size_t>(std::min<uint64_t>(end, he + b.max_gap)) : end;
+            const size_t stop = b.max_gap && tail_len != UNBOUNDED ? std::min(end, last + tail_len) : end;
+            for (size_t t = he; t <= last; t = tb + 1) {
+                if (!tail(t, stop, tb, te)) {
+                    if (stop == end) return false; // no tail after this head, nor after any later one
+                    break;
+                }
+                if (tb > last) break;
+                if (te - hb >= b.min_length) {
+                    mb = hb;
+                    me = te;
+                    return true;
+                }
+            }
+            from = hb + 1;
+        }
+        return false;
     }
-}
-void BoostScanner::scan(const char* data, size_t size, ScanStats& stats) {
-    const char* end = data + size;
-    for (const auto& [re, name] : m_regexes) {
-        boost::cmatch m;
-        const char* cur = data;
-        while (cur < end && boost::regex_search(cur, end, m, re)) {
-            stats.add(name);
-            cur += m.position() + std::max(static_cast<std::ptrdiff_t>(1), m.length());
+
+    void add_totals(ScanStats& stats, const std::shared_ptr<const SignatureNames>& names,
+                    const std::vector<uint64_t>& totals) {
+        stats.bind(names);
+        for (uint32_t id = 0; id < totals.size(); ++id)
+            if (totals[id]) stats.hit(id, static_cast<int>(totals[id]));
+    }
+
+    // A top-level greedy `.*`/`.+` makes the first match swallow every later one.
+    bool swallows_later_matches(const std::string& pattern) {
+        size_t depth = 0;
+        bool greedy = false;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            const char c = pattern[i];
+            if (c == '\\') {
+                ++i;
+            }
+            else if (c == '[') {
+                size_t j = i + 1;
+                if (j < pattern.size() && pattern[j] == '^') ++j;
+                if (j < pattern.size() && pattern[j] == ']') ++j;
+                while (j < pattern.size() && pattern[j] != ']') j += pattern[j] == '\\' ? 2 : 1;
+                i = j;
+            }
+            else if (c == '(') {
+                if (pattern.compare(i, 2, "(?") == 0 && pattern.compare(i, 3, "(?:") != 0) return false;
+                ++depth;
+            }
+            else if (c == ')') {
+                if (depth == 0) return false;
+                --depth;
+            }
+            else if (depth == 0 && c == '|') {
+                return false;
+            }
+            else if (depth == 0 && c == '.' && (pattern.compare(i, 2, ".*") == 0 || pattern.compare(i, 2, ".+") == 0)) {
+                if (pattern.compare(i + 2, 1, "?") != 0) greedy = true;
+                ++i;
+            }
         }
+        return greedy;
     }
 }
 
-// === RE2 (two-phase: Set filter → individual count) ===
-void Re2SetDeleter::operator()(void* p) const noexcept {
-    delete static_cast<re2::RE2::Set*>(p);
-}
+SignatureShape signature_shape(const SignatureDefinition& def) {
+    using Kind = SignatureShape::Kind;
+    SignatureShape shape;
+    auto bounded = [&shape, &def](size_t len) {
+        if (len != UNBOUNDED) {
+            shape.kind = Kind::BOUNDED;
+            shape.max_len = len;
+        }
+        else shape.single = swallows_later_matches(build_pattern(def));
+        return shape;
+    };
+    // Only the first max_offset bytes can hold a match: one pass over them.
+    if (def.max_offset) return shape;
+    if (def.type == SignatureType::TEXT) return bounded(MaxLength(def.text_pattern).run());
 
-Re2Scanner::Re2Scanner() = default;  // re2::RE2 is complete here
-Re2Scanner::~Re2Scanner() = default;
+    // Mirrors build_pattern(); two hex digits (or "??") are one byte.
+    std::string head = hex_to_regex_str(def.hex_head);
+    std::string tail = hex_to_regex_str(def.hex_tail);
+    if (head.empty()) {
+        if (!def.text_pattern.empty()) return bounded(MaxLength(def.text_pattern).run());
+        return bounded(def.hex_tail.size() / 2);
+    }
+    if (tail.empty() && def.text_pattern.empty()) return bounded(def.hex_head.size() / 2);
 
-std::string Re2Scanner::name() const { return "Google RE2"; }
+    size_t tail_len = !tail.empty() ? def.hex_tail.size() / 2 : MaxLength(def.text_pattern).run();
+    shape.head_len = def.hex_head.size() / 2;
+    shape.tail_len = tail_len;
+    shape.head = head;
+    shape.tail = !tail.empty() ? tail : def.text_pattern;
+    if (def.windowed()) {
+        // Head, at most max_gap bytes, tail: bounded when both the gap and the tail are.
+        if (def.max_gap == 0 || tail_len == UNBOUNDED || def.max_gap >= UNBOUNDED - shape.head_len - tail_len) return shape;
+        return bounded(shape.head_len + static_cast<size_t>(def.max_gap) + tail_len);
+    }
+    if (tail_len == UNBOUNDED) return bounded(UNBOUNDED);
+    shape.kind = Kind::HEAD_TAIL;
+    return shape;
+}
 
-void Re2Scanner::prepare(const std::vector<SignatureDefinition>& sigs) {
-    m_set.reset();
-    m_sig_names.clear();
-    m_regexes.clear();
+bool LeftmostCount::split(const std::string& pattern, std::string& head, std::string& tail) {
+    size_t depth = 0, cut = std::string::npos;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        const char c = pattern[i];
+        if (c == '\\') {
+            ++i;
+        }
+        else if (c == '[') {
+            size_t j = i + 1;
+            if (j < pattern.size() && pattern[j] == '^') ++j;
+            if (j < pattern.size() && pattern[j] == ']') ++j;
+            while (j < pattern.size() && pattern[j] != ']') {
+                if (pattern[j] == '\\') ++j;
+                else if (pattern.compare(j, 2, "[:") == 0) {
+                    const size_t close = pattern.find(":]", j + 2);
+                    if (close == std::string::npos) return false;
+                    j = close + 1;
+                }
+                ++j;
+            }
+            i = j;
+        }
+        else if (c == '(') {
+            // Inline flags would not reach into the tail once it stands alone.
+            if (pattern.compare(i, 2, "(?") == 0 && pattern.compare(i, 3, "(?:") != 0) return false;
+            ++depth;
+        }
+        else if (c == ')') {
+            if (depth == 0) return false;
+            --depth;
+        }
+        else if (depth == 0 && c == '|') {
+            return false;
+        }
+        else if (depth == 0 && cut == std::string::npos && pattern.compare(i, 3, ".*?") == 0) {
+            cut = i;
+            i += 2;
+        }
+    }
+    if (cut == std::string::npos) return false;
+    std::string h = pattern.substr(0, cut), t = pattern.substr(cut + 3);
+    const size_t h_len = MaxLength(h).run(), t_len = MaxLength(t).run();
+    if (h_len == 0 || t_len == 0 || h_len == UNBOUNDED || t_len == UNBOUNDED) return false;
+    head = std::move(h);
+    tail = std::move(t);
+    return true;
+}
 
-    // Build individual regexes (for phase 2 counting)
+uint64_t signature_set_hash(const std::vector<SignatureDefinition>& sigs) {
+    uint64_t h = FNV_OFFSET;
     for (const auto& s : sigs) {
-        std::string pat = build_pattern(s);
-        if (pat.empty()) continue;
+        h = fnv1a(h, s.name);
+        h = fnv1a(h, s.hex_head);
+        h = fnv1a(h, s.hex_tail);
+        h = fnv1a(h, s.text_pattern);
+        h = fnv1a(h, s.deduct_from);
+        int type = static_cast<int>(s.type);
+        h = fnv1a(h, &type, sizeof(type));
+        const uint64_t bounds[] = {s.max_gap, s.min_length, s.max_offset};
+        h = fnv1a(h, bounds, sizeof(bounds));
+        h = fnv1a(h, &s.offset, sizeof(s.offset));
+    }
+    return h;
+}
 
-        re2::RE2::Options opt;
-        opt.set_encoding(re2::RE2::Options::EncodingLatin1);
-        opt.set_dot_nl(true);
-        if (s.type == SignatureType::TEXT) opt.set_case_sensitive(false);
-        auto re = std::make_unique<re2::RE2>(pat, opt);
-        if (re->ok()) {
-            m_regexes.emplace_back(std::move(re), s.name);
-            m_sig_names.push_back(s.name);
-        }
+std::vector<SignatureDefinition> AnchoredSignatures::order(const std::vector<SignatureDefinition>& sigs) {
+    std::set<std::string> related; // names in some deduct_from relation
+    for (const auto& s : sigs) {
+        if (s.deduct_from.empty()) continue;
+        related.insert(s.name);
+        related.insert(s.deduct_from);
     }
+    std::vector<SignatureDefinition> out(sigs);
+    for (auto& s : out) {
+        if (s.anchored() && (s.type != SignatureType::BINARY || s.hex_head.size() < 2 || !s.hex_tail.empty()
+                             || !s.text_pattern.empty() || s.windowed() || s.max_offset || related.count(s.name)))
+            s.offset = SignatureDefinition::ANYWHERE;
+    }
+    std::stable_partition(out.begin(), out.end(), [](const SignatureDefinition& s) { return !s.anchored(); });
+    return out;
+}
 
-    // Build RE2::Set (for phase 1 filtering)
-    re2::RE2::Options set_opt;
-    set_opt.set_encoding(re2::RE2::Options::EncodingLatin1);
-    set_opt.set_dot_nl(true);
-    std::unique_ptr<void, Re2SetDeleter> new_set(new re2::RE2::Set(set_opt, re2::RE2::UNANCHORED));
-    auto* raw = static_cast<re2::RE2::Set*>(new_set.get());
+void AnchoredSignatures::add(uint32_t id, const SignatureDefinition& def) {
+    Magic m{id, def.offset, {}, {}};
+    for (size_t i = 0; i + 1 < def.hex_head.size(); i += 2) {
+        const std::string pair = def.hex_head.substr(i, 2);
+        const bool any = pair == "??";
+        const auto byte = any ? 0 : static_cast<unsigned char>(std::strtoul(pair.c_str(), nullptr, 16));
+        m.bytes.push_back(static_cast<char>(byte));
+        m.mask.push_back(static_cast<char>(any ? 0x00 : 0xFF));
+    }
+    const size_t len = m.bytes.size();
+    if (m.offset >= 0) m_head = std::max(m_head, static_cast<size_t>(m.offset) + len);
+    else m_tail = std::max(m_tail, static_cast<size_t>(-m.offset));
+    m_magics.push_back(std::move(m));
+}
 
-    for (const auto& [re, sig_name] : m_regexes) {
-        std::string err;
-        raw->Add(re->pattern(), &err);
+size_t AnchoredSignatures::locate(const Magic& m, const char* head, const char* tail, uint64_t size) const {
+    const size_t head_size = static_cast<size_t>(std::min<uint64_t>(size, m_head));
+    const size_t tail_size = static_cast<size_t>(std::min<uint64_t>(size, m_tail));
+    const size_t len = m.bytes.size();
+    const char* at;
+    uint64_t start;
+    if (m.offset >= 0) {
+        if (static_cast<uint64_t>(m.offset) + len > head_size) return SIZE_MAX;
+        at = head + m.offset;
+        start = static_cast<uint64_t>(m.offset);
     }
-    if (raw->Compile()) {
-        m_set = std::move(new_set);
+    else {
+        const auto back = static_cast<size_t>(-m.offset);
+        if (back < len || back > tail_size) return SIZE_MAX;
+        at = tail + (tail_size - back);
+        start = size - back;
     }
+    for (size_t i = 0; i < len; ++i)
+        if ((at[i] & m.mask[i]) != m.bytes[i]) return SIZE_MAX;
+    return static_cast<size_t>(start);
 }
 
-void Re2Scanner::scan(const char* data, size_t size, ScanStats& stats) {
-    auto* set = static_cast<re2::RE2::Set*>(m_set.get());
-    if (!set) {
-        // Fallback: no set compiled, scan all individually
-        for (const auto& [re, name] : m_regexes) {
-            re2::StringPiece input(data, size);
-            while (re2::RE2::FindAndConsume(&input, *re)) stats.add(name);
+void AnchoredSignatures::check(const char* head, const char* tail, uint64_t size, ScanStats& stats) const {
+    for (const auto& m : m_magics)
+        if (locate(m, head, tail, size) != SIZE_MAX) stats.hit(m.id);
+}
+
+void AnchoredSignatures::matches(const char* data, size_t size, std::vector<std::pair<size_t, uint32_t>>& out) const {
+    const char* tail = data + size - std::min(size, m_tail);
+    for (const auto& m : m_magics) {
+        const size_t start = locate(m, data, tail, size);
+        if (start != SIZE_MAX) out.emplace_back(start + m.bytes.size(), m.id);
+    }
+}
+
+namespace {
+    // Whether `re` has a `|` outside any group: build_pattern() does not group text_pattern,
+    // so then not every match of `head.*?text_pattern` starts with the head.
+    bool alternates(const std::string& re) {
+        int depth = 0;
+        bool in_class = false;
+        for (size_t i = 0; i < re.size(); ++i) {
+            const char ch = re[i];
+            if (ch == '\\') ++i;
+            else if (in_class) in_class = ch != ']';
+            else if (ch == '[') in_class = true;
+            else if (ch == '(') ++depth;
+            else if (ch == ')') --depth;
+            else if (ch == '|' && depth == 0) return true;
         }
-        return;
+        return false;
     }
 
-    // Phase 1: fast filter — which patterns match at all?
-    std::vector<int> matched_ids;
-    set->Match(re2::StringPiece(data, size), &matched_ids);
+    // ASCII literal every match of `re` starts with and the offset past it; empty if none.
+    std::string literal_prefix(const std::string& re, size_t& rest) {
+        rest = 0;
+        if (alternates(re)) return "";
+        static const std::string plain = " !\"#%&',-/:;<=>@_~`";
+        std::string lit;
+        size_t i = 0;
+        while (i < re.size()) {
+            size_t next = i + 1;
+            char ch = re[i];
+            if (ch == '\\') {
+                if (next + 2 < re.size() && re[next] == 'x' && std::isxdigit(static_cast<unsigned char>(re[next + 1]))
+                    && std::isxdigit(static_cast<unsigned char>(re[next + 2]))) {
+                    ch = static_cast<char>(std::strtoul(re.substr(next + 1, 2).c_str(), nullptr, 16));
+                    next += 3;
+                }
+                else if (next == re.size() || std::isalnum(static_cast<unsigned char>(re[next]))) break;
+                else ch = re[next++];
+            }
+            else if (!std::isalnum(static_cast<unsigned char>(ch)) && plain.find(ch) == std::string::npos) break;
+            if (static_cast<unsigned char>(ch) >= 0x80) break;
+            if (next < re.size() && std::string("*+?{").find(re[next]) != std::string::npos) break; // quantified
+            lit += ch;
+            i = next;
+        }
+        rest = i;
+        return lit;
+    }
 
-    // Phase 2: count matches only for patterns that were found
-    for (int id : matched_ids) {
-        const auto& [re, name] = m_regexes[id];
-        re2::StringPiece input(data, size);
-        while (re2::RE2::FindAndConsume(&input, *re)) stats.add(name);
+    // Literals build_pattern(def) matches are found from: `head`, and for `head.*?rest` the
+    // `tail` rest starts with (`exact` when it is all of rest).
+    struct Lead {
+        LeadingLiterals::Kind kind = LeadingLiterals::Kind::NONE;
+        std::string head;
+        std::string tail;
+        bool fold = false;
+        bool chained = false;
+        bool exact = false;
+    };
+    Lead lead_of(const SignatureDefinition& def) {
+        using Kind = LeadingLiterals::Kind;
+        auto bytes = [](const std::string& hex, bool& whole) {
+            std::string out;
+            size_t i = 0;
+            for (; i + 1 < hex.size() && hex.compare(i, 2, "??") != 0; i += 2)
+                out.push_back(static_cast<char>(std::strtoul(hex.substr(i, 2).c_str(), nullptr, 16)));
+            whole = i + 1 >= hex.size();
+            return out;
+        };
+        Lead lead;
+        auto as = [&](Kind kind) {
+            lead.kind = kind;
+            return lead;
+        };
+        // `head.*?rest`, rest starting with `tail`.
+        auto pair = [&](std::string tail, bool exact) {
+            lead.chained = true;
+            lead.tail = std::move(tail);
+            lead.exact = exact;
+            return as(lead.tail.empty() ? Kind::CONFIRM : Kind::PAIR);
+        };
+        lead.fold = def.type == SignatureType::TEXT;
+        const std::string& text = def.text_pattern;
+        size_t rest = 0;
+        bool whole = true;
+        if (lead.fold || def.hex_head.empty()) {
+            lead.head = !text.empty() ? literal_prefix(text, rest) : bytes(def.hex_tail, whole);
+            if (lead.head.empty()) return lead;
+            if (text.empty() || rest == text.size()) return as(whole ? Kind::LITERAL : Kind::CONFIRM);
+            if (text.compare(rest, 3, ".*?") != 0) return as(Kind::CONFIRM);
+            size_t end;
+            std::string tail = literal_prefix(text.substr(rest + 3), end);
+            return pair(tail, rest + 3 + end == text.size());
+        }
+        lead.head = bytes(def.hex_head, whole);
+        if (lead.head.empty()) return lead;
+        if (def.hex_tail.empty() && text.empty()) return as(whole ? Kind::LITERAL : Kind::CONFIRM);
+        if (!def.hex_tail.empty()) {
+            if (!whole) return as(Kind::CONFIRM);
+            bool tail_whole;
+            std::string tail = bytes(def.hex_tail, tail_whole);
+            return pair(tail, tail_whole);
+        }
+        if (alternates(text)) return lead;
+        if (!whole) return as(Kind::CONFIRM);
+        size_t end;
+        std::string tail = literal_prefix(text, end);
+        return pair(tail, end == text.size());
     }
 }
 
-// === Hyperscan ===
-HsScanner::HsScanner() = default;
-HsScanner::~HsScanner() {
-    if (scratch) hs_free_scratch(scratch);
-    if (db) hs_free_database(db);
-}
-std::string HsScanner::name() const { return "Hyperscan"; }
-void HsScanner::prepare(const std::vector<SignatureDefinition>& sigs) {
-    if (scratch) { hs_free_scratch(scratch); scratch = nullptr; }
-    if (db) { hs_free_database(db); db = nullptr; }
-    m_temp_patterns.clear(); m_sig_names.clear();
-    m_temp_patterns.reserve(sigs.size());
+namespace {
+    // The byte values `ch` stands for: both ASCII cases when `fold`.
+    std::vector<unsigned char> cases(char c, bool fold) {
+        const auto ch = static_cast<unsigned char>(c);
+        if (!fold || std::tolower(ch) == std::toupper(ch)) return {ch};
+        return {static_cast<unsigned char>(std::tolower(ch)), static_cast<unsigned char>(std::toupper(ch))};
+    }
 
-    std::vector<const char*> exprs;
-    std::vector<unsigned int> flags, ids;
+    unsigned char ascii_lower(unsigned char ch) { return ch >= 'A' && ch <= 'Z' ? ch | 0x20 : ch; }
 
-    for (size_t i = 0; i < sigs.size(); ++i) {
-        std::string pat = build_pattern(sigs[i]);
-        if (pat.empty()) continue;
-        m_temp_patterns.push_back(pat);
-        m_sig_names.push_back(sigs[i].name);
-        exprs.push_back(m_temp_patterns.back().c_str());
-        ids.push_back(static_cast<unsigned int>(m_sig_names.size() - 1));
-        flags.push_back(HS_FLAG_DOTALL | (sigs[i].type == SignatureType::TEXT ? HS_FLAG_CASELESS : 0));
+#ifdef DEVSCAN_X86
+    unsigned lowest_bit(uint32_t x) {
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanForward(&i, x);
+        return static_cast<unsigned>(i);
+#else
+        return static_cast<unsigned>(__builtin_ctz(x));
+#endif
     }
 
-    if (exprs.empty()) return;
-    hs_compile_error_t* err;
-    if (hs_compile_multi(exprs.data(), flags.data(), ids.data(), static_cast<unsigned int>(exprs.size()), HS_MODE_BLOCK, nullptr, &db, &err) != HS_SUCCESS) {
-        std::cerr << "[Scanner] HS Compile Error: " << err->message << std::endl;
-        hs_free_compile_error(err);
+#if defined(__GNUC__) || defined(__clang__)
+#define DEVSCAN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DEVSCAN_TARGET(isa) // MSVC emits any intrinsic without a target switch
+#endif
+    // A position where a literal of `groups` (bit g: Teddy group g) may start.
+    struct Candidate {
+        size_t at;
+        uint32_t groups;
+    };
+    constexpr size_t CANDIDATES = 256; // per kernel call
+
+    // Teddy over 32 (AVX2) or 16 (SSSE3) positions per block: appends candidates to `out` and
+    // returns where it stopped before `out` could overflow.
+    DEVSCAN_TARGET("avx2")
+    size_t teddy_avx2(const unsigned char* nibbles, const unsigned char* bytes, size_t p, size_t size,
+                      Candidate* out, size_t& n) {
+        __m256i tables[12]; // [set][byte][low, high nibble]
+        for (int t = 0; t < 12; ++t)
+            tables[t] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibbles + 16 * t)));
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        alignas(32) unsigned char groups[64];
+        n = 0;
+        for (; p + 32 + 2 <= size && n + 32 <= CANDIDATES; p += 32) {
+            __m256i r[2] = {_mm256_set1_epi8(-1), _mm256_set1_epi8(-1)};
+            for (int k = 0; k < 3; ++k) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + p + k));
+                const __m256i lo = _mm256_and_si256(v, low), hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+                for (int set = 0; set < 2; ++set)
+                    r[set] = _mm256_and_si256(r[set], _mm256_and_si256(_mm256_shuffle_epi8(tables[set * 6 + k * 2], lo),
+                                                                       _mm256_shuffle_epi8(tables[set * 6 + k * 2 + 1], hi)));
+            }
+            const __m256i any = _mm256_or_si256(r[0], r[1]);
+            uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(any, _mm256_setzero_si256())));
+            if (!mask) continue;
+            _mm256_store_si256(reinterpret_cast<__m256i*>(groups), r[0]);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(groups + 32), r[1]);
+            for (; mask != 0; mask &= mask - 1) {
+                const unsigned j = lowest_bit(mask);
+                out[n++] = {p + j, groups[j] | static_cast<uint32_t>(groups[32 + j]) << 8};
+            }
+        }
+        return p;
     }
-    else {
-        hs_alloc_scratch(db, &scratch);
+
+    DEVSCAN_TARGET("ssse3")
+    size_t teddy_ssse3(const unsigned char* nibbles, const unsigned char* bytes, size_t p, size_t size,
+                       Candidate* out, size_t& n) {
+        __m128i tables[12];
+        for (int t = 0; t < 12; ++t) tables[t] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nibbles + 16 * t));
+        const __m128i low = _mm_set1_epi8(0x0f);
+        alignas(16) unsigned char groups[32];
+        n = 0;
+        for (; p + 16 + 2 <= size && n + 16 <= CANDIDATES; p += 16) {
+            __m128i r[2] = {_mm_set1_epi8(-1), _mm_set1_epi8(-1)};
+            for (int k = 0; k < 3; ++k) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + p + k));
+                const __m128i lo = _mm_and_si128(v, low), hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+                for (int set = 0; set < 2; ++set)
+                    r[set] = _mm_and_si128(r[set], _mm_and_si128(_mm_shuffle_epi8(tables[set * 6 + k * 2], lo),
+                                                                 _mm_shuffle_epi8(tables[set * 6 + k * 2 + 1], hi)));
+            }
+            const __m128i any = _mm_or_si128(r[0], r[1]);
+            uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128()))) & 0xffff;
+            if (!mask) continue;
+            _mm_store_si128(reinterpret_cast<__m128i*>(groups), r[0]);
+            _mm_store_si128(reinterpret_cast<__m128i*>(groups + 16), r[1]);
+            for (; mask != 0; mask &= mask - 1) {
+                const unsigned j = lowest_bit(mask);
+                out[n++] = {p + j, groups[j] | static_cast<uint32_t>(groups[16 + j]) << 8};
+            }
+        }
+        return p;
     }
+#undef DEVSCAN_TARGET
+#endif
 }
-void HsScanner::scan(const char* data, size_t size, ScanStats& stats) {
-    if (!db || !scratch) return;
-    // ASSERT: this method must not be called concurrently on the same instance (scratch is not thread-safe).
-    struct Ctx { ScanStats* s; const std::vector<std::string>* n; } ctx = { &stats, &m_sig_names };
-    auto on_match = [](unsigned int id, unsigned long long, unsigned long long, unsigned int, void* ptr) -> int {
-        auto* c = static_cast<Ctx*>(ptr);
-        if (id < c->n->size()) c->s->add((*c->n)[id]);
-        return 0;
+
+LeadingLiterals::Kernel LeadingLiterals::best_kernel() {
+    static const Kernel best = [] {
+#if defined(DEVSCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return Kernel::AVX2;
+        if (__builtin_cpu_supports("ssse3")) return Kernel::SSSE3;
+#elif defined(DEVSCAN_X86) && defined(_MSC_VER)
+        int r[4];
+        __cpuid(r, 0);
+        const int leaves = r[0];
+        __cpuid(r, 1);
+        const bool ssse3 = r[2] >> 9 & 1;
+        // AVX2 also needs the OS to save the YMM registers (OSXSAVE, then XCR0).
+        const bool ymm = (r[2] >> 27 & 1) && (r[2] >> 28 & 1) && (_xgetbv(0) & 6) == 6;
+        if (ymm && leaves >= 7) {
+            __cpuidex(r, 7, 0);
+            if (r[1] >> 5 & 1) return Kernel::AVX2;
+        }
+        if (ssse3) return Kernel::SSSE3;
+#endif
+        return Kernel::SCALAR;
+    }();
+    return best;
+}
+
+LeadingLiterals LeadingLiterals::build(const std::vector<SignatureDefinition>& defs, size_t count,
+                                       const SignatureTree& tree) {
+    LeadingLiterals out;
+    out.m_buckets.resize(256);
+    out.m_pairs.assign(65536 / 64, 0);
+    out.m_kinds.assign(count, Kind::NONE);
+    out.m_head_lens.assign(count, 0);
+    out.m_tail_lens.assign(count, 0);
+    out.m_exact.assign(count, 0);
+    out.m_searches.assign(count, 0);
+    out.m_chained.assign(count, 0);
+    for (uint32_t id = 0; id < count; ++id) {
+        out.m_bounds.push_back(SignatureBounds::of(defs[id]));
+        const Lead lead = lead_of(defs[id]);
+        Kind kind = lead.kind;
+        if (kind == Kind::NONE) {
+            out.m_all = false;
+            continue;
+        }
+        // Windowed signatures and subtypes are found by the engine's search from the head:
+        // when it fails, nothing starts further on.
+        const bool searches = defs[id].windowed() || tree.is_child(id);
+        if (defs[id].windowed() || (searches && kind == Kind::LITERAL)) kind = Kind::CONFIRM;
+        out.m_kinds[id] = kind;
+        out.m_head_lens[id] = lead.head.size();
+        out.m_tail_lens[id] = lead.tail.size();
+        out.m_exact[id] = lead.exact;
+        out.m_searches[id] = searches;
+        out.m_chained[id] = lead.chained || searches;
+        out.add(id, lead.head, lead.fold, false);
+        if (kind == Kind::PAIR) out.add(id, lead.tail, lead.fold, true);
+    }
+    out.group();
+    return out;
+}
+
+void LeadingLiterals::add(uint32_t id, const std::string& bytes, bool fold, bool tail) {
+    auto same = [&](const Literal& l) { return l.bytes == bytes && l.fold == fold; };
+    auto it = std::find_if(m_literals.begin(), m_literals.end(), same);
+    if (it == m_literals.end()) {
+        const auto index = static_cast<uint32_t>(m_literals.size());
+        for (unsigned char first : cases(bytes[0], fold)) {
+            m_buckets[first].push_back(index);
+            // A one-byte literal passes whatever byte follows it.
+            std::vector<unsigned char> seconds;
+            if (bytes.size() > 1) seconds = cases(bytes[1], fold);
+            else for (int b = 0; b < 256; ++b) seconds.push_back(static_cast<unsigned char>(b));
+            for (unsigned char second : seconds) {
+                const size_t pair = static_cast<size_t>(first) << 8 | second;
+                m_pairs[pair >> 6] |= uint64_t{1} << (pair & 63);
+            }
+        }
+        Literal lit{bytes, fold};
+        unsigned char prefix[4] = {}, mask[4] = {}, folds[4] = {};
+        for (size_t i = 0; i < 4 && i < bytes.size(); ++i) {
+            const auto ch = static_cast<unsigned char>(bytes[i]);
+            const bool letter = fold && (ch | 0x20) >= 'a' && (ch | 0x20) <= 'z';
+            prefix[i] = letter ? ascii_lower(ch) : ch;
+            mask[i] = 0xff;
+            folds[i] = letter ? 0x20 : 0;
+        }
+        std::memcpy(&lit.prefix, prefix, 4);
+        std::memcpy(&lit.prefix_mask, mask, 4);
+        std::memcpy(&lit.prefix_fold, folds, 4);
+        m_literals.push_back(std::move(lit));
+        it = m_literals.end() - 1;
+    }
+    (tail ? it->tails : it->heads).push_back(id);
+}
+
+// Teddy tables: literals go, shortest first, to the group where they add the least expected work.
+void LeadingLiterals::group() {
+    constexpr size_t GROUPS = 16, BYTES = 3;
+    struct Nibbles {
+        uint16_t lo[BYTES] = {}, hi[BYTES] = {};
+    };
+    auto merge = [](Nibbles a, const Nibbles& b) {
+        for (size_t k = 0; k < BYTES; ++k) a.lo[k] |= b.lo[k], a.hi[k] |= b.hi[k];
+        return a;
+    };
+    auto pass = [](const Nibbles& m) {
+        double share = 1;
+        for (size_t k = 0; k < BYTES; ++k)
+            share *= static_cast<double>(std::bitset<16>(m.lo[k]).count() * std::bitset<16>(m.hi[k]).count()) / 256;
+        return share;
+    };
+    auto cost = [&](const Nibbles& m, size_t literals) {
+        return pass(m) * static_cast<double>(4 + literals); // a candidate ~ 4 compares
     };
-    hs_scan(db, data, size, 0, scratch, on_match, &ctx);
+
+    std::vector<uint32_t> order(m_literals.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const std::string& x = m_literals[a].bytes;
+        const std::string& y = m_literals[b].bytes;
+        const size_t lx = std::min(x.size(), BYTES), ly = std::min(y.size(), BYTES);
+        return lx != ly ? lx < ly : x < y;
+    });
+    m_groups.assign(GROUPS, {});
+    std::vector<Nibbles> masks(GROUPS);
+    for (uint32_t index : order) {
+        const Literal& lit = m_literals[index];
+        Nibbles own;
+        for (size_t k = 0; k < BYTES; ++k) {
+            if (k >= lit.bytes.size()) {
+                own.lo[k] = own.hi[k] = 0xffff;
+                continue;
+            }
+            for (unsigned char ch : cases(lit.bytes[k], lit.fold)) {
+                own.lo[k] |= static_cast<uint16_t>(1u << (ch & 15));
+                own.hi[k] |= static_cast<uint16_t>(1u << (ch >> 4));
+            }
+        }
+        size_t best = 0;
+        double least = 0;
+        for (size_t g = 0; g < GROUPS; ++g) {
+            const size_t n = m_groups[g].size();
+            const double added = cost(merge(masks[g], own), n + 1) - (n ? cost(masks[g], n) : 0);
+            if (g == 0 || added < least) best = g, least = added;
+        }
+        masks[best] = merge(masks[best], own);
+        m_groups[best].push_back(index);
+    }
+    // From about 60 literals the nibble sets fill up (2% of random positions pass) and the
+    // pair bitmap of the scalar kernel filters better.
+    double passes = 0;
+    for (size_t g = 0; g < GROUPS; ++g) passes += m_groups[g].empty() ? 0 : pass(masks[g]);
+    m_teddy = !m_literals.empty() && passes < 0.02;
+
+    // [set of 8 groups][byte][low, high nibble][16]
+    m_nibbles.assign(GROUPS / 8 * BYTES * 32, 0);
+    for (size_t g = 0; g < GROUPS; ++g) {
+        unsigned char* set = &m_nibbles[g / 8 * BYTES * 32];
+        const auto bit = static_cast<unsigned char>(1u << g % 8);
+        for (size_t k = 0; k < BYTES; ++k)
+            for (size_t x = 0; x < 16; ++x) {
+                if (masks[g].lo[k] >> x & 1) set[k * 32 + x] |= bit;
+                if (masks[g].hi[k] >> x & 1) set[k * 32 + 16 + x] |= bit;
+            }
+    }
+}
+
+// One read of the buffer plus the CONFIRM matches; LITERAL and PAIR run no regex.
+void LeadingLiterals::count(const char* data, size_t size, const DeductionPlan& plan, Cursors& cursors,
+                            const Match& at, const Match& from, ScanStats& stats, Kernel kernel) const {
+    const size_t n = m_kinds.size();
+    cursors.next.assign(n, 0);
+    cursors.pending.assign(n, SIZE_MAX);
+    cursors.heads.resize(n);
+    cursors.tails.resize(n);
+    for (uint32_t id = 0; id < n; ++id) {
+        cursors.heads[id].clear();
+        cursors.tails[id].clear();
+    }
+
+    auto at_head = [&](uint32_t id, size_t p) {
+        size_t& cur = cursors.next[id];
+        if (p < cur) return;
+        const size_t limit = m_bounds[id].limit(size);
+        if (plan.tracks(id)) {
+            if (p < limit) cursors.heads[id].push_back(p);
+            return;
+        }
+        switch (m_kinds[id]) {
+        case Kind::LITERAL:
+            if (p + m_head_lens[id] > limit) {
+                cur = SIZE_MAX;
+                return;
+            }
+            stats.hit(id);
+            cur = p + m_head_lens[id];
+            return;
+        case Kind::PAIR:
+            if (cursors.pending[id] == SIZE_MAX && p + m_head_lens[id] <= limit) cursors.pending[id] = p;
+            return;
+        default: {
+            if (p >= limit) return;
+            size_t mb, me;
+            if ((m_searches[id] ? from : at)(id, p, mb, me)) {
+                stats.hit(id);
+                cur = mb + std::max<size_t>(1, me - mb);
+            }
+            else if (m_chained[id]) cur = SIZE_MAX;
+        }
+        }
+    };
+    // PAIR: a tail closes the open head before it.
+    auto at_tail = [&](uint32_t id, size_t t) {
+        if (plan.tracks(id)) {
+            cursors.tails[id].push_back(t);
+            return;
+        }
+        const size_t head = cursors.pending[id];
+        if (head == SIZE_MAX || t < head + m_head_lens[id]) return;
+        cursors.pending[id] = SIZE_MAX;
+        size_t mb = head, me = t + m_tail_lens[id];
+        // Not exact: the rest of the pattern starts with the tail, so the match at the head
+        // ends at or after this tail, or there is none.
+        if (m_exact[id] ? me > m_bounds[id].limit(size) : !(m_searches[id] ? from : at)(id, head, mb, me)) {
+            cursors.next[id] = SIZE_MAX;
+            return;
+        }
+        stats.hit(id);
+        cursors.next[id] = mb + std::max<size_t>(1, me - mb);
+    };
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    // Whether `lit` occurs at p, its bytes from `from` on compared; then its tails close
+    // their heads before its heads open.
+    auto occurs = [&](const Literal& lit, size_t p, size_t from) {
+        const size_t len = lit.bytes.size();
+        if (len > size - p) return;
+        for (size_t i = from; i < len; ++i) {
+            const auto ch = static_cast<unsigned char>(lit.bytes[i]);
+            if (bytes[p + i] != ch && !(lit.fold && ascii_lower(bytes[p + i]) == ascii_lower(ch))) return;
+        }
+        for (uint32_t id : lit.tails) at_tail(id, p);
+        for (uint32_t id : lit.heads) at_head(id, p);
+    };
+
+    size_t p = 0;
+#ifdef DEVSCAN_X86
+    kernel = std::min(kernel, best_kernel());
+    if (kernel != Kernel::SCALAR && m_teddy) {
+        const auto next = kernel == Kernel::AVX2 ? teddy_avx2 : teddy_ssse3;
+        const size_t width = kernel == Kernel::AVX2 ? 32 : 16;
+        Candidate found[CANDIDATES];
+        for (size_t n; p + width + 2 <= size;) {
+            p = next(m_nibbles.data(), bytes, p, size, found, n);
+            for (size_t i = 0; i < n; ++i) {
+                const size_t at = found[i].at;
+                const size_t pair = static_cast<size_t>(bytes[at]) << 8 | bytes[at + 1];
+                if (!(m_pairs[pair >> 6] >> (pair & 63) & 1)) continue;
+                uint32_t four; // a block is followed by two bytes, so `at` has four
+                std::memcpy(&four, bytes + at, 4);
+                for (uint32_t g = found[i].groups; g != 0; g &= g - 1)
+                    for (uint32_t index : m_groups[lowest_bit(g)]) {
+                        const Literal& lit = m_literals[index];
+                        if (((four | lit.prefix_fold) & lit.prefix_mask) == lit.prefix) occurs(lit, at, 4);
+                    }
+            }
+        }
+    }
+#else
+    (void)kernel;
+#endif
+    // Scalar, and the last positions of the SIMD kernels: almost every position fails the
+    // pair test, one bit lookup.
+    const uint64_t* pairs = m_pairs.data();
+    for (; p < size; ++p) {
+        if (p + 1 < size) {
+            const size_t pair = static_cast<size_t>(bytes[p]) << 8 | bytes[p + 1];
+            if (!(pairs[pair >> 6] >> (pair & 63) & 1)) continue;
+        }
+        for (uint32_t index : m_buckets[bytes[p]]) occurs(m_literals[index], p, 1);
+    }
+}
+
+// The next match from `from` starts at the first head there that is one.
+bool LeadingLiterals::find(uint32_t id, size_t from, size_t size, const Cursors& cursors, const Match& at,
+                           const Match& search, size_t& begin, size_t& end) const {
+    const auto& heads = cursors.heads[id];
+    auto head = std::lower_bound(heads.begin(), heads.end(), from);
+    const size_t limit = m_bounds[id].limit(size);
+    switch (m_kinds[id]) {
+    case Kind::LITERAL:
+        if (head == heads.end() || *head + m_head_lens[id] > limit) return false;
+        begin = *head;
+        end = begin + m_head_lens[id];
+        return true;
+    case Kind::PAIR: {
+        if (head == heads.end()) return false;
+        const auto& tails = cursors.tails[id];
+        auto tail = std::lower_bound(tails.begin(), tails.end(), *head + m_head_lens[id]);
+        if (tail == tails.end()) return false;
+        if (!m_exact[id]) return (m_searches[id] ? search : at)(id, *head, begin, end);
+        if (*tail + m_tail_lens[id] > limit) return false;
+        begin = *head;
+        end = *tail + m_tail_lens[id];
+        return true;
+    }
+    case Kind::CONFIRM:
+        for (; head != heads.end(); ++head) {
+            if ((m_searches[id] ? search : at)(id, *head, begin, end)) return true;
+            if (m_chained[id]) return false;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+namespace {
+    // Keeps the file's first head_bytes() and last tail_bytes() to check the anchors on close().
+    class AnchoredStream : public ScanStream {
+    public:
+        AnchoredStream(std::unique_ptr<ScanStream> inner, std::shared_ptr<const void> owner,
+                       const AnchoredSignatures& anchored, std::shared_ptr<const SignatureNames> names,
+                       ScanStats& stats)
+            : m_inner(std::move(inner)), m_owner(std::move(owner)), m_anchored(anchored),
+              m_names(std::move(names)), m_stats(stats) {}
+        ~AnchoredStream() override { close(); }
+
+        void write(const char* data, size_t size) override {
+            m_inner->write(data, size);
+            const size_t want = m_anchored.head_bytes();
+            if (m_head.size() < want) m_head.append(data, std::min(size, want - m_head.size()));
+            const size_t keep = m_anchored.tail_bytes();
+            if (keep) {
+                if (size >= keep) m_tail.assign(data + size - keep, keep);
+                else {
+                    m_tail.append(data, size);
+                    if (m_tail.size() > 2 * keep) m_tail.erase(0, m_tail.size() - keep);
+                }
+            }
+            m_size += size;
+        }
+
+        void close() override {
+            if (m_closed) return;
+            m_closed = true;
+            m_inner->close();
+            m_stats.bind(m_names);
+            const size_t tail = std::min(m_tail.size(), m_anchored.tail_bytes());
+            m_anchored.check(m_head.data(), m_tail.data() + (m_tail.size() - tail), m_size, m_stats);
+        }
+
+    private:
+        std::unique_ptr<ScanStream> m_inner;
+        std::shared_ptr<const void> m_owner; // keeps m_anchored alive
+        const AnchoredSignatures& m_anchored;
+        std::shared_ptr<const SignatureNames> m_names;
+        ScanStats& m_stats;
+        std::string m_head;
+        std::string m_tail;
+        uint64_t m_size = 0;
+        bool m_closed = false;
+    };
+
+    std::unique_ptr<ScanStream> with_anchors(std::unique_ptr<ScanStream> inner, std::shared_ptr<const void> owner,
+                                             const AnchoredSignatures& anchored,
+                                             std::shared_ptr<const SignatureNames> names, ScanStats& stats) {
+        if (anchored.empty()) return inner;
+        return std::make_unique<AnchoredStream>(std::move(inner), std::move(owner), anchored, std::move(names), stats);
+    }
+
+    // Anchors of a buffer held as pieces: its first head_bytes() and last tail_bytes()
+    // gathered from them.
+    void check_anchors(const AnchoredSignatures& anchored, const std::vector<ScanSpan>& spans, ScanStats& stats) {
+        if (anchored.empty()) return;
+        std::string head, tail;
+        uint64_t size = 0;
+        for (const auto& span : spans) {
+            if (head.size() < anchored.head_bytes())
+                head.append(span.data, std::min(span.size, anchored.head_bytes() - head.size()));
+            size += span.size;
+        }
+        for (auto it = spans.rbegin(); it != spans.rend() && tail.size() < anchored.tail_bytes(); ++it) {
+            const size_t take = std::min(it->size, anchored.tail_bytes() - tail.size());
+            tail.insert(0, it->data + (it->size - take), take);
+        }
+        anchored.check(head.data(), tail.data(), size, stats);
+    }
+
+    using MatchEnds = std::vector<std::pair<size_t, uint32_t>>; // (match end, id)
+
+    constexpr size_t CLASSIFY_PREFIX = 64 * 1024;
+
+    // classify() for one-pattern-at-a-time engines: first matches in growing prefixes (64 KB,
+    // 512 KB, ...) until FirstMatch decides.
+    template <class Collect>
+    void classify_prefixes(const char* data, size_t size, const DeductionPlan& plan,
+                           const AnchoredSignatures& anchored, Collect&& collect, ScanStats& stats) {
+        MatchEnds anchors, events;
+        anchored.matches(data, size, anchors);
+        for (size_t window = std::min(size, CLASSIFY_PREFIX);; window = std::min(size, window * 8)) {
+            events.clear();
+            collect(window, events);
+            for (const auto& a : anchors)
+                if (a.first <= window) events.push_back(a);
+            std::sort(events.begin(), events.end());
+            FirstMatch first(plan);
+            for (const auto& e : events)
+                if (first.add(e.second)) break;
+            if (first.decided() || window == size) {
+                if (first.result() >= 0) stats.hit(static_cast<uint32_t>(first.result()));
+                return;
+            }
+        }
+    }
+}
+
+// Single pass over the definitions: transitive chains are handled per file by
+// DeductionPlan, not here.
+void apply_deduction(ScanStats& stats, const std::vector<SignatureDefinition>& sigs) {
+    stats.resolve();
+    for (const auto& def : sigs) {
+        if (!def.deduct_from.empty()) {
+            const std::string& child = def.name;
+            const std::string& parent = def.deduct_from;
+            if (stats.counts.count(child) && stats.counts.count(parent)) {
+                int child_count = stats.counts[child];
+                stats.counts[parent] = std::max(0, stats.counts[parent] - child_count);
+            }
+        }
+    }
+}
+
+DeductionPlan DeductionPlan::build(const std::vector<SignatureDefinition>& defs) {
+    DeductionPlan plan;
+    const size_t n = defs.size();
+    plan.m_tracked.assign(n, 0);
+    plan.m_parent.assign(n, -1);
+    plan.m_header_only.assign(n, 0);
+    plan.m_is_parent.assign(n, 0);
+    std::map<std::string, int> ids;
+    for (size_t id = 0; id < n; ++id) ids.emplace(defs[id].name, static_cast<int>(id));
+    for (size_t id = 0; id < n; ++id) {
+        const SignatureDefinition& d = defs[id];
+        plan.m_header_only[id] = d.type == SignatureType::BINARY && !d.hex_head.empty()
+                                 && d.hex_tail.empty() && d.text_pattern.empty();
+        if (d.deduct_from.empty()) continue;
+        auto it = ids.find(d.deduct_from);
+        if (it != ids.end() && it->second != static_cast<int>(id)) plan.m_parent[id] = it->second;
+    }
+
+    // Every id has at most one parent, so a cycle is found by walking up from each id.
+    std::vector<size_t> depth(n, 0);
+    for (size_t id = 0; id < n; ++id) {
+        size_t steps = 0;
+        for (int p = plan.m_parent[id]; p >= 0 && steps <= n; p = plan.m_parent[p]) ++steps;
+        if (steps > n) {
+            std::cerr << "[Scanner] Warning: deduct_from cycle through '" << defs[id].name
+                      << "', its deduction is ignored" << std::endl;
+            plan.m_parent[id] = -1;
+        }
+    }
+    for (size_t id = 0; id < n; ++id) {
+        for (int p = plan.m_parent[id]; p >= 0; p = plan.m_parent[p]) ++depth[id];
+        if (plan.m_parent[id] >= 0) plan.m_tracked[id] = plan.m_tracked[plan.m_parent[id]] = plan.m_is_parent[plan.m_parent[id]] = 1;
+    }
+    for (uint32_t id = 0; id < n; ++id)
+        if (plan.m_tracked[id]) plan.m_order.push_back(id);
+    // Deepest first: a child is always one level below its parent.
+    std::stable_sort(plan.m_order.begin(), plan.m_order.end(),
+                     [&](uint32_t a, uint32_t b) { return depth[a] > depth[b]; });
+    return plan;
+}
+
+bool DeductionPlan::descends(uint32_t id, uint32_t ancestor) const {
+    for (int p = id < m_parent.size() ? m_parent[id] : -1; p >= 0; p = m_parent[p])
+        if (static_cast<uint32_t>(p) == ancestor) return true;
+    return false;
+}
+
+void DeductionPlan::count(size_t size, const Find& find, ScanStats& stats) const {
+    struct Span { uint64_t begin, end; };
+    // covers[id]: every match of id's descendants in the buffer, gathered children-first.
+    std::vector<std::vector<Span>> covers(m_tracked.size());
+    std::vector<Span> own;
+    for (uint32_t id : m_order) {
+        std::vector<Span>& cover = covers[id];
+        std::sort(cover.begin(), cover.end(), [](const Span& a, const Span& b) { return a.begin < b.begin; });
+        own.clear();
+        size_t cur = 0, b, e;
+        while (cur < size && find(id, cur, b, e)) {
+            // A descendant match lying wholly inside this one claims it; a header-only
+            // match has no extent, so one starting at the same header does.
+            auto c = std::lower_bound(cover.begin(), cover.end(), static_cast<uint64_t>(b),
+                                      [](const Span& s, uint64_t v) { return s.begin < v; });
+            while (c != cover.end() && c->begin < e && c->end > e && !(m_header_only[id] && c->begin == b)) ++c;
+            if (c != cover.end() && c->begin < std::max<uint64_t>(e, b + 1)) {
+                cur = static_cast<size_t>(std::max<uint64_t>(c->end, b + 1));
+                continue;
+            }
+            own.push_back({b, e});
+            cur = b + std::max<size_t>(1, e - b);
+        }
+        if (!own.empty()) stats.hit(id, static_cast<int>(own.size()));
+        if (m_parent[id] < 0) continue;
+        std::vector<Span>& up = covers[m_parent[id]];
+        up.insert(up.end(), cover.begin(), cover.end());
+        up.insert(up.end(), own.begin(), own.end());
+    }
+}
+
+std::unique_ptr<Scanner> Scanner::create(EngineType type) {
+    switch (type) {
+    case EngineType::BOOST: return std::make_unique<BoostScanner>();
+    case EngineType::RE2:   return std::make_unique<Re2Scanner>();
+    case EngineType::HYPERSCAN: return std::make_unique<HsScanner>();
+    case EngineType::LITERAL: return std::make_unique<LiteralScanner>();
+    case EngineType::HYBRID: return std::make_unique<HybridScanner>();
+    default: return std::make_unique<HsScanner>();
+    }
+}
+
+// Without a vectored mode, the block scan over the pieces joined is several times faster
+// than a carry-over stream (RE2, Boost): joined up to VECTORED_JOIN_BYTES, streamed past it.
+void Scanner::scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats) {
+    if (spans.size() == 1) return scan(spans[0].data, spans[0].size, stats);
+    size_t size = 0;
+    for (const auto& span : spans) size += span.size;
+    std::string run;
+    if (size <= VECTORED_JOIN_BYTES) {
+        run.reserve(size);
+        for (const auto& span : spans) run.append(span.data, span.size);
+        return scan(run.data(), run.size(), stats);
+    }
+    auto stream = open_stream(stats);
+    for (const auto& span : spans) stream->write(span.data, span.size);
+    stream->close();
+}
+
+// === Boost ===
+std::string BoostScanner::name() const { return "Boost.Regex"; }
+std::shared_ptr<const SignatureNames> BoostScanner::signature_names() const {
+    return m_compiled ? m_compiled->names : nullptr;
+}
+void BoostScanner::prepare(const std::vector<SignatureDefinition>& sigs) {
+    auto compiled = std::make_shared<Compiled>();
+    auto names = std::make_shared<SignatureNames>();
+    std::vector<SignatureDefinition> kept; // by id
+    for (const auto& s : AnchoredSignatures::order(sigs)) {
+        if (s.anchored()) {
+            compiled->anchored.add(static_cast<uint32_t>(kept.size()), s);
+            names->push_back(s.name);
+            kept.push_back(s);
+            continue;
+        }
+        std::string pat = build_pattern(s);
+        if (pat.empty()) continue;
+        try {
+            auto flags = boost::regex::optimize | boost::regex::mod_s;
+            if (s.type == SignatureType::TEXT) flags |= boost::regex::icase;
+            SignatureShape shape = signature_shape(s);
+            boost::regex re(pat, flags);
+            boost::regex head, tail;
+            if (shape.kind == SignatureShape::Kind::HEAD_TAIL || s.windowed()) {
+                head.assign(shape.head, flags);
+                tail.assign(shape.tail, flags);
+            }
+            compiled->regexes.push_back(std::move(re));
+            compiled->heads.push_back(std::move(head));
+            compiled->tails.push_back(std::move(tail));
+            compiled->shapes.push_back(std::move(shape));
+            compiled->bounds.push_back(SignatureBounds::of(s));
+            names->push_back(s.name);
+            kept.push_back(s);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[BoostScanner] Failed to compile pattern for '"
+                      << s.name << "': " << e.what() << "\n";
+        }
+    }
+    compiled->overlap = shapes_overlap(compiled->shapes);
+    compiled->names = std::move(names);
+    compiled->deduction = DeductionPlan::build(kept);
+    compiled->tree = ConfigLoader::build_tree(kept);
+    compiled->discs.resize(kept.size());
+    const auto flags = boost::regex::optimize | boost::regex::mod_s;
+    for (const auto& g : compiled->tree.groups) {
+        compiled->magics.emplace_back(hex_to_regex_str(g.hex_head), flags);
+        for (uint32_t id : g.children) compiled->discs[id].assign(kept[id].text_pattern, flags);
+    }
+
+    // COMBINED: one marked alternative per signature without a literal (numbered by mark_count()).
+    compiled->leads = LeadingLiterals::build(kept, compiled->regexes.size(), compiled->tree);
+    auto has_backreference = [](const std::string& pat) {
+        for (size_t i = 0; i + 1 < pat.size(); ++i) {
+            if (pat[i] != '\\') continue;
+            if (pat[i + 1] >= '1' && pat[i + 1] <= '9') return true;
+            ++i;
+        }
+        return false;
+    };
+    compiled->combined_alternative.assign(compiled->regexes.size(), -1);
+    std::string alternation;
+    size_t group = 1;
+    for (uint32_t id = 0; id < compiled->regexes.size(); ++id) {
+        const std::string pat = compiled->regexes[id].str();
+        const SignatureBounds& b = compiled->bounds[id];
+        if (compiled->leads.kind(id) != LeadingLiterals::Kind::NONE || compiled->tree.is_child(id)
+            || b.windowed() || b.max_offset || has_backreference(pat)) continue;
+        if (!alternation.empty()) alternation += '|';
+        alternation += kept[id].type == SignatureType::TEXT ? "((?i:" + pat + "))" : "(" + pat + ")";
+        compiled->combined_alternative[id] = static_cast<int>(compiled->combined_ids.size());
+        compiled->combined_ids.push_back(id);
+        compiled->combined_groups.push_back(group);
+        group += 1 + compiled->regexes[id].mark_count();
+    }
+    try {
+        if (!alternation.empty()) compiled->combined.assign(alternation, flags);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[BoostScanner] Warning: cannot combine the signatures, each is searched alone: "
+                  << e.what() << "\n";
+    }
+    if (compiled->combined.empty() || compiled->combined.mark_count() + 1 != group) {
+        compiled->combined_alternative.assign(compiled->regexes.size(), -1);
+        compiled->combined_ids.clear();
+        compiled->combined_groups.clear();
+    }
+    m_compiled = std::move(compiled);
+}
+bool BoostScanner::Compiled::find(uint32_t id, const char* data, size_t from, size_t end,
+                                  size_t& mb, size_t& me) const {
+    auto part = [data](const boost::regex& re) {
+        return [data, &re](size_t lo, size_t hi, size_t& b, size_t& e) {
+            boost::cmatch m;
+            auto flags = lo == 0 ? boost::match_default : boost::match_prev_avail;
+            if (!boost::regex_search(data + lo, data + hi, m, re, flags)) return false;
+            b = static_cast<size_t>(m[0].first - data);
+            e = static_cast<size_t>(m[0].second - data);
+            return true;
+        };
+    };
+    if (bounds[id].windowed())
+        return find_windowed(bounds[id], shapes[id].tail_len, from, end, part(heads[id]), part(tails[id]), mb, me);
+    return part(regexes[id])(from, end, mb, me);
+}
+
+namespace {
+    // Boost's step bound surfaces as a runtime_error: the step half of the file budget.
+    template <class Search>
+    void within_step_bound(Search&& search) {
+        try {
+            search();
+        }
+        catch (const ScanBudgetExceeded&) {
+            throw;
+        }
+        catch (const std::runtime_error&) {
+            throw ScanBudgetExceeded("past Boost's bound on backtracking steps");
+        }
+    }
+}
+
+void BoostScanner::scan(const char* data, size_t size, ScanStats& stats) {
+    if (!m_compiled) return;
+    stats.bind(m_compiled->names);
+    m_compiled->anchored.scan(data, size, stats);
+    m_deadline.start();
+    within_step_bound([&] {
+        if (m_matching == Matching::COMBINED) scan_combined(data, size, stats);
+        else scan_each(data, size, stats);
+    });
+}
+
+// Every search below starts with a look at the deadline: a search runs at most until
+// Boost's step bound, so the budget is overrun by one search at most.
+void BoostScanner::scan_each(const char* data, size_t size, ScanStats& stats) const {
+    const char* end = data + size;
+    const auto& regexes = m_compiled->regexes;
+    const DeductionPlan& plan = m_compiled->deduction;
+    const SignatureTree& tree = m_compiled->tree;
+    // Tree children: the first magic from `from`, then the first discriminator after it.
+    auto find = [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        boost::cmatch m;
+        m_deadline.check();
+        if (!tree.is_child(id)) return m_compiled->find(id, data, from, m_compiled->bounds[id].limit(size), mb, me);
+        if (!boost::regex_search(data + from, end, m, m_compiled->magics[tree.group_of[id]])) return false;
+        mb = static_cast<size_t>(m[0].first - data);
+        if (!boost::regex_search(m[0].second, end, m, m_compiled->discs[id], boost::match_prev_avail)) return false;
+        me = static_cast<size_t>(m[0].second - data);
+        return true;
+    };
+    auto count = [&](uint32_t id) {
+        size_t cur = 0, mb, me;
+        while (cur < size && find(id, cur, mb, me)) {
+            stats.hit(id);
+            cur = mb + std::max<size_t>(1, me - mb);
+        }
+    };
+    for (uint32_t id = 0; id < regexes.size(); ++id)
+        if (!plan.tracks(id) && !tree.is_child(id)) count(id);
+    for (size_t g = 0; g < tree.groups.size(); ++g) {
+        m_deadline.check();
+        if (!boost::regex_search(data, end, m_compiled->magics[g])) continue;
+        for (uint32_t id : tree.groups[g].children)
+            if (!plan.tracks(id)) count(id);
+    }
+    if (plan.empty()) return;
+    plan.count(size, find, stats);
+}
+
+// Literal-led signatures are counted from one LeadingLiterals pass; the rest share one
+// marked-alternative search.
+void BoostScanner::scan_combined(const char* data, size_t size, ScanStats& stats) const {
+    using Kind = LeadingLiterals::Kind;
+    const Compiled& c = *m_compiled;
+    const char* end = data + size;
+    const auto& regexes = c.regexes;
+    const DeductionPlan& plan = c.deduction;
+    const SignatureTree& tree = c.tree;
+    // Leftmost match from `from`; tree children: the first magic from `from`, then the
+    // first discriminator after it.
+    LeadingLiterals::Match find = [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        boost::cmatch m;
+        m_deadline.check();
+        if (!tree.is_child(id)) {
+            const size_t limit = c.bounds[id].limit(size);
+            return from < limit && c.find(id, data, from, limit, mb, me);
+        }
+        if (!boost::regex_search(data + from, end, m, c.magics[tree.group_of[id]],
+                                 from == 0 ? boost::match_default : boost::match_prev_avail)) return false;
+        mb = static_cast<size_t>(m[0].first - data);
+        if (!boost::regex_search(m[0].second, end, m, c.discs[id], boost::match_prev_avail)) return false;
+        me = static_cast<size_t>(m[0].second - data);
+        return true;
+    };
+    auto match_at = [&](uint32_t id, size_t p, size_t limit, size_t& me) {
+        boost::cmatch m;
+        const auto flags = boost::match_continuous | (p == 0 ? boost::match_default : boost::match_prev_avail);
+        m_deadline.check();
+        if (p >= limit || !boost::regex_search(data + p, data + limit, m, regexes[id], flags)) return false;
+        me = static_cast<size_t>(m[0].second - data);
+        return true;
+    };
+    LeadingLiterals::Match at = [&](uint32_t id, size_t p, size_t& mb, size_t& me) {
+        mb = p;
+        return match_at(id, p, c.bounds[id].limit(size), me);
+    };
+    LeadingLiterals::Cursors cursors;
+    c.leads.count(data, size, plan, cursors, at, find, stats);
+
+    // Every match of the tracked alternatives, by id, for the plan.
+    std::vector<std::vector<std::pair<size_t, size_t>>> spans(plan.empty() ? 0 : regexes.size());
+    if (!c.combined_ids.empty()) {
+        auto hit = [&](uint32_t id, size_t mb, size_t me) {
+            if (plan.tracks(id)) {
+                spans[id].emplace_back(mb, me);
+                return;
+            }
+            if (mb < cursors.next[id]) return;
+            stats.hit(id);
+            cursors.next[id] = mb + std::max<size_t>(1, me - mb);
+        };
+        boost::cmatch m;
+        for (size_t p = 0; p < size;) {
+            m_deadline.check();
+            if (!boost::regex_search(data + p, end, m, c.combined, p == 0 ? boost::match_default : boost::match_prev_avail))
+                break;
+            const size_t mb = static_cast<size_t>(m[0].first - data);
+            size_t a = 0;
+            while (!m[static_cast<int>(c.combined_groups[a])].matched) ++a;
+            hit(c.combined_ids[a], mb, static_cast<size_t>(m[0].second - data));
+            for (++a; a < c.combined_ids.size(); ++a) {
+                const uint32_t id = c.combined_ids[a];
+                size_t me;
+                if ((plan.tracks(id) || cursors.next[id] <= mb) && match_at(id, mb, size, me)) hit(id, mb, me);
+            }
+            p = mb + 1;
+        }
+    }
+    auto count = [&](uint32_t id) {
+        size_t cur = 0, mb, me;
+        while (cur < size && find(id, cur, mb, me)) {
+            stats.hit(id);
+            cur = mb + std::max<size_t>(1, me - mb);
+        }
+    };
+    for (uint32_t id = 0; id < regexes.size(); ++id)
+        if (c.leads.kind(id) == Kind::NONE && c.combined_alternative[id] < 0 && !plan.tracks(id)) count(id);
+
+    if (plan.empty()) return;
+    plan.count(size, [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        if (c.leads.kind(id) != Kind::NONE) return c.leads.find(id, from, size, cursors, at, find, mb, me);
+        if (c.combined_alternative[id] < 0) return find(id, from, mb, me);
+        const auto& all = spans[id];
+        auto it = std::lower_bound(all.begin(), all.end(), std::make_pair(from, size_t{0}));
+        if (it == all.end()) return false;
+        mb = it->first;
+        me = it->second;
+        return true;
+    }, stats);
+}
+void BoostScanner::scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                                 size_t segment_bytes) {
+    if (!m_compiled) return;
+    const auto compiled = m_compiled;
+    auto starts = plan_segments(size, threads, compiled->overlap, segment_bytes);
+    if (threads < 2 || starts.size() <= 2) return scan(data, size, stats);
+
+    m_deadline.start();
+    const ScanDeadline& deadline = m_deadline;
+    auto find = [data, &compiled, &deadline](uint32_t id, LeftmostSegments::Part part, size_t from, size_t end,
+                                             size_t& mb, size_t& me) {
+        deadline.check();
+        end = compiled->bounds[id].limit(end);
+        if (part == LeftmostSegments::Part::WHOLE) return from < end && compiled->find(id, data, from, end, mb, me);
+        boost::cmatch m;
+        auto flags = from == 0 ? boost::match_default : boost::match_prev_avail;
+        const auto& re = part == LeftmostSegments::Part::HEAD ? compiled->heads[id] : compiled->tails[id];
+        if (!boost::regex_search(data + from, data + end, m, re, flags)) return false;
+        mb = static_cast<size_t>(m[0].first - data);
+        me = static_cast<size_t>(m[0].second - data);
+        return true;
+    };
+    LeftmostSegments segments(compiled->shapes, compiled->deduction, size, std::move(starts), compiled->overlap,
+                              find, nullptr);
+    within_step_bound([&] {
+        add_totals(stats, compiled->names, segments.run(threads));
+        segments.count_tracked(stats);
+    });
+    compiled->anchored.scan(data, size, stats);
+}
+
+void BoostScanner::classify(const char* data, size_t size, ScanStats& stats) {
+    if (!m_compiled) return;
+    stats.bind(m_compiled->names);
+    const Compiled& c = *m_compiled;
+    m_deadline.start();
+    within_step_bound([&] {
+        classify_prefixes(data, size, c.deduction, c.anchored, [&](size_t window, MatchEnds& out) {
+            size_t mb, me;
+            for (uint32_t id = 0; id < c.regexes.size(); ++id) {
+                if (c.tree.is_child(id)) continue;
+                const size_t end = c.bounds[id].limit(window);
+                m_deadline.check();
+                if (end && c.find(id, data, 0, end, mb, me)) out.emplace_back(me, id);
+            }
+            for (size_t g = 0; g < c.tree.groups.size(); ++g) {
+                boost::cmatch m;
+                m_deadline.check();
+                if (!boost::regex_search(data, data + window, m, c.magics[g])) continue;
+                const char* after = m[0].second;
+                for (uint32_t id : c.tree.groups[g].children)
+                    if (boost::regex_search(after, data + window, m, c.discs[id], boost::match_prev_avail))
+                        out.emplace_back(static_cast<size_t>(m[0].second - data), id);
+            }
+        }, stats);
+    });
+}
+
+// boost::regex is safe to share between threads once compiled; a fork is just a reference.
+std::unique_ptr<Scanner> BoostScanner::fork() const {
+    auto copy = std::make_unique<BoostScanner>(m_matching);
+    copy->m_compiled = m_compiled;
+    copy->m_deadline = m_deadline;
+    return copy;
+}
+
+namespace {
+    class BoostStream : public CarryOverStream {
+    public:
+        // The time budget runs from open_stream() to close(), across every write().
+        BoostStream(std::shared_ptr<const BoostScanner::Compiled> compiled, ScanDeadline deadline, ScanStats& stats)
+            : CarryOverStream(compiled->names, compiled->deduction, compiled->bounds, compiled->shapes, stats),
+              m_compiled(std::move(compiled)), m_deadline(deadline) {
+            m_deadline.start();
+        }
+        ~BoostStream() override { close(); }
+
+    protected:
+        bool find(size_t idx, Part part, const char* begin, const char* from, const char* end,
+                  const char*& m_begin, const char*& m_end) override {
+            const auto id = static_cast<uint32_t>(idx);
+            m_deadline.check();
+            bool found = false;
+            within_step_bound([&] {
+                if (part != Part::WHOLE) {
+                    boost::cmatch m;
+                    const auto& re = part == Part::HEAD ? m_compiled->heads[id] : m_compiled->tails[id];
+                    auto flags = from == begin ? boost::match_default : boost::match_prev_avail;
+                    if (!boost::regex_search(from, end, m, re, flags)) return;
+                    m_begin = m[0].first;
+                    m_end = m[0].second;
+                    found = true;
+                    return;
+                }
+                size_t mb, me;
+                if (!m_compiled->find(id, begin, static_cast<size_t>(from - begin), static_cast<size_t>(end - begin),
+                                      mb, me)) return;
+                m_begin = begin + mb;
+                m_end = begin + me;
+                found = true;
+            });
+            return found;
+        }
+
+    private:
+        std::shared_ptr<const BoostScanner::Compiled> m_compiled;
+        ScanDeadline m_deadline;
+    };
+
+    // Returned when the engine has nothing to match (empty or failed prepare()).
+    class NullStream : public ScanStream {
+    public:
+        void write(const char*, size_t) override {}
+        void close() override {}
+    };
+}
+
+std::unique_ptr<ScanStream> BoostScanner::open_stream(ScanStats& stats) {
+    if (!m_compiled) return std::make_unique<NullStream>();
+    return with_anchors(std::make_unique<BoostStream>(m_compiled, m_deadline, stats), m_compiled, m_compiled->anchored,
+                        m_compiled->names, stats);
+}
+
+// === RE2 (two-phase: Set filter → individual count) ===
+// Immutable after prepare() and thread-safe, so all forks share it.
+struct Re2Scanner::Compiled {
+    std::unique_ptr<re2::RE2::Set> set;
+    std::vector<std::unique_ptr<re2::RE2>> regexes; // index == signature id
+    std::vector<std::unique_ptr<re2::RE2>> heads;   // HEAD_TAIL: head alone (null otherwise)
+    std::vector<std::unique_ptr<re2::RE2>> tails;   // HEAD_TAIL: tail alone (null otherwise)
+    std::vector<SignatureShape> shapes;
+    size_t overlap = 0;
+    std::shared_ptr<const SignatureNames> names;
+    DeductionPlan deduction;
+    SignatureTree tree;
+    std::vector<std::unique_ptr<re2::RE2>> magics; // by tree group
+    std::vector<std::unique_ptr<re2::RE2>> discs;  // tree children: text_pattern alone (null otherwise)
+    // Set entries: set_ids (every id but the tree children), then the magic of each
+    // group, then the discriminator of each child in set_children.
+    std::vector<uint32_t> set_ids;
+    std::vector<uint32_t> set_children;
+    std::vector<SignatureBounds> bounds; // by id
+    AnchoredSignatures anchored;         // ids from regexes.size() on
+
+    LeadingLiterals leads; // SINGLE_PASS
+
+    // Leftmost match of signature `id` (bounds applied, but not max_offset: that is the
+    // caller's `end`) in data[from, end), as offsets from `data`, where the input starts.
+    bool find(uint32_t id, const char* data, size_t from, size_t end, size_t& mb, size_t& me) const {
+        const re2::StringPiece text(data, end);
+        auto part = [data, &text](const re2::RE2& re) {
+            return [data, &text, &re](size_t lo, size_t hi, size_t& b, size_t& e) {
+                re2::StringPiece m;
+                if (!re.Match(text, lo, hi, re2::RE2::UNANCHORED, &m, 1)) return false;
+                b = static_cast<size_t>(m.data() - data);
+                e = b + m.size();
+                return true;
+            };
+        };
+        if (bounds[id].windowed())
+            return find_windowed(bounds[id], shapes[id].tail_len, from, end, part(*heads[id]), part(*tails[id]), mb, me);
+        return part(*regexes[id])(from, end, mb, me);
+    }
+};
+
+namespace {
+    // RE2::Set entries that matched -> active[id]. A tree child is active when both its
+    // magic and its discriminator occur.
+    void activate(const std::vector<int>& entries, const std::vector<uint32_t>& set_ids,
+                  const std::vector<uint32_t>& set_children, const SignatureTree& tree,
+                  std::vector<char>& active) {
+        std::fill(active.begin(), active.end(), 0);
+        const size_t magics = set_ids.size(), discs = magics + tree.groups.size();
+        std::vector<char> magic(tree.groups.size(), 0);
+        std::vector<uint32_t> found;
+        for (int e : entries) {
+            const auto entry = static_cast<size_t>(e);
+            if (entry < magics) active[set_ids[entry]] = 1;
+            else if (entry < discs) magic[entry - magics] = 1;
+            else found.push_back(set_children[entry - discs]);
+        }
+        for (uint32_t id : found) active[id] = magic[tree.group_of[id]];
+    }
+}
+
+Re2Scanner::Re2Scanner(Counting counting) : Re2Scanner(counting, LeadingLiterals::best_kernel()) {}
+Re2Scanner::Re2Scanner(Counting counting, LeadingLiterals::Kernel kernel)
+    : m_counting(counting), m_kernel(kernel) {} // Compiled is complete here
+Re2Scanner::~Re2Scanner() = default;
+
+std::string Re2Scanner::name() const { return "Google RE2"; }
+std::shared_ptr<const SignatureNames> Re2Scanner::signature_names() const {
+    return m_compiled ? m_compiled->names : nullptr;
+}
+
+void Re2Scanner::prepare(const std::vector<SignatureDefinition>& sigs) {
+    auto compiled = std::make_shared<Compiled>();
+    auto names = std::make_shared<SignatureNames>();
+    std::vector<SignatureDefinition> kept; // by id
+
+    // Build individual regexes (for phase 2 counting); anchored signatures get the last ids
+    for (const auto& s : AnchoredSignatures::order(sigs)) {
+        if (s.anchored()) {
+            compiled->anchored.add(static_cast<uint32_t>(kept.size()), s);
+            names->push_back(s.name);
+            kept.push_back(s);
+            continue;
+        }
+        std::string pat = build_pattern(s);
+        if (pat.empty()) continue;
+
+        re2::RE2::Options opt;
+        opt.set_encoding(re2::RE2::Options::EncodingLatin1);
+        opt.set_dot_nl(true);
+        if (s.type == SignatureType::TEXT) opt.set_case_sensitive(false);
+        auto re = std::make_unique<re2::RE2>(pat, opt);
+        if (re->ok()) {
+            SignatureShape shape = signature_shape(s);
+            std::unique_ptr<re2::RE2> head, tail;
+            if (shape.kind == SignatureShape::Kind::HEAD_TAIL || s.windowed()) {
+                head = std::make_unique<re2::RE2>(shape.head, opt);
+                tail = std::make_unique<re2::RE2>(shape.tail, opt);
+            }
+            compiled->regexes.push_back(std::move(re));
+            compiled->heads.push_back(std::move(head));
+            compiled->tails.push_back(std::move(tail));
+            compiled->shapes.push_back(std::move(shape));
+            compiled->bounds.push_back(SignatureBounds::of(s));
+            names->push_back(s.name);
+            kept.push_back(s);
+        }
+    }
+    compiled->overlap = shapes_overlap(compiled->shapes);
+    compiled->names = std::move(names);
+    compiled->deduction = DeductionPlan::build(kept);
+    compiled->tree = ConfigLoader::build_tree(kept);
+    compiled->discs.resize(kept.size());
+
+    compiled->leads = LeadingLiterals::build(kept, compiled->regexes.size(), compiled->tree);
+
+    re2::RE2::Options opt;
+    opt.set_encoding(re2::RE2::Options::EncodingLatin1);
+    opt.set_dot_nl(true);
+    for (const auto& g : compiled->tree.groups) {
+        compiled->magics.push_back(std::make_unique<re2::RE2>(hex_to_regex_str(g.hex_head), opt));
+        for (uint32_t id : g.children) compiled->discs[id] = std::make_unique<re2::RE2>(kept[id].text_pattern, opt);
+    }
+
+    // Build RE2::Set (for phase 1 filtering): tree children are represented by their magic
+    // and their discriminator.
+    auto set = std::make_unique<re2::RE2::Set>(opt, re2::RE2::UNANCHORED);
+    for (uint32_t id = 0; id < compiled->regexes.size(); ++id) {
+        if (compiled->tree.is_child(id)) continue;
+        std::string err;
+        const re2::RE2& re = *compiled->regexes[id];
+        // The Set has one options object: case-insensitive (text) patterns carry their own flag.
+        set->Add(re.options().case_sensitive() ? re.pattern() : "(?i)" + re.pattern(), &err);
+        compiled->set_ids.push_back(id);
+    }
+    for (const auto& magic : compiled->magics) {
+        std::string err;
+        set->Add(magic->pattern(), &err);
+    }
+    for (uint32_t id = 0; id < compiled->discs.size(); ++id) {
+        if (!compiled->discs[id]) continue;
+        std::string err;
+        set->Add(compiled->discs[id]->pattern(), &err);
+        compiled->set_children.push_back(id);
+    }
+    if (set->Compile()) {
+        compiled->set = std::move(set);
+    }
+    m_compiled = std::move(compiled);
+}
+
+void Re2Scanner::scan(const char* data, size_t size, ScanStats& stats) {
+    if (!m_compiled) return;
+    stats.bind(m_compiled->names);
+    m_compiled->anchored.scan(data, size, stats);
+    if (m_counting == Counting::SINGLE_PASS) count_single_pass(data, size, stats);
+    else count_two_phase(data, size, stats);
+}
+
+void Re2Scanner::count_two_phase(const char* data, size_t size, ScanStats& stats) {
+    const auto& regexes = m_compiled->regexes;
+    const DeductionPlan& plan = m_compiled->deduction;
+    const SignatureTree& tree = m_compiled->tree;
+    const re2::StringPiece text(data, size);
+    m_matched.assign(regexes.size(), 1);
+    std::vector<char>& matched = m_matched;
+    // Tree children: the first magic from `from`, then the first discriminator after it.
+    auto find = [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        re2::StringPiece m;
+        if (!matched[id]) return false;
+        if (!tree.is_child(id)) {
+            const size_t end = m_compiled->bounds[id].limit(size);
+            return from < end && m_compiled->find(id, data, from, end, mb, me);
+        }
+        if (!m_compiled->magics[tree.group_of[id]]->Match(text, from, size, re2::RE2::UNANCHORED, &m, 1)) return false;
+        mb = static_cast<size_t>(m.data() - data);
+        const size_t after = mb + m.size();
+        if (!m_compiled->discs[id]->Match(text, after, size, re2::RE2::UNANCHORED, &m, 1)) return false;
+        me = static_cast<size_t>(m.data() - data) + m.size();
+        return true;
+    };
+    // Signatures in a deduct_from relation are counted by the plan, which needs offsets.
+    auto count = [&](uint32_t id) {
+        if (plan.tracks(id)) return;
+        const SignatureBounds& b = m_compiled->bounds[id];
+        if (!tree.is_child(id) && !b.windowed()) {
+            re2::StringPiece input(data, b.limit(size));
+            while (re2::RE2::FindAndConsume(&input, *regexes[id])) stats.hit(id);
+            return;
+        }
+        size_t cur = 0, mb, me;
+        while (cur < size && find(id, cur, mb, me)) {
+            stats.hit(id);
+            cur = mb + std::max<size_t>(1, me - mb);
+        }
+    };
+
+    // Phase 1: fast filter — which patterns (and magics) match at all? Without a set
+    // every pattern is counted individually.
+    if (const auto* set = m_compiled->set.get()) {
+        m_entries.clear();
+        set->Match(text, &m_entries);
+        activate(m_entries, m_compiled->set_ids, m_compiled->set_children, tree, matched);
+    }
+    // Phase 2: count matches only for patterns that were found
+    for (uint32_t id = 0; id < regexes.size(); ++id)
+        if (matched[id]) count(id);
+    if (plan.empty()) return;
+    plan.count(size, find, stats);
+}
+
+// Literal-led signatures are counted from one LeadingLiterals pass, the rest two-phase.
+void Re2Scanner::count_single_pass(const char* data, size_t size, ScanStats& stats) {
+    const Compiled& c = *m_compiled;
+    const DeductionPlan& plan = c.deduction;
+    const SignatureTree& tree = c.tree;
+    const size_t n = c.regexes.size();
+    const re2::StringPiece text(data, size);
+
+    // Leftmost match from `from` (as in count_two_phase(), less the Set filter); tree
+    // children: the first magic from `from`, then the first discriminator after it.
+    LeadingLiterals::Match find = [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        re2::StringPiece m;
+        if (!tree.is_child(id)) {
+            const size_t end = c.bounds[id].limit(size);
+            return from < end && c.find(id, data, from, end, mb, me);
+        }
+        if (!c.magics[tree.group_of[id]]->Match(text, from, size, re2::RE2::UNANCHORED, &m, 1)) return false;
+        mb = static_cast<size_t>(m.data() - data);
+        if (!c.discs[id]->Match(text, mb + m.size(), size, re2::RE2::UNANCHORED, &m, 1)) return false;
+        me = static_cast<size_t>(m.data() - data) + m.size();
+        return true;
+    };
+    LeadingLiterals::Match at = [&](uint32_t id, size_t p, size_t& mb, size_t& me) {
+        re2::StringPiece m;
+        const size_t end = c.bounds[id].limit(size);
+        if (p >= end || !c.regexes[id]->Match(text, p, end, re2::RE2::ANCHOR_START, &m, 1)) return false;
+        mb = p;
+        me = p + m.size();
+        return true;
+    };
+    c.leads.count(data, size, plan, m_cursors, at, find, stats, m_kernel);
+
+    m_matched.assign(n, 1);
+    if (!c.leads.all()) {
+        if (c.set) {
+            m_entries.clear();
+            c.set->Match(text, &m_entries);
+            activate(m_entries, c.set_ids, c.set_children, tree, m_matched);
+        }
+        for (uint32_t id = 0; id < n; ++id) {
+            if (c.leads.kind(id) != LeadingLiterals::Kind::NONE || !m_matched[id] || plan.tracks(id)) continue;
+            size_t cur = 0, mb, me;
+            while (cur < size && find(id, cur, mb, me)) {
+                stats.hit(id);
+                cur = mb + std::max<size_t>(1, me - mb);
+            }
+        }
+    }
+    if (plan.empty()) return;
+    plan.count(size, [&](uint32_t id, size_t from, size_t& mb, size_t& me) {
+        if (c.leads.kind(id) == LeadingLiterals::Kind::NONE) return m_matched[id] && find(id, from, mb, me);
+        return c.leads.find(id, from, size, m_cursors, at, find, mb, me);
+    }, stats);
+}
+
+void Re2Scanner::scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                               size_t segment_bytes) {
+    if (!m_compiled) return;
+    const auto compiled = m_compiled;
+    auto starts = plan_segments(size, threads, compiled->overlap, segment_bytes);
+    if (threads < 2 || starts.size() <= 2) return scan(data, size, stats);
+
+    auto find = [data, &compiled](uint32_t id, LeftmostSegments::Part part, size_t from, size_t end,
+                                  size_t& mb, size_t& me) {
+        end = compiled->bounds[id].limit(end);
+        if (part == LeftmostSegments::Part::WHOLE) return from < end && compiled->find(id, data, from, end, mb, me);
+        re2::StringPiece text(data, end);
+        re2::StringPiece m;
+        const auto& re = part == LeftmostSegments::Part::HEAD ? *compiled->heads[id] : *compiled->tails[id];
+        if (!re.Match(text, from, end, re2::RE2::UNANCHORED, &m, 1)) return false;
+        mb = static_cast<size_t>(m.data() - data);
+        me = mb + m.size();
+        return true;
+    };
+    LeftmostSegments::Select select;
+    if (const re2::RE2::Set* set = compiled->set.get()) {
+        select = [data, set, &compiled](size_t from, size_t end, std::vector<char>& active) {
+            std::vector<int> entries;
+            set->Match(re2::StringPiece(data + from, end - from), &entries);
+            activate(entries, compiled->set_ids, compiled->set_children, compiled->tree, active);
+        };
+    }
+    LeftmostSegments segments(compiled->shapes, compiled->deduction, size, std::move(starts), compiled->overlap,
+                              find, select);
+    add_totals(stats, compiled->names, segments.run(threads));
+    segments.count_tracked(stats);
+    compiled->anchored.scan(data, size, stats);
+}
+
+// Phase 1 runs per prefix; phase 2 stops at the first match of each active pattern.
+void Re2Scanner::classify(const char* data, size_t size, ScanStats& stats) {
+    if (!m_compiled) return;
+    stats.bind(m_compiled->names);
+    const Compiled& c = *m_compiled;
+    std::vector<char> matched(c.regexes.size(), 1);
+    std::vector<int> entries;
+    classify_prefixes(data, size, c.deduction, c.anchored, [&](size_t window, MatchEnds& out) {
+        const re2::StringPiece text(data, window);
+        if (c.set) {
+            entries.clear();
+            c.set->Match(text, &entries);
+            activate(entries, c.set_ids, c.set_children, c.tree, matched);
+        }
+        re2::StringPiece m;
+        size_t mb, me;
+        for (uint32_t id = 0; id < c.regexes.size(); ++id) {
+            if (!matched[id]) continue;
+            if (!c.tree.is_child(id)) {
+                const size_t end = c.bounds[id].limit(window);
+                if (end && c.find(id, data, 0, end, mb, me)) out.emplace_back(me, id);
+                continue;
+            }
+            if (!c.magics[c.tree.group_of[id]]->Match(text, 0, window, re2::RE2::UNANCHORED, &m, 1)) continue;
+            const size_t after = static_cast<size_t>(m.data() - data) + m.size();
+            if (c.discs[id]->Match(text, after, window, re2::RE2::UNANCHORED, &m, 1))
+                out.emplace_back(static_cast<size_t>(m.data() - data) + m.size(), id);
+        }
+    }, stats);
+}
+
+std::unique_ptr<Scanner> Re2Scanner::fork() const {
+    std::unique_ptr<Re2Scanner> copy(new Re2Scanner(m_counting, m_kernel)); // the kernel stays pinned
+    copy->m_compiled = m_compiled;
+    return copy;
+}
+
+// === Literal prefilter ===
+LiteralScanner::LiteralScanner(LeadingLiterals::Kernel kernel) : Re2Scanner(Counting::SINGLE_PASS, kernel) {}
+
+std::string LiteralScanner::name() const { return "SIMD literals + RE2"; }
+
+std::unique_ptr<Scanner> LiteralScanner::fork() const {
+    auto copy = std::make_unique<LiteralScanner>(m_kernel);
+    copy->m_compiled = m_compiled;
+    return copy;
+}
+
+namespace {
+    class Re2Stream : public CarryOverStream {
+    public:
+        Re2Stream(std::shared_ptr<const Re2Scanner::Compiled> compiled, ScanStats& stats)
+            : CarryOverStream(compiled->names, compiled->deduction, compiled->bounds, compiled->shapes, stats),
+              m_compiled(std::move(compiled)) {}
+        ~Re2Stream() override { close(); }
+
+    protected:
+        bool find(size_t idx, Part part, const char* begin, const char* from, const char* end,
+                  const char*& m_begin, const char*& m_end) override {
+            const auto id = static_cast<uint32_t>(idx);
+            if (part != Part::WHOLE) {
+                re2::StringPiece m;
+                const re2::RE2& re = part == Part::HEAD ? *m_compiled->heads[id] : *m_compiled->tails[id];
+                const auto size = static_cast<size_t>(end - begin);
+                if (!re.Match(re2::StringPiece(begin, size), static_cast<size_t>(from - begin), size,
+                              re2::RE2::UNANCHORED, &m, 1)) return false;
+                m_begin = m.data();
+                m_end = m.data() + m.size();
+                return true;
+            }
+            size_t mb, me;
+            if (!m_compiled->find(id, begin, static_cast<size_t>(from - begin), static_cast<size_t>(end - begin),
+                                  mb, me)) return false;
+            m_begin = begin + mb;
+            m_end = begin + me;
+            return true;
+        }
+        void select(const char* from, const char* end, std::vector<char>& active) override {
+            const re2::RE2::Set* set = m_compiled->set.get();
+            if (!set) return;
+            m_entries.clear();
+            set->Match(re2::StringPiece(from, static_cast<size_t>(end - from)), &m_entries);
+            activate(m_entries, m_compiled->set_ids, m_compiled->set_children, m_compiled->tree, active);
+        }
+
+    private:
+        std::shared_ptr<const Re2Scanner::Compiled> m_compiled;
+        std::vector<int> m_entries;
+    };
+}
+
+std::unique_ptr<ScanStream> Re2Scanner::open_stream(ScanStats& stats) {
+    if (!m_compiled) return std::make_unique<NullStream>();
+    return with_anchors(std::make_unique<Re2Stream>(m_compiled, stats), m_compiled, m_compiled->anchored,
+                        m_compiled->names, stats);
+}
+
+// === Hyperscan ===
+// Read-only databases shared by forks; matches are counted leftmost-first via LeftmostCount.
+struct HsScanner::Database {
+    // Expressions of one database, parallel vectors for load_or_compile().
+    struct Exprs {
+        std::vector<std::string> exprs;
+        std::vector<unsigned int> flags;
+        std::vector<unsigned int> ids;
+        std::vector<hs_expr_ext> exts;
+
+        void add(std::string expr, unsigned int flag, unsigned int id, const hs_expr_ext& ext) {
+            exprs.push_back(std::move(expr));
+            flags.push_back(flag);
+            ids.push_back(id);
+            exts.push_back(ext);
+        }
+    };
+
+    hs_database* block = nullptr;
+    hs_database* stream = nullptr;
+    hs_database* segment = nullptr;
+    hs_database* residue = nullptr;
+    hs_database* classify = nullptr;
+    hs_database* vectored = nullptr;
+    std::vector<hs_database*> children; // by tree group
+    std::once_flag stream_once;
+    std::once_flag classify_once;
+    std::once_flag vectored_once;
+    std::once_flag split_once;
+    std::shared_ptr<const SignatureNames> names;
+    std::vector<std::string> patterns;
+    std::vector<unsigned int> flags;
+    std::vector<hs_expr_ext> exts; // max_offset / min_length by id, flags == 0: none
+    std::vector<SignatureShape> shapes;
+    std::vector<int> piece_of;     // by id: split pattern j, -1 = compiled whole
+    std::vector<std::pair<std::string, std::string>> pieces; // by j: head, tail
+    std::vector<uint32_t> piece_owner; // by j: pattern id
+    unsigned int piece_base = 0;       // patterns + tree groups
+    AnchoredSignatures anchored;     // ids from patterns.size() on
+    size_t overlap = 0;
+    DeductionPlan deduction;
+    SignatureTree tree;
+    uint64_t sig_hash = 0;
+    std::string cache_dir;
+
+    ~Database() {
+        for (auto* c : children) if (c) hs_free_database(c);
+        if (block) hs_free_database(block);
+        if (stream) hs_free_database(stream);
+        if (segment) hs_free_database(segment);
+        if (residue) hs_free_database(residue);
+        if (classify) hs_free_database(classify);
+        if (vectored) hs_free_database(vectored);
+    }
+
+    // `expr_exts` is parallel to `exprs`, or empty when no expression has extended parameters.
+    hs_database* load_or_compile(const std::vector<std::string>& exprs, const std::vector<unsigned int>& expr_flags,
+                                 const std::vector<unsigned int>& ids, const std::vector<hs_expr_ext>& expr_exts,
+                                 unsigned int mode) const;
+
+    hs_database* load_or_compile(const Exprs& e, unsigned int mode) const {
+        return load_or_compile(e.exprs, e.flags, e.ids, e.exts, mode);
+    }
+
+    // Pattern `id` as leftmost counting compiles it: whole, or as its head and tail.
+    void add_leftmost(unsigned int id, Exprs& out) const {
+        const unsigned int som = flags[id] | HS_FLAG_SOM_LEFTMOST;
+        const int j = piece_of[id];
+        if (j < 0) return out.add(patterns[id], som, id, exts[id]);
+        const unsigned int head = piece_base + 2 * static_cast<unsigned int>(j);
+        out.add(pieces[j].first, som, head, hs_expr_ext{});
+        out.add(pieces[j].second, som, head + 1, hs_expr_ext{});
+    }
+
+    hs_database* stream_db() {
+        std::call_once(stream_once, [this] {
+            Exprs all;
+            for (unsigned int id = 0; id < patterns.size(); ++id) add_leftmost(id, all);
+            // Starts are full 64-bit stream offsets however far back the match began.
+            stream = load_or_compile(all, HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE);
+        });
+        return stream;
+    }
+
+    hs_database* vectored_db() {
+        std::call_once(vectored_once, [this] {
+            Exprs all;
+            for (unsigned int id = 0; id < patterns.size(); ++id) add_leftmost(id, all);
+            vectored = load_or_compile(all, HS_MODE_VECTORED);
+        });
+        return vectored;
+    }
+
+    hs_database* classify_db() {
+        std::call_once(classify_once, [this] {
+            std::vector<unsigned int> single(flags), ids(patterns.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                single[i] |= HS_FLAG_SINGLEMATCH;
+                ids[i] = static_cast<unsigned int>(i);
+            }
+            classify = load_or_compile(patterns, single, ids, exts, HS_MODE_BLOCK);
+        });
+        return classify;
+    }
+
+    void build_split() {
+        std::call_once(split_once, [this] {
+            Exprs seg, res;
+            for (unsigned int id = 0; id < patterns.size(); ++id)
+                add_leftmost(id, piece_of[id] >= 0 || shapes[id].kind == SignatureShape::Kind::BOUNDED ? seg : res);
+            if (!seg.exprs.empty()) segment = load_or_compile(seg, HS_MODE_BLOCK);
+            if (!res.exprs.empty()) residue = load_or_compile(res, HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE);
+        });
+    }
+};
+
+namespace {
+    // Callbacks cannot throw: every DEADLINE_STRIDE-th match checks the clock and stops the scan.
+    constexpr unsigned int DEADLINE_STRIDE = 4096;
+    int out_of_time(const ScanDeadline& deadline, unsigned int& matches) {
+        return ++matches % DEADLINE_STRIDE == 0 && deadline.expired() ? 1 : 0;
+    }
+
+    // Counts one scan's matches: whole patterns below `n`, then tree magics, then split pieces
+    // from `piece_base`; deduct_from matches are counted in flush().
+    class HsLeftmost {
+    public:
+        HsLeftmost(unsigned int n, unsigned int piece_base, const std::vector<uint32_t>& owners,
+                   const DeductionPlan& plan, size_t ids)
+            : counts(ids, 0), m_n(n), m_piece_base(piece_base), m_owners(owners), m_plan(plan),
+              m_tracked(plan.empty() ? 0 : ids) {
+            m_count.reset(n);
+        }
+
+        // False for a tree magic, which the caller keeps for the children scan.
+        bool add(unsigned int id, uint64_t from, uint64_t to) {
+            if (id < m_n) {
+                if (m_plan.tracks(id)) m_tracked.whole(id, from, to);
+                else if (m_count.match(id, from, to)) counts[id]++;
+                return true;
+            }
+            if (id < m_piece_base) return false;
+            const uint32_t owner = m_owners[(id - m_piece_base) / 2];
+            if ((id - m_piece_base) % 2 == 0) head(owner, from, to);
+            else tail(owner, from, to);
+            return true;
+        }
+        // Tree child `id`: each of its group's magics is a head, its discriminator the tail.
+        void head(uint32_t id, uint64_t from, uint64_t to) {
+            if (m_plan.tracks(id)) m_tracked.head(id, from, to);
+            else m_count.head(id, from, to);
+        }
+        void tail(uint32_t id, uint64_t from, uint64_t to) {
+            if (m_plan.tracks(id)) m_tracked.tail(id, from, to);
+            else if (m_count.tail(id, from, to)) counts[id]++;
+        }
+
+        // Matches of the same input seen by another count (scan_parallel()'s residue).
+        void merge(const HsLeftmost& other) {
+            for (size_t id = 0; id < counts.size(); ++id) counts[id] += other.counts[id];
+            m_tracked.merge(other.m_tracked);
+        }
+
+        // Adds the counts of the `size` bytes scanned to `stats`.
+        void flush(const std::shared_ptr<const SignatureNames>& names, uint64_t size, ScanStats& stats) {
+            add_totals(stats, names, counts);
+            m_tracked.count(m_plan, size, stats);
+        }
+
+        std::vector<uint64_t> counts; // by id, tracked signatures aside
+
+    private:
+        unsigned int m_n;
+        unsigned int m_piece_base;
+        const std::vector<uint32_t>& m_owners; // by piece pair: pattern id
+        const DeductionPlan& m_plan;
+        LeftmostCount m_count;
+        TrackedSpans m_tracked;
+    };
+}
+
+HsScanner::HsScanner() = default;
+HsScanner::~HsScanner() {
+    if (scratch) hs_free_scratch(scratch);
+}
+std::string HsScanner::name() const { return "Hyperscan"; }
+std::shared_ptr<const SignatureNames> HsScanner::signature_names() const {
+    return m_db ? m_db->names : nullptr;
+}
+void HsScanner::prepare(const std::vector<SignatureDefinition>& sigs) {
+    if (scratch) { hs_free_scratch(scratch); scratch = nullptr; }
+    m_stream_scratch = false;
+    m_classify_scratch = false;
+    m_vectored_scratch = false;
+    m_db.reset();
+
+    auto db = std::make_shared<Database>();
+    auto names = std::make_shared<SignatureNames>();
+    std::vector<SignatureDefinition> kept; // by id
+    db->patterns.reserve(sigs.size());
+    db->sig_hash = signature_set_hash(sigs);
+    db->cache_dir = m_cache_dir;
+
+    for (const auto& s : AnchoredSignatures::order(sigs)) {
+        if (s.anchored()) {
+            db->anchored.add(static_cast<uint32_t>(kept.size()), s);
+            names->push_back(s.name);
+            kept.push_back(s);
+            continue;
+        }
+        std::string pat = build_pattern(s);
+        if (pat.empty()) continue;
+        // Hyperscan bounds the gap natively: `head.{0,max_gap}tail`. min_length and
+        // max_offset are hs_expr_ext parameters.
+        if (s.max_gap) {
+            const std::string tail = !s.hex_tail.empty() ? hex_to_regex_str(s.hex_tail) : s.text_pattern;
+            pat = hex_to_regex_str(s.hex_head) + ".{0," + std::to_string(s.max_gap) + "}" + tail;
+        }
+        db->patterns.push_back(pat);
+        db->shapes.push_back(signature_shape(s));
+        names->push_back(s.name);
+        kept.push_back(s);
+        db->flags.push_back(HS_FLAG_DOTALL | (s.type == SignatureType::TEXT ? HS_FLAG_CASELESS : 0));
+        hs_expr_ext ext{};
+        if (s.max_offset) {
+            ext.flags |= HS_EXT_FLAG_MAX_OFFSET;
+            ext.max_offset = s.max_offset;
+        }
+        if (s.min_length) {
+            ext.flags |= HS_EXT_FLAG_MIN_LENGTH;
+            ext.min_length = s.min_length;
+        }
+        db->exts.push_back(ext);
+    }
+
+    db->overlap = shapes_overlap(db->shapes);
+    db->names = std::move(names);
+    db->deduction = DeductionPlan::build(kept);
+    db->tree = ConfigLoader::build_tree(kept);
+
+    if (db->patterns.empty()) {
+        if (!db->anchored.empty()) m_db = std::move(db); // anchors only: no database, no scratch
+        return;
+    }
+    const auto n = static_cast<unsigned int>(db->patterns.size());
+    // A lazy `head.*?tail` reports every end after its first head with that head as the
+    // start, so it is found as its two pieces; extended parameters bound the whole match.
+    db->piece_base = n + static_cast<unsigned int>(db->tree.groups.size());
+    db->piece_of.assign(n, -1);
+    for (unsigned int id = 0; id < n; ++id) {
+        std::string head, tail;
+        if (db->exts[id].flags || kept[id].windowed() || !LeftmostCount::split(db->patterns[id], head, tail)) continue;
+        db->piece_of[id] = static_cast<int>(db->pieces.size());
+        db->piece_owner.push_back(id);
+        db->overlap = std::max(db->overlap, std::max(MaxLength(head).run(), MaxLength(tail).run()) + 1);
+        db->pieces.emplace_back(std::move(head), std::move(tail));
+    }
+    Database::Exprs first;
+    for (unsigned int id = 0; id < n; ++id)
+        if (!db->tree.is_child(id)) db->add_leftmost(id, first);
+    for (unsigned int g = 0; g < db->tree.groups.size(); ++g) {
+        const auto& group = db->tree.groups[g];
+        first.add(hex_to_regex_str(group.hex_head), HS_FLAG_DOTALL | HS_FLAG_SOM_LEFTMOST, n + g, hs_expr_ext{});
+        std::vector<std::string> exprs;
+        std::vector<unsigned int> ids(group.children.begin(), group.children.end());
+        for (uint32_t id : group.children) exprs.push_back(kept[id].text_pattern);
+        db->children.push_back(db->load_or_compile(exprs, std::vector<unsigned int>(ids.size(), HS_FLAG_DOTALL | HS_FLAG_SOM_LEFTMOST),
+                                                   ids, {}, HS_MODE_BLOCK));
+        if (!db->children.back()) return;
+    }
+    db->block = db->load_or_compile(first, HS_MODE_BLOCK);
+    if (!db->block) return;
+    hs_alloc_scratch(db->block, &scratch);
+    for (auto* c : db->children) hs_alloc_scratch(c, &scratch);
+    m_db = std::move(db);
+}
+void HsScanner::scan(const char* data, size_t size, ScanStats& stats) {
+    if (!m_db) return;
+    // hs_scan takes a 32-bit length: larger inputs run vectored or streamed.
+    if (size > UINT_MAX) {
+        if (ensure_vectored_scratch()) return scan_vectored({{data, size}}, stats);
+        auto stream = open_stream(stats);
+        stream->write(data, size);
+        stream->close();
+        return;
+    }
+    // ASSERT: this method must not be called concurrently on the same instance (scratch is not thread-safe).
+    stats.bind(m_db->names);
+    m_db->anchored.scan(data, size, stats);
+    if (!scratch) return;
+    m_deadline.start();
+    // A group's children database runs from the first magic; magics seen feed the child as heads.
+    struct Context {
+        HsLeftmost count;
+        std::vector<std::vector<std::pair<uint64_t, uint64_t>>> magics; // by tree group: every [from, to), by end
+        std::vector<size_t> fed;    // by child id: magics of its group given to `count`
+        const SignatureTree& tree;
+        unsigned int n;
+        uint64_t base = 0;          // children scans: offset of the data they were given
+        const ScanDeadline& deadline;
+        unsigned int matches = 0;
+    } ctx{HsLeftmost(static_cast<unsigned int>(m_db->patterns.size()), m_db->piece_base, m_db->piece_owner,
+                     m_db->deduction, m_db->names->size()),
+          std::vector<std::vector<std::pair<uint64_t, uint64_t>>>(m_db->tree.groups.size()),
+          std::vector<size_t>(m_db->patterns.size(), 0), m_db->tree, static_cast<unsigned int>(m_db->patterns.size()),
+          0, m_deadline};
+    auto on_match = [](unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) -> int {
+        auto* c = static_cast<Context*>(ptr);
+        if (!c->count.add(id, from, to)) c->magics[id - c->n].emplace_back(from, to);
+        return out_of_time(c->deadline, c->matches);
+    };
+    auto on_child = [](unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) -> int {
+        auto* c = static_cast<Context*>(ptr);
+        const auto& magics = c->magics[static_cast<size_t>(c->tree.group_of[id])];
+        size_t& fed = c->fed[id];
+        for (; fed < magics.size() && magics[fed].second <= c->base + to; ++fed)
+            c->count.head(id, magics[fed].first, magics[fed].second);
+        c->count.tail(id, c->base + from, c->base + to);
+        return out_of_time(c->deadline, c->matches);
+    };
+    if (hs_scan(m_db->block, data, size, 0, scratch, on_match, &ctx) == HS_SCAN_TERMINATED) m_deadline.check();
+    for (size_t g = 0; g < ctx.magics.size(); ++g) {
+        if (ctx.magics[g].empty()) continue;
+        ctx.base = ctx.magics[g].front().second;
+        if (ctx.base < size && hs_scan(m_db->children[g], data + ctx.base, static_cast<unsigned int>(size - ctx.base),
+                                       0, scratch, on_child, &ctx) == HS_SCAN_TERMINATED) m_deadline.check();
+    }
+    m_callbacks += ctx.matches;
+    m_scanned_bytes += size;
+    ctx.count.flush(m_db->names, size, stats);
+}
+
+// The database is shared; only the scratch space is per-thread. hs_clone_scratch copies
+// an already-sized scratch without re-deriving its layout from the database.
+std::unique_ptr<Scanner> HsScanner::fork() const {
+    auto copy = std::make_unique<HsScanner>();
+    copy->m_cache_dir = m_cache_dir;
+    copy->m_deadline = m_deadline;
+    if (!m_db) return copy;
+    if (scratch && hs_clone_scratch(scratch, &copy->scratch) != HS_SUCCESS) {
+        copy->scratch = nullptr;
+        return copy;
+    }
+    copy->m_db = m_db;
+    copy->m_stream_scratch = m_stream_scratch;
+    copy->m_classify_scratch = m_classify_scratch;
+    copy->m_vectored_scratch = m_vectored_scratch;
+    return copy;
+}
+
+bool HsScanner::ensure_stream_scratch() {
+    if (!m_db || !scratch) return false;
+    hs_database* sdb = m_db->stream_db();
+    if (!sdb) return false;
+    // Grows this instance's scratch so it serves both the block and the stream database.
+    if (!m_stream_scratch) {
+        if (hs_alloc_scratch(sdb, &scratch) != HS_SUCCESS) return false;
+        m_stream_scratch = true;
+    }
+    return true;
+}
+
+bool HsScanner::ensure_classify_scratch() {
+    if (!m_db || !scratch) return false;
+    hs_database* cdb = m_db->classify_db();
+    if (!cdb) return false;
+    if (!m_classify_scratch) {
+        if (hs_alloc_scratch(cdb, &scratch) != HS_SUCCESS) return false;
+        m_classify_scratch = true;
+    }
+    return true;
+}
+
+bool HsScanner::ensure_vectored_scratch() {
+    if (!m_db || !scratch) return false;
+    hs_database* vdb = m_db->vectored_db();
+    if (!vdb) return false;
+    if (!m_vectored_scratch) {
+        if (hs_alloc_scratch(vdb, &scratch) != HS_SUCCESS) return false;
+        m_vectored_scratch = true;
+    }
+    return true;
+}
+
+// Offsets run on across the pieces, so the counts are those of scan() over the joined
+// data, with deduct_from resolved by count as in a stream.
+void HsScanner::scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats) {
+    if (!m_db) return;
+    if (!ensure_vectored_scratch()) return Scanner::scan_vectored(spans, stats);
+    stats.bind(m_db->names);
+    std::vector<const char*> pieces;
+    std::vector<unsigned int> lengths;
+    size_t size = 0;
+    for (const auto& span : spans) {
+        // hs_scan_vector takes 32-bit lengths
+        for (size_t off = 0; off < span.size; off += UINT_MAX) {
+            pieces.push_back(span.data + off);
+            lengths.push_back(static_cast<unsigned int>(std::min<size_t>(span.size - off, UINT_MAX)));
+        }
+        size += span.size;
+    }
+    struct Context {
+        HsLeftmost count;
+        const ScanDeadline& deadline;
+        unsigned int matches = 0;
+    } ctx{HsLeftmost(static_cast<unsigned int>(m_db->patterns.size()), m_db->piece_base, m_db->piece_owner,
+                     m_db->deduction, m_db->names->size()),
+          m_deadline};
+    auto on_match = [](unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) -> int {
+        auto* c = static_cast<Context*>(ptr);
+        c->count.add(id, from, to);
+        return out_of_time(c->deadline, c->matches);
+    };
+    m_deadline.start();
+    if (hs_scan_vector(m_db->vectored, pieces.data(), lengths.data(), static_cast<unsigned int>(pieces.size()), 0,
+                       scratch, on_match, &ctx) == HS_SCAN_TERMINATED) m_deadline.check();
+    m_callbacks += ctx.matches;
+    m_scanned_bytes += size;
+    ctx.count.flush(m_db->names, size, stats);
+    check_anchors(m_db->anchored, spans, stats);
+}
+
+// One block scan of the classify database, ended by the callback as soon as FirstMatch
+// decides. Anchor matches are merged in by end offset as the scan passes them.
+void HsScanner::classify(const char* data, size_t size, ScanStats& stats) {
+    if (!m_db) return;
+    stats.bind(m_db->names);
+    struct Context {
+        FirstMatch first;
+        MatchEnds anchors; // sorted by end
+        size_t next = 0;
+        // Feeds the anchors ending at or before `to`; true once decided.
+        bool flush(size_t to) {
+            while (next < anchors.size() && anchors[next].first <= to)
+                if (first.add(anchors[next++].second)) return true;
+            return first.decided();
+        }
+        const ScanDeadline& deadline;
+        unsigned int matches = 0;
+        // Vectored scan: whole patterns and the pieces of split ones, as in scan_vectored().
+        LeftmostCount count;
+        unsigned int n, piece_base;
+        const std::vector<uint32_t>& owners;
+    } ctx{FirstMatch(m_db->deduction), {}, 0, m_deadline, 0, {},
+          static_cast<unsigned int>(m_db->patterns.size()), m_db->piece_base, m_db->piece_owner};
+    m_db->anchored.matches(data, size, ctx.anchors);
+    std::sort(ctx.anchors.begin(), ctx.anchors.end());
+    if (size > UINT_MAX) {
+        // hs_scan takes a 32-bit length: the vectored database runs over the input in
+        // pieces instead, and a pattern's first counted match is its first match.
+        if (ensure_vectored_scratch()) {
+            std::vector<const char*> pieces;
+            std::vector<unsigned int> lengths;
+            for (size_t off = 0; off < size; off += UINT_MAX) {
+                pieces.push_back(data + off);
+                lengths.push_back(static_cast<unsigned int>(std::min<size_t>(size - off, UINT_MAX)));
+            }
+            ctx.count.reset(ctx.n);
+            m_deadline.start();
+            auto on_match = [](unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) -> int {
+                auto* c = static_cast<Context*>(ptr);
+                if (c->flush(static_cast<size_t>(to))) return 1;
+                bool counts;
+                if (id < c->n) {
+                    counts = c->count.match(id, from, to);
+                }
+                else {
+                    const uint32_t owner = c->owners[(id - c->piece_base) / 2];
+                    if ((id - c->piece_base) % 2 == 0) c->count.head(owner, from, to);
+                    counts = (id - c->piece_base) % 2 == 1 && c->count.tail(owner, from, to);
+                    id = owner;
+                }
+                if (counts && c->first.add(id)) return 1;
+                return out_of_time(c->deadline, c->matches);
+            };
+            if (hs_scan_vector(m_db->vectored, pieces.data(), lengths.data(), static_cast<unsigned int>(pieces.size()),
+                               0, scratch, on_match, &ctx) == HS_SCAN_TERMINATED
+                && !ctx.first.decided()) m_deadline.check();
+        }
+    }
+    else if (ensure_classify_scratch()) {
+        m_deadline.start();
+        auto on_match = [](unsigned int id, unsigned long long, unsigned long long to, unsigned int, void* ptr) -> int {
+            auto* c = static_cast<Context*>(ptr);
+            if (c->flush(static_cast<size_t>(to))) return 1;
+            if (c->first.add(id)) return 1; // non-zero stops the scan
+            return out_of_time(c->deadline, c->matches);
+        };
+        if (hs_scan(m_db->classify, data, size, 0, scratch, on_match, &ctx) == HS_SCAN_TERMINATED
+            && !ctx.first.decided()) m_deadline.check();
+    }
+    ctx.flush(SIZE_MAX);
+    if (ctx.first.result() >= 0) stats.hit(static_cast<uint32_t>(ctx.first.result()));
+}
+
+// Serialized databases are keyed by signatures, flags, mode and Hyperscan version;
+// a blob that fails to deserialize is recompiled.
+hs_database* HsScanner::Database::load_or_compile(const std::vector<std::string>& exprs,
+                                                  const std::vector<unsigned int>& expr_flags,
+                                                  const std::vector<unsigned int>& ids,
+                                                  const std::vector<hs_expr_ext>& expr_exts, unsigned int mode) const {
+    fs::path cache_file;
+    if (!cache_dir.empty()) {
+        uint64_t key = fnv1a(sig_hash, &mode, sizeof(mode));
+        key = fnv1a(key, expr_flags.data(), expr_flags.size() * sizeof(unsigned int));
+        key = fnv1a(key, ids.data(), ids.size() * sizeof(unsigned int));
+        for (const auto& x : expr_exts) {
+            const unsigned long long fields[] = {x.flags, x.max_offset, x.min_length};
+            key = fnv1a(key, fields, sizeof(fields));
+        }
+        for (const auto& e : exprs) key = fnv1a(key, e);
+        key = fnv1a(key, std::string(hs_version()));
+        std::ostringstream name;
+        name << "hs_" << std::hex << std::setw(16) << std::setfill('0') << key << ".db";
+        cache_file = fs::path(cache_dir) / name.str();
+
+        std::ifstream in(cache_file, std::ios::binary);
+        if (in) {
+            std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            hs_database* cached = nullptr;
+            if (hs_deserialize_database(bytes.data(), bytes.size(), &cached) == HS_SUCCESS) return cached;
+        }
+    }
+
+    std::vector<const char*> cexprs;
+    for (const auto& e : exprs) cexprs.push_back(e.c_str());
+    std::vector<const hs_expr_ext*> cexts;
+    for (const auto& x : expr_exts) cexts.push_back(x.flags ? &x : nullptr);
+    hs_database* compiled = nullptr;
+    hs_compile_error_t* err;
+    if (hs_compile_ext_multi(cexprs.data(), expr_flags.data(), ids.data(), cexts.empty() ? nullptr : cexts.data(),
+                             static_cast<unsigned int>(cexprs.size()), mode, nullptr, &compiled, &err) != HS_SUCCESS) {
+        std::cerr << "[Scanner] HS Compile Error: " << err->message << std::endl;
+        hs_free_compile_error(err);
+        return nullptr;
+    }
+
+    if (!cache_file.empty()) {
+        char* bytes = nullptr;
+        size_t length = 0;
+        if (hs_serialize_database(compiled, &bytes, &length) == HS_SUCCESS) {
+            std::error_code ec;
+            fs::create_directories(cache_file.parent_path(), ec);
+            const fs::path tmp = temp_path_for(cache_file);
+            {
+                std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                out.write(bytes, static_cast<std::streamsize>(length));
+            }
+            fs::rename(tmp, cache_file, ec);
+            if (ec) fs::remove(tmp, ec);
+            free(bytes);
+        }
+    }
+    return compiled;
+}
+
+namespace {
+    // Native HS_MODE_STREAM: no history buffer, no span limit.
+    class HsStream : public ScanStream {
+    public:
+        // The time budget runs from open_stream() to close(), across every write().
+        HsStream(std::shared_ptr<const void> owner, hs_database* db, hs_scratch* scratch,
+                 std::shared_ptr<const SignatureNames> names, HsLeftmost count, ScanDeadline deadline,
+                 ScanStats& stats)
+            : m_owner(std::move(owner)), m_scratch(scratch), m_names(std::move(names)),
+              m_count(std::move(count)), m_deadline(deadline), m_stats(stats) {
+            if (hs_open_stream(db, 0, &m_stream) != HS_SUCCESS) m_stream = nullptr;
+            m_deadline.start();
+        }
+        ~HsStream() override { close(); }
+
+        void write(const char* data, size_t size) override {
+            if (!m_stream) return;
+            m_stats.bind(m_names);
+            // hs_scan_stream takes a 32-bit length
+            while (size > 0) {
+                auto n = static_cast<unsigned int>(std::min<size_t>(size, UINT_MAX));
+                if (hs_scan_stream(m_stream, data, n, 0, m_scratch, on_match, this) == HS_SCAN_TERMINATED) {
+                    hs_close_stream(m_stream, m_scratch, nullptr, nullptr);
+                    m_stream = nullptr;
+                    m_deadline.check();
+                }
+                data += n;
+                size -= n;
+                m_size += n;
+            }
+        }
+
+        void close() override {
+            if (!m_stream) return;
+            m_stats.bind(m_names);
+            hs_close_stream(m_stream, m_scratch, on_match, this);
+            m_stream = nullptr;
+            m_count.flush(m_names, m_size, m_stats);
+        }
+
+    private:
+        static int on_match(unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) {
+            auto* self = static_cast<HsStream*>(ptr);
+            self->m_count.add(id, from, to);
+            return out_of_time(self->m_deadline, self->m_matches);
+        }
+
+        std::shared_ptr<const void> m_owner;
+        hs_stream_t* m_stream = nullptr;
+        hs_scratch* m_scratch;
+        std::shared_ptr<const SignatureNames> m_names;
+        HsLeftmost m_count; // stream offsets
+        uint64_t m_size = 0; // bytes written
+        ScanDeadline m_deadline;
+        unsigned int m_matches = 0;
+        ScanStats& m_stats;
+    };
+}
+
+std::unique_ptr<ScanStream> HsScanner::open_stream(ScanStats& stats) {
+    if (!m_db) return std::make_unique<NullStream>();
+    std::unique_ptr<ScanStream> inner;
+    if (ensure_stream_scratch())
+        inner = std::make_unique<HsStream>(m_db, m_db->stream, scratch, m_db->names,
+                                           HsLeftmost(static_cast<unsigned int>(m_db->patterns.size()), m_db->piece_base,
+                                                      m_db->piece_owner, m_db->deduction, m_db->names->size()),
+                                           m_deadline, stats);
+    else inner = std::make_unique<NullStream>();
+    return with_anchors(std::move(inner), m_db, m_db->anchored, m_db->names, stats);
+}
+
+namespace {
+    // Matches ending in (lo, hi] of one segment's window, absolute offsets.
+    struct HsSegmentHits {
+        struct Match {
+            unsigned int id;
+            uint64_t from, to;
+        };
+        size_t base = 0, lo = 0, hi = 0;          // base: absolute offset of the window start
+        std::vector<Match> matches;               // in order of end
+        const ScanDeadline* deadline = nullptr;
+        unsigned int seen = 0;
+
+        static int on_match(unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) {
+            auto* self = static_cast<HsSegmentHits*>(ptr);
+            const uint64_t end = self->base + to;
+            if (end > self->lo && end <= self->hi) self->matches.push_back({id, self->base + from, end});
+            return out_of_time(*self->deadline, self->seen);
+        }
+    };
+
+    // The stream over the whole buffer that scan_parallel() runs alongside the segments.
+    struct HsResidue {
+        HsLeftmost& count;
+        const ScanDeadline& deadline;
+        unsigned int matches = 0;
+
+        static int on_match(unsigned int id, unsigned long long from, unsigned long long to, unsigned int, void* ptr) {
+            auto* self = static_cast<HsResidue*>(ptr);
+            self->count.add(id, from, to);
+            return out_of_time(self->deadline, self->matches);
+        }
+    };
+}
+
+// Segments keep the matches ending in their range, replayed in order; the rest run as one stream.
+void HsScanner::scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                              size_t segment_bytes) {
+    if (!m_db) return;
+    if (!scratch) return scan(data, size, stats);
+    const auto db = m_db;
+    auto starts = plan_segments(size, threads, db->overlap, segment_bytes);
+    if (threads < 2 || starts.size() <= 2) {
+        if (size <= UINT_MAX) return scan(data, size, stats);
+        auto stream = open_stream(stats);
+        stream->write(data, size);
+        stream->close();
+        return;
+    }
+
+    db->build_split();
+    const auto n = static_cast<unsigned int>(db->patterns.size());
+    const size_t segments = starts.size() - 1;
+    const size_t jobs = segments + (db->residue ? 1 : 0);
+    const unsigned workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, jobs)));
+
+    // One scratch per worker, each sized for both split databases.
+    std::vector<hs_scratch*> scratches(workers, nullptr);
+    bool ok = hs_clone_scratch(scratch, &scratches[0]) == HS_SUCCESS;
+    if (ok && db->segment) ok = hs_alloc_scratch(db->segment, &scratches[0]) == HS_SUCCESS;
+    if (ok && db->residue) ok = hs_alloc_scratch(db->residue, &scratches[0]) == HS_SUCCESS;
+    for (unsigned w = 1; ok && w < workers; ++w) ok = hs_clone_scratch(scratches[0], &scratches[w]) == HS_SUCCESS;
+    if (!ok) {
+        std::cerr << "[Scanner] HS scratch allocation failed, scanning sequentially\n";
+        for (auto* s : scratches) if (s) hs_free_scratch(s);
+        auto stream = open_stream(stats);
+        stream->write(data, size);
+        stream->close();
+        return;
+    }
+
+    std::vector<HsSegmentHits> hits(segments);
+    HsLeftmost residue(n, db->piece_base, db->piece_owner, db->deduction, db->names->size());
+    m_deadline.start();
+    try {
+        run_jobs(jobs, workers, [&](size_t job, unsigned w) {
+            if (job == segments) {
+                hs_stream_t* stream = nullptr;
+                if (hs_open_stream(db->residue, 0, &stream) != HS_SUCCESS) return;
+                HsResidue ctx{residue, m_deadline};
+                for (size_t off = 0; off < size;) {
+                    auto len = static_cast<unsigned int>(std::min<size_t>(size - off, UINT_MAX));
+                    if (hs_scan_stream(stream, data + off, len, 0, scratches[w], HsResidue::on_match, &ctx)
+                        == HS_SCAN_TERMINATED) {
+                        hs_close_stream(stream, scratches[w], nullptr, nullptr);
+                        m_deadline.check();
+                        return;
+                    }
+                    off += len;
+                }
+                hs_close_stream(stream, scratches[w], HsResidue::on_match, &ctx);
+                return;
+            }
+            HsSegmentHits& seg = hits[job];
+            seg.lo = starts[job];
+            seg.hi = starts[job + 1];
+            seg.base = seg.lo > db->overlap ? seg.lo - db->overlap : 0;
+            seg.deadline = &m_deadline;
+            if (!db->segment) return;
+            // One byte past the segment so that end-of-data assertions do not fire at `hi`.
+            const size_t end = std::min(size, seg.hi + 1);
+            if (hs_scan(db->segment, data + seg.base, static_cast<unsigned int>(end - seg.base), 0, scratches[w],
+                        HsSegmentHits::on_match, &seg) == HS_SCAN_TERMINATED) m_deadline.check();
+        });
+    }
+    catch (...) {
+        for (auto* s : scratches) hs_free_scratch(s);
+        throw;
+    }
+    for (auto* s : scratches) hs_free_scratch(s);
+
+    HsLeftmost count(n, db->piece_base, db->piece_owner, db->deduction, db->names->size());
+    for (const auto& seg : hits)
+        for (const auto& m : seg.matches) count.add(m.id, m.from, m.to);
+    count.merge(residue);
+    count.flush(db->names, size, stats);
+    db->anchored.scan(data, size, stats);
+}
+
+// === Hybrid (literal pass + regex engine) ===
+// Regex names first, then literal ones: the literal half maps by an offset.
+struct HybridScanner::Split {
+    std::shared_ptr<const SignatureNames> names;
+    uint32_t literal_base = 0;
+    std::vector<SignatureDefinition> sigs; // the whole set, for classify()
+    std::once_flag whole_once;
+    std::unique_ptr<Scanner> whole;        // prepared by the first classify(), then only forked
+    std::vector<uint32_t> whole_ids;       // by id of `whole`: merged id, UINT32_MAX = none
+
+    // Adds the counts of both halves (regex, literals) to `stats` and clears them.
+    void merge(ScanStats (&parts)[2], ScanStats& stats) const {
+        stats.bind(names);
+        for (uint32_t half = 0; half < 2; ++half) {
+            ScanStats& part = parts[half];
+            const uint32_t base = half ? literal_base : 0;
+            for (size_t id = 0; id < part.hits.size(); ++id)
+                if (part.hits[id] != 0) stats.hit(base + static_cast<uint32_t>(id), part.hits[id]);
+            for (const auto& [name, n] : part.counts) stats.counts[name] += n;
+            part.reset();
+        }
+    }
+};
+
+bool HybridScanner::literal_only(const SignatureDefinition& def, const std::set<std::string>& parents) {
+    if (!def.deduct_from.empty() || parents.count(def.name)) return false;
+    return def.anchored() || (!def.windowed() && lead_of(def).kind == LeadingLiterals::Kind::LITERAL);
+}
+
+std::string HybridScanner::name() const { return "Literals + " + Scanner::create(m_engine)->name(); }
+std::shared_ptr<const SignatureNames> HybridScanner::signature_names() const {
+    return m_split ? m_split->names : nullptr;
+}
+
+void HybridScanner::prepare(const std::vector<SignatureDefinition>& sigs) {
+    m_split.reset();
+    m_regex.reset();
+    m_literals.reset();
+    m_whole.reset();
+
+    std::set<std::string> parents;
+    for (const auto& s : sigs)
+        if (!s.deduct_from.empty()) parents.insert(s.deduct_from);
+    std::vector<SignatureDefinition> halves[2];
+    for (const auto& s : sigs) halves[literal_only(s, parents) ? 1 : 0].push_back(s);
+
+    auto split = std::make_shared<Split>();
+    auto names = std::make_shared<SignatureNames>();
+    std::unique_ptr<Scanner> engines[2];
+    for (int half = 0; half < 2; ++half) {
+        if (half) split->literal_base = static_cast<uint32_t>(names->size());
+        if (halves[half].empty()) continue;
+        engines[half] = half ? std::make_unique<LiteralScanner>() : Scanner::create(m_engine);
+        engines[half]->set_cache_dir(m_cache_dir);
+        engines[half]->set_time_budget(m_budget);
+        engines[half]->prepare(halves[half]);
+        auto part = engines[half]->signature_names();
+        if (!part) return; // the engine has reported why
+        names->insert(names->end(), part->begin(), part->end());
+    }
+    split->names = std::move(names);
+    split->sigs = sigs;
+    m_regex = std::move(engines[0]);
+    m_literals = std::move(engines[1]);
+    m_split = std::move(split);
+}
+
+void HybridScanner::set_time_budget(std::chrono::milliseconds budget) {
+    m_budget = budget;
+    if (m_regex) m_regex->set_time_budget(budget);
+    if (m_whole) m_whole->set_time_budget(budget);
+}
+
+void HybridScanner::scan(const char* data, size_t size, ScanStats& stats) {
+    if (!m_split) return;
+    try {
+        if (m_regex) m_regex->scan(data, size, m_parts[0]);
+    }
+    catch (const ScanBudgetExceeded&) {
+        m_parts[0].reset(); // the next scan must not merge this one's partial counts
+        throw;
+    }
+    if (m_literals) m_literals->scan(data, size, m_parts[1]);
+    m_split->merge(m_parts, stats);
+}
+
+void HybridScanner::scan_parallel(const char* data, size_t size, ScanStats& stats, unsigned threads,
+                                  size_t segment_bytes) {
+    if (!m_split) return;
+    try {
+        if (m_regex) m_regex->scan_parallel(data, size, m_parts[0], threads, segment_bytes);
+    }
+    catch (const ScanBudgetExceeded&) {
+        m_parts[0].reset();
+        throw;
+    }
+    if (m_literals) m_literals->scan_parallel(data, size, m_parts[1], threads, segment_bytes);
+    m_split->merge(m_parts, stats);
+}
+
+void HybridScanner::scan_vectored(const std::vector<ScanSpan>& spans, ScanStats& stats) {
+    if (!m_split) return;
+    try {
+        if (m_regex) m_regex->scan_vectored(spans, m_parts[0]);
+    }
+    catch (const ScanBudgetExceeded&) {
+        m_parts[0].reset();
+        throw;
+    }
+    if (m_literals) m_literals->scan_vectored(spans, m_parts[1]);
+    m_split->merge(m_parts, stats);
+}
+
+void HybridScanner::classify(const char* data, size_t size, ScanStats& stats) {
+    if (!m_split) return;
+    if (!m_whole) {
+        Split& split = *m_split;
+        std::call_once(split.whole_once, [&] {
+            auto whole = Scanner::create(m_engine);
+            whole->set_cache_dir(m_cache_dir);
+            whole->prepare(split.sigs);
+            if (auto names = whole->signature_names())
+                for (const auto& name : *names) {
+                    auto it = std::find(split.names->begin(), split.names->end(), name);
+                    split.whole_ids.push_back(it != split.names->end()
+                        ? static_cast<uint32_t>(it - split.names->begin()) : UINT32_MAX);
+                }
+            split.whole = std::move(whole);
+        });
+        m_whole = split.whole->fork();
+        m_whole->set_time_budget(m_budget);
+    }
+    ScanStats found;
+    m_whole->classify(data, size, found);
+    stats.bind(m_split->names);
+    for (size_t id = 0; id < found.hits.size(); ++id) {
+        if (found.hits[id] == 0) continue;
+        if (m_split->whole_ids[id] != UINT32_MAX) stats.hit(m_split->whole_ids[id], found.hits[id]);
+        else stats.counts[(*found.names)[id]] += found.hits[id];
+    }
+}
+
+std::unique_ptr<Scanner> HybridScanner::fork() const {
+    auto copy = std::make_unique<HybridScanner>(m_engine);
+    copy->m_cache_dir = m_cache_dir;
+    copy->m_budget = m_budget;
+    copy->m_split = m_split;
+    if (m_regex) copy->m_regex = m_regex->fork();
+    if (m_literals) copy->m_literals = m_literals->fork();
+    return copy;
+}
+
+namespace {
+    // One stream per half over the same chunks; the counts are merged on close().
+    class HybridStream : public ScanStream {
+    public:
+        HybridStream(std::shared_ptr<const HybridScanner::Split> split, Scanner* regex, Scanner* literals,
+                     ScanStats& stats)
+            : m_split(std::move(split)), m_stats(stats) {
+            if (regex) m_streams[0] = regex->open_stream(m_parts[0]);
+            if (literals) m_streams[1] = literals->open_stream(m_parts[1]);
+        }
+        ~HybridStream() override { close(); }
+
+        void write(const char* data, size_t size) override {
+            for (auto& stream : m_streams)
+                if (stream) stream->write(data, size);
+        }
+        void close() override {
+            if (m_closed) return;
+            m_closed = true;
+            for (auto& stream : m_streams)
+                if (stream) stream->close();
+            m_split->merge(m_parts, m_stats);
+        }
+
+    private:
+        std::shared_ptr<const HybridScanner::Split> m_split;
+        ScanStats& m_stats;
+        ScanStats m_parts[2]; // declared before the streams, which count into them
+        std::unique_ptr<ScanStream> m_streams[2];
+        bool m_closed = false;
+    };
+}
+
+std::unique_ptr<ScanStream> HybridScanner::open_stream(ScanStats& stats) {
+    if (!m_split) return std::make_unique<NullStream>();
+    return std::make_unique<HybridStream>(m_split, m_regex.get(), m_literals.get(), stats);
 }
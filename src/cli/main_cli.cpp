@@ -6,28 +6,87 @@
 #include <thread>
 #include <future>
 #include <atomic>
+#include <mutex>
 #include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include "Scanner.h"
 #include "ConfigLoader.h"
 #include "Logger.h"
 #include "ReportWriter.h"
+#include "WorkScheduler.h"
+#include "BoundedQueue.h"
+#include "DirWalker.h"
+#include "FileReader.h"
+#include "ResultCache.h"
+#include "ContentDedup.h"
+#include "KnownFileIndex.h"
+#include "EngineTuner.h"
 
 namespace fs = std::filesystem;
 
 static constexpr size_t DEFAULT_MAX_FILESIZE_MB = 512;
+static constexpr size_t STREAM_CHUNK_BYTES = 16 * 1024 * 1024;
+static constexpr size_t PIPELINE_DEPTH = 4096; // paths buffered between traversal and workers
+static constexpr unsigned DEFAULT_WALK_THREADS = 4;
+static constexpr size_t DEFAULT_SPLIT_MB = 256;
+static constexpr size_t AUTO_SAMPLE_BYTES = 4 * 1024 * 1024; // -e auto: sample timed per engine
+static constexpr unsigned DEFAULT_FILE_BUDGET_MS = 10000;
+static constexpr uint64_t CLASSIFY_READ_BYTES = 64 * 1024; // --classify: larger files are mapped, not read
+
+// Files above --max-filesize are not mapped whole: they are fed to the engine in
+// fixed-size chunks through a ScanStream, so memory stays bounded for multi-GB inputs.
+static void scan_streamed(Scanner& scanner, const fs::path& path, std::vector<char>& buf, ScanStats& stats) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open for reading");
+    if (buf.size() < STREAM_CHUNK_BYTES) buf.resize(STREAM_CHUNK_BYTES);
+
+    auto stream = scanner.open_stream(stats);
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        auto n = static_cast<size_t>(in.gcount());
+        if (n == 0) break;
+        stream->write(buf.data(), n);
+    }
+    stream->close();
+}
+
+// --classify: the type recorded for one file (its single count), "unknown" when none.
+static std::string classified_type(const ScanStats& stats) {
+    for (const auto& [name, count] : stats.totals())
+        if (count > 0) return name;
+    return "unknown";
+}
 
 void print_ui_help() {
     std::cout << "\n"
         << "==================================================================\n"
         << "              DEV SCANNER TOOL\n"
         << "==================================================================\n\n"
-        << "  DevScanApp.exe <path> [options]\n\n"
+        << "  DevScanApp.exe <path> [options]\n"
+        << "  DevScanApp.exe build-allowlist <dir> <index> [-j N]\n\n"
         << "OPTIONS:\n"
         << "  -c, --config <file>        Signatures file (default: signatures.json)\n"
-        << "  -e, --engine <type>        Engine: hs (Hyperscan), re2, boost\n"
+        << "  -e, --engine <type>        Engine: hs (Hyperscan), re2, boost, literal, hybrid,\n"
+        << "                             auto (fastest on a sample, remembered per signature set)\n"
         << "  -j, --threads <N>          Thread count (default: CPU cores)\n"
-        << "  -m, --max-filesize <MB>    Max file size in MB (default: 512)\n"
+        << "  -m, --max-filesize <MB>    Larger files are streamed in chunks (default: 512)\n"
+        << "  --split <MB>               Scan files this large with all threads (default: 256, 0 = off)\n"
+        << "  --largest-first            Dispatch files by size, biggest first\n"
+        << "  --file-budget <ms>         Per-file scan time; a file over it is rescanned with RE2\n"
+        << "                             (default: 10000, 0 = off)\n"
+        << "  --io <backend>             File reads: pread (default), mmap, uring\n"
+        << "  --walk-threads <N>         Directory traversal threads (default: 4)\n"
+        << "  --walk-only                Only traverse and report files/sec (no scan)\n"
+        << "  --db-cache <dir>           Compiled database cache (default: <tmp>/devscan_cache)\n"
+        << "  --no-db-cache              Always compile signatures from scratch\n"
+        << "  --incremental              Reuse results of files unchanged since the last scan\n"
+        << "  --result-cache <dir>       Per-file result cache (default: <tmp>/devscan_cache)\n"
+        << "  --dedup                    Scan identical files once (content hash)\n"
+        << "  --allowlist <index>        Skip files whose size and SHA-256 are in a known-file index\n"
+        << "  --classify                 Print one type per file (path<TAB>type), first match wins\n"
         << "  --output-json <path>       Export JSON report to path\n"
         << "  --output-txt <path>        Export TXT report to path\n"
         << "  --no-report                Skip report generation\n"
@@ -55,17 +114,58 @@ int main(int argc, char* argv[]) {
             std::cout << "DevScan 1.0.0\n";
             return 0;
         }
+        // Hashes a trusted tree into an index for --allowlist.
+        if (first == "build-allowlist") {
+            if (argc < 4) {
+                print_ui_help();
+                return 1;
+            }
+            unsigned int threads = std::thread::hardware_concurrency();
+            if (threads == 0) threads = 4;
+            for (int i = 4; i + 1 < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "-j" || arg == "--threads") threads = static_cast<unsigned int>(std::stoi(argv[++i]));
+            }
+            auto b_start = std::chrono::high_resolution_clock::now();
+            try {
+                size_t n = KnownFileIndex::build(argv[2], argv[3], threads);
+                double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - b_start).count();
+                std::cout << "Allowlist: " << n << " contents -> " << argv[3]
+                          << "  (" << std::fixed << std::setprecision(2) << secs << "s)\n";
+                Logger::info("Allowlist built: " + std::string(argv[3]) + " (" + std::to_string(n) + " contents)");
+            }
+            catch (const std::exception& e) {
+                Logger::error(std::string("Allowlist build failed: ") + e.what());
+                std::cerr << "[Error] " << e.what() << "\n";
+                return 1;
+            }
+            return 0;
+        }
     }
 
     std::string target_path = argv[1];
     std::string config_path = "signatures.json";
     EngineType engine_choice = EngineType::HYPERSCAN;
+    bool auto_engine = false;
     unsigned int num_threads = std::thread::hardware_concurrency();
     if (num_threads == 0) num_threads = 4;
     size_t max_filesize = DEFAULT_MAX_FILESIZE_MB * 1024 * 1024;
+    size_t split_size = DEFAULT_SPLIT_MB * 1024 * 1024;
     std::string output_json;
     std::string output_txt;
     bool no_report = false;
+    std::string cache_dir;
+    bool no_db_cache = false;
+    bool largest_first = false;
+    unsigned int walk_threads = DEFAULT_WALK_THREADS;
+    bool walk_only = false;
+    IoBackend io_backend = IoBackend::PREAD;
+    bool incremental = false;
+    std::string result_cache_dir;
+    bool dedup = false;
+    std::string allowlist_path;
+    bool classify = false;
+    unsigned int file_budget_ms = DEFAULT_FILE_BUDGET_MS;
 
     for (int i = 2; i < argc; ++i) {
         std::string arg = argv[i];
@@ -74,8 +174,8 @@ int main(int argc, char* argv[]) {
         }
         else if ((arg == "-e" || arg == "--engine") && i + 1 < argc) {
             std::string e = argv[++i];
-            if (e == "re2") engine_choice = EngineType::RE2;
-            else if (e == "boost") engine_choice = EngineType::BOOST;
+            if (e == "auto") auto_engine = true;
+            else if (EngineTuner::from_key(e, engine_choice)) auto_engine = false;
         }
         else if ((arg == "-j" || arg == "--threads") && i + 1 < argc) {
             num_threads = static_cast<unsigned int>(std::stoi(argv[++i]));
@@ -84,6 +184,9 @@ int main(int argc, char* argv[]) {
         else if ((arg == "-m" || arg == "--max-filesize") && i + 1 < argc) {
             max_filesize = std::stoull(argv[++i]) * 1024 * 1024;
         }
+        else if (arg == "--split" && i + 1 < argc) {
+            split_size = std::stoull(argv[++i]) * 1024 * 1024;
+        }
         else if (arg == "--output-json" && i + 1 < argc) {
             output_json = argv[++i];
         }
@@ -93,6 +196,63 @@ int main(int argc, char* argv[]) {
         else if (arg == "--no-report") {
             no_report = true;
         }
+        else if (arg == "--db-cache" && i + 1 < argc) {
+            cache_dir = argv[++i];
+        }
+        else if (arg == "--no-db-cache") {
+            no_db_cache = true;
+        }
+        else if (arg == "--largest-first") {
+            largest_first = true;
+        }
+        else if (arg == "--file-budget" && i + 1 < argc) {
+            file_budget_ms = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--walk-threads" && i + 1 < argc) {
+            walk_threads = static_cast<unsigned int>(std::stoi(argv[++i]));
+            if (walk_threads == 0) walk_threads = 1;
+        }
+        else if (arg == "--io" && i + 1 < argc) {
+            std::string b = argv[++i];
+            if (b == "mmap") io_backend = IoBackend::MMAP;
+            else if (b == "uring") io_backend = IoBackend::URING;
+            else if (b == "pread") io_backend = IoBackend::PREAD;
+        }
+        else if (arg == "--incremental") {
+            incremental = true;
+        }
+        else if (arg == "--result-cache" && i + 1 < argc) {
+            result_cache_dir = argv[++i];
+            incremental = true;
+        }
+        else if (arg == "--dedup") {
+            dedup = true;
+        }
+        else if (arg == "--allowlist" && i + 1 < argc) {
+            allowlist_path = argv[++i];
+        }
+        else if (arg == "--classify") {
+            classify = true;
+        }
+        else if (arg == "--walk-only") {
+            walk_only = true;
+        }
+    }
+
+    // Traversal benchmark: measures the walker alone, no signatures compiled or files read.
+    if (walk_only) {
+        std::atomic<uint64_t> bytes{0};
+        auto w_start = std::chrono::high_resolution_clock::now();
+        size_t n = DirWalker::walk(target_path, walk_threads, [&](FileEntry&& file) {
+            bytes.fetch_add(file.size, std::memory_order_relaxed);
+        });
+        double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - w_start).count();
+        std::cout << "Files: " << n << "  (" << bytes.load() / 1024 / 1024 << " MB)\n"
+                  << "Walk threads: " << walk_threads << "\n"
+                  << "Time: " << std::fixed << std::setprecision(3) << secs << "s  ("
+                  << std::setprecision(0) << (secs > 0 ? n / secs : 0.0) << " files/sec)\n";
+        Logger::info("Walk-only: " + std::to_string(n) + " files, " + std::to_string(secs) + "s");
+        return 0;
     }
 
     Logger::info("Loading config: " + config_path);
@@ -103,99 +263,420 @@ int main(int argc, char* argv[]) {
     }
     Logger::info("Signatures loaded: " + std::to_string(sigs.size()));
 
-    // Collect file paths
-    std::vector<fs::path> file_paths;
-    try {
-        if (fs::is_directory(target_path)) {
-            auto opts = fs::directory_options::skip_permission_denied;
-            for (auto const& entry : fs::recursive_directory_iterator(target_path, opts)) {
-                if (entry.is_regular_file() && !entry.is_symlink())
-                    file_paths.push_back(entry.path());
+    if (no_db_cache) {
+        cache_dir.clear();
+    }
+    else if (cache_dir.empty()) {
+        std::error_code ec;
+        auto tmp = fs::temp_directory_path(ec);
+        if (!ec) cache_dir = (tmp / "devscan_cache").string();
+    }
+
+    // --allowlist: files read whole whose content hash is a known-good one are not scanned.
+    // They are not stored in the result cache either, since the index may change.
+    std::unique_ptr<KnownFileIndex> allowlist;
+    if (!allowlist_path.empty()) {
+        allowlist = KnownFileIndex::open(allowlist_path);
+        if (!allowlist) {
+            Logger::error("Failed to open allowlist " + allowlist_path);
+            return 1;
+        }
+        Logger::info("Allowlist: " + allowlist_path + " (" + std::to_string(allowlist->size()) + " contents)");
+    }
+    std::atomic<size_t> known_files{0};
+
+    std::error_code dir_ec;
+    const bool is_dir = fs::is_directory(target_path, dir_ec);
+
+    // Progress tracking. `discovered` keeps growing until traversal is done.
+    std::atomic<size_t> processed{0};
+    std::atomic<size_t> discovered{0};
+    std::atomic<bool> traversal_done{false};
+    std::atomic<uint64_t> discovered_bytes{0};
+
+    std::vector<std::future<ScanStats>> futures;
+    std::thread producer;
+    BoundedQueue<FileEntry> pipeline(PIPELINE_DEPTH);
+    // Traversal runs on its own thread and feeds a bounded queue that the workers drain
+    // concurrently: the first file is scanned while the tree is still being listed, and
+    // at most PIPELINE_DEPTH paths are held in memory however large the tree is.
+    auto start_traversal = [&] {
+        producer = std::thread([&] {
+            DirWalker::walk(target_path, walk_threads, [&](FileEntry&& file) {
+                discovered_bytes.fetch_add(file.size, std::memory_order_relaxed);
+                pipeline.push(std::move(file));
+                discovered++;
+            });
+            traversal_done = true;
+            pipeline.close();
+        });
+    };
+
+    // Collected up front only for --largest-first, which needs every size before dispatch.
+    std::vector<FileEntry> files;
+    auto collect_files = [&] {
+        std::mutex files_mutex;
+        DirWalker::walk(target_path, walk_threads, [&](FileEntry&& file) {
+            std::lock_guard<std::mutex> lock(files_mutex);
+            discovered_bytes += file.size;
+            files.push_back(std::move(file));
+        });
+        discovered = files.size();
+        traversal_done = true;
+    };
+    // -e auto, streaming traversal: the files taken from the queue for the sample, scanned first.
+    std::vector<FileEntry> sampled;
+    std::atomic<size_t> sampled_next{0};
+
+    // -e auto: every candidate engine is prepared and timed on the first few MB of the
+    // target (EngineTuner); the winner's prepared scanner becomes the run's. A choice
+    // made before for this signature set is reused without trials.
+    std::unique_ptr<Scanner> base_scanner;
+    if (auto_engine && EngineTuner::load(cache_dir, signature_set_hash(sigs), classify, engine_choice)) {
+        Logger::info("Engine (auto): " + EngineTuner::key(engine_choice) + ", chosen before for this signature set");
+    }
+    else if (auto_engine) {
+        if (largest_first) {
+            collect_files();
+        }
+        else {
+            start_traversal();
+            uint64_t bytes = 0;
+            FileEntry file;
+            while (bytes < AUTO_SAMPLE_BYTES && pipeline.pop(file)) {
+                bytes += file.size;
+                sampled.push_back(std::move(file));
             }
         }
-        else if (fs::exists(target_path)) {
-            file_paths.push_back(target_path);
+        const std::vector<FileEntry>& source = largest_first ? files : sampled;
+        std::vector<std::string> sample;
+        uint64_t sample_bytes = 0;
+        for (size_t i = 0; i < source.size() && sample_bytes < AUTO_SAMPLE_BYTES; ++i) {
+            std::ifstream in(source[i].path, std::ios::binary);
+            std::string buf(static_cast<size_t>(std::min<uint64_t>(source[i].size, AUTO_SAMPLE_BYTES - sample_bytes)), '\0');
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            buf.resize(static_cast<size_t>(in.gcount()));
+            sample_bytes += buf.size();
+            if (!buf.empty()) sample.push_back(std::move(buf));
+        }
+        // Bytes the run will read, as far as traversal has got: the sample's share of it
+        // weighs scan time against compile time. Streaming traversal stops at a full queue
+        // (PIPELINE_DEPTH files), so on a large tree this undercounts the run and favours
+        // the engine that compiles fastest; --largest-first counts the whole tree.
+        const double scale = sample_bytes
+            ? std::max(1.0, static_cast<double>(discovered_bytes.load()) / static_cast<double>(sample_bytes)) : 1.0;
+        auto trials = EngineTuner::measure(sigs, sample, cache_dir, classify);
+        auto ms = [](double v) {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(2) << v << " ms";
+            return out.str();
+        };
+        for (const auto& t : trials)
+            Logger::info("Engine trial: " + EngineTuner::key(t.engine)
+                         + (t.ok ? ", prepare " + ms(t.prepare_ms) + ", sample " + ms(t.scan_ms) : ", failed to prepare"));
+        const size_t best = EngineTuner::pick(trials, scale);
+        if (best < trials.size()) {
+            engine_choice = trials[best].engine;
+            base_scanner = std::move(trials[best].scanner);
+            EngineTuner::save(cache_dir, signature_set_hash(sigs), classify, engine_choice);
         }
+        Logger::info("Engine (auto): " + EngineTuner::key(engine_choice) + " on a "
+                     + std::to_string(sample_bytes / 1024) + " KB sample of "
+                     + std::to_string(discovered_bytes.load() / 1024) + " KB");
     }
-    catch (const std::exception& e) {
-        Logger::error("Directory traversal error: " + std::string(e.what()));
+
+    // Compile once; workers fork() the prepared scanner and share its immutable state.
+    // Done before traversal (but for -e auto's sample) so scanning can begin with the
+    // first file found.
+    if (!base_scanner) {
+        base_scanner = Scanner::create(engine_choice);
+        base_scanner->set_cache_dir(cache_dir);
+        base_scanner->prepare(sigs);
     }
+    base_scanner->set_time_budget(std::chrono::milliseconds(file_budget_ms));
+    auto engine_name_str = base_scanner->name();
 
-    auto engine_name_str = Scanner::create(engine_choice)->name();
-    std::cerr << "[Info] Scanning: " << target_path << " (" << file_paths.size()
-              << " files, " << num_threads << " threads, engine: " << engine_name_str << ")\n";
-    Logger::info("Scan started: " + target_path + " (" + std::to_string(file_paths.size())
-                 + " files, " + std::to_string(num_threads) + " threads)");
+    // --incremental: files whose device, inode, size and mtime match the previous run take
+    // their counts from the cache instead of being read.
+    std::unique_ptr<ResultCache> result_cache;
+    if (incremental && base_scanner->signature_names()) {
+        if (result_cache_dir.empty()) {
+            std::error_code ec;
+            auto tmp = fs::temp_directory_path(ec);
+            if (!ec) result_cache_dir = (tmp / "devscan_cache").string();
+        }
+        if (!result_cache_dir.empty()) {
+            // Classified files hold one count each: a cache of their own.
+            result_cache = std::make_unique<ResultCache>(result_cache_dir,
+                                                         engine_name_str + (classify ? "/classify" : ""),
+                                                         base_scanner->signature_names(),
+                                                         signature_set_hash(sigs), target_path);
+            Logger::info("Result cache: " + result_cache->path() + " ("
+                         + std::to_string(result_cache->loaded()) + " entries)");
+        }
+    }
+    std::atomic<size_t> cached_files{0};
 
-    // Progress tracking
-    std::atomic<size_t> processed{0};
-    size_t total_files = file_paths.size();
+    // --dedup: files read whole are hashed first; a copy of content already scanned in
+    // this run reuses the first copy's counts. Every copy is still counted.
+    std::unique_ptr<ContentDedup> content_dedup;
+    if (dedup && base_scanner->signature_names())
+        content_dedup = std::make_unique<ContentDedup>(base_scanner->signature_names());
 
-    // Split files into chunks for threads
-    if (num_threads > total_files && total_files > 0) num_threads = static_cast<unsigned int>(total_files);
-    if (num_threads == 0) num_threads = 1;
+    // A file of --split MB or more is mapped whole and cut into segments scanned by every
+    // configured thread, so one disk image does not leave the other workers idle at the end.
+    const unsigned int split_threads = num_threads;
+    const bool split_enabled = split_size > 0 && split_threads > 1;
 
-    auto scan_chunk = [&](size_t start, size_t end) -> ScanStats {
-        auto scanner = Scanner::create(engine_choice);
-        scanner->prepare(sigs);
+    // Per-worker state: engine fork, counters and an I/O reader with its reusable buffers.
+    struct Worker {
+        std::unique_ptr<Scanner> scanner;
+        std::unique_ptr<FileReader> reader;
         ScanStats local;
+        ScanStats file_stats; // one file's counts, stored in the result cache before merging
+        std::vector<char> stream_buf;
+        std::vector<FileEntry> batch; // files handed to `reader` together
+        std::unique_ptr<Scanner> fallback; // RE2 fork, made on the worker's first file over budget
+    };
+    auto make_worker = [&] {
+        Worker w;
+        w.scanner = base_scanner->fork();
+        w.reader = FileReader::create(io_backend);
+        return w;
+    };
 
-        for (size_t i = start; i < end; ++i) {
-            try {
-                auto fsize = fs::file_size(file_paths[i]);
-                if (fsize == 0) {
-                    processed++;
-                    continue;
-                }
-                if (fsize > max_filesize) {
-                    Logger::warn("Skipped (too large): " + file_paths[i].string()
-                                 + " (" + std::to_string(fsize / 1024 / 1024) + " MB)");
-                    processed++;
-                    continue;
+    // --classify: one `path<TAB>type` line per file on stdout, whichever worker finishes it.
+    std::mutex record_mutex;
+    auto print_record = [&](const std::string& path, const std::string& type) {
+        std::lock_guard<std::mutex> lock(record_mutex);
+        std::cout << path << '\t' << type << '\n';
+    };
+
+    // A file that runs past --file-budget, or that Boost gives up on, read whole, split or
+    // streamed, is scanned again the same way by RE2, whose time is linear in the input, and
+    // listed in the reports. RE2 is prepared on the first such file of the run.
+    std::once_flag fallback_once;
+    std::unique_ptr<Scanner> fallback_base;
+    std::mutex fallback_mutex;
+    std::vector<std::string> fallback_files;
+    auto with_fallback = [&](Worker& w, const std::string& path, auto&& scan_with) {
+        try {
+            scan_with(*w.scanner);
+            return;
+        }
+        catch (const ScanBudgetExceeded& e) {
+            w.file_stats.reset();
+            Logger::warn("Over budget: " + path + ": " + e.what() + ", rescanned with RE2");
+            std::lock_guard<std::mutex> lock(fallback_mutex);
+            fallback_files.push_back(path);
+        }
+        if (!w.fallback) {
+            std::call_once(fallback_once, [&] {
+                fallback_base = Scanner::create(EngineType::RE2);
+                fallback_base->set_cache_dir(cache_dir);
+                fallback_base->prepare(sigs);
+            });
+            w.fallback = fallback_base->fork();
+        }
+        scan_with(*w.fallback);
+    };
+    auto scan_whole = [&](Worker& w, const std::string& path, const char* data, size_t size) {
+        with_fallback(w, path, [&](Scanner& scanner) {
+            if (classify) scanner.classify(data, size, w.file_stats);
+            else scanner.scan(data, size, w.file_stats);
+        });
+    };
+
+    // Every scan writes into `file_stats`, which is handed to the result cache (when
+    // enabled and `store`) and then added to the worker's totals.
+    auto finish_file = [&](Worker& w, const FileEntry& file, bool store) {
+        if (classify) print_record(file.path, classified_type(w.file_stats));
+        if (store && result_cache) result_cache->store(file, w.file_stats);
+        w.local += w.file_stats;
+        w.local.total_files_processed++;
+        w.file_stats.reset();
+    };
+
+    // Cached, empty, split and streamed files are dealt with here; the rest goes to the
+    // worker's batch. Size comes from the walker's stat(); the file is not stat'ed again.
+    auto take_file = [&](Worker& w, FileEntry&& file) {
+        const std::string& path = file.path;
+        const uint64_t fsize = file.size;
+        if (result_cache && result_cache->lookup(file, w.file_stats)) {
+            finish_file(w, file, /*store=*/false);
+            cached_files++;
+            processed++;
+            return;
+        }
+        // classify() stops at the first type, usually within the first pages, so a file
+        // over CLASSIFY_READ_BYTES is mapped rather than read whole; --allowlist and
+        // --dedup hash the whole content anyway, so with them it is read as before.
+        const bool map_for_classify = classify && fsize > CLASSIFY_READ_BYTES && !allowlist && !content_dedup;
+        if (fsize > 0 && !(split_enabled && fsize >= split_size) && fsize <= max_filesize && !map_for_classify) {
+            w.batch.push_back(std::move(file));
+            return;
+        }
+        try {
+            // Mapped whole rather than split or streamed: only the pages classify() touches are read.
+            if (classify) {
+                if (fsize > 0) {
+                    boost::iostreams::mapped_file_source mmap(path);
+                    if (mmap.is_open()) scan_whole(w, path, mmap.data(), mmap.size());
                 }
-                boost::iostreams::mapped_file_source mmap(file_paths[i].string());
+                finish_file(w, file, /*store=*/true);
+            }
+            else if (split_enabled && fsize >= split_size) {
+                Logger::info("Splitting large file: " + path
+                             + " (" + std::to_string(fsize / 1024 / 1024) + " MB, "
+                             + std::to_string(split_threads) + " threads)");
+                boost::iostreams::mapped_file_source mmap(path);
                 if (mmap.is_open()) {
-                    scanner->scan(mmap.data(), mmap.size(), local);
-                    local.total_files_processed++;
+                    with_fallback(w, path, [&](Scanner& scanner) {
+                        scanner.scan_parallel(mmap.data(), mmap.size(), w.file_stats, split_threads);
+                    });
+                    finish_file(w, file, /*store=*/true);
                 }
             }
-            catch (const std::exception& e) {
-                Logger::warn("Skipped: " + file_paths[i].string() + ": " + e.what());
+            else if (fsize > max_filesize) {
+                Logger::info("Streaming large file: " + path
+                             + " (" + std::to_string(fsize / 1024 / 1024) + " MB)");
+                with_fallback(w, path, [&](Scanner& scanner) {
+                    scan_streamed(scanner, path, w.stream_buf, w.file_stats);
+                });
+                finish_file(w, file, /*store=*/true);
             }
-            processed++;
         }
-        return local;
+        catch (const std::exception& e) {
+            w.file_stats.reset();
+            Logger::warn("Skipped: " + path + ": " + e.what());
+        }
+        processed++;
     };
 
-    // Launch threads
-    auto t_start = std::chrono::high_resolution_clock::now();
-    std::vector<std::future<ScanStats>> futures;
-    size_t chunk_size = (total_files + num_threads - 1) / num_threads;
-
-    for (unsigned int t = 0; t < num_threads; ++t) {
-        size_t start = t * chunk_size;
-        size_t end = std::min(start + chunk_size, total_files);
-        if (start >= total_files) break;
-        futures.push_back(std::async(std::launch::async, scan_chunk, start, end));
-    }
-
-    // Progress indicator (print to stderr every 500ms)
-    if (total_files > 10) {
-        while (true) {
-            bool all_done = true;
-            for (auto& f : futures) {
-                if (f.wait_for(std::chrono::milliseconds(500)) != std::future_status::ready) {
-                    all_done = false;
-                    break;
+    auto scan_batch = [&](Worker& w) {
+        w.reader->read(w.batch.data(), w.batch.size(),
+            [&](const FileEntry& file, const char* data, size_t size) {
+                const uint64_t hash = (allowlist || content_dedup) ? content_hash(data, size) : 0;
+                if (allowlist && allowlist->contains(data, size, hash)) {
+                    if (classify) print_record(file.path, "known");
+                    w.local.total_files_processed++;
+                    known_files++;
+                    processed++;
+                    return;
+                }
+                auto claim = ContentDedup::Claim::IN_PROGRESS;
+                try {
+                    if (content_dedup) claim = content_dedup->acquire(hash, size, w.file_stats);
+                    if (claim != ContentDedup::Claim::REUSED) scan_whole(w, file.path, data, size);
+                }
+                catch (const std::exception& e) {
+                    w.file_stats.reset();
+                    if (claim == ContentDedup::Claim::FIRST) content_dedup->release(hash, size);
+                    Logger::warn("Skipped: " + file.path + ": " + e.what());
+                    processed++;
+                    return;
                 }
+                if (claim == ContentDedup::Claim::FIRST) content_dedup->publish(hash, size, w.file_stats);
+                finish_file(w, file, /*store=*/true);
+                processed++;
+            },
+            [&](const FileEntry& file, const std::string& error) {
+                Logger::warn("Skipped: " + file.path + ": " + error);
+                processed++;
+            });
+        w.batch.clear();
+    };
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<WorkScheduler> scheduler;
+
+    if (largest_first) {
+        if (!traversal_done) collect_files();
+        size_t total_files = files.size();
+
+        if (num_threads > total_files && total_files > 0) num_threads = static_cast<unsigned int>(total_files);
+        std::cerr << "[Info] Scanning: " << target_path << " (" << total_files
+                  << " files, " << num_threads << " threads, engine: " << engine_name_str << ")\n";
+        Logger::info("Scan started: " + target_path + " (" + std::to_string(total_files)
+                     + " files, " + std::to_string(num_threads) + " threads)");
+
+        // Work-stealing dispatch: idle workers take files from busy workers' deques, so one
+        // thread is never left alone with a run of large files.
+        std::vector<uint64_t> file_sizes;
+        file_sizes.reserve(total_files);
+        for (const auto& f : files) file_sizes.push_back(f.size);
+        scheduler = std::make_unique<WorkScheduler>(file_sizes, num_threads, WorkScheduler::Order::LARGEST_FIRST);
+        auto scan_worker = [&](unsigned int worker) -> ScanStats {
+            Worker w = make_worker();
+            const size_t batch = w.reader->batch_size();
+            size_t i = 0;
+            while (scheduler->next(worker, i)) {
+                take_file(w, std::move(files[i]));
+                if (w.batch.size() >= batch) scan_batch(w);
             }
-            size_t p = processed.load();
-            std::cerr << "\r[" << p << "/" << total_files << "] "
-                      << (total_files > 0 ? (p * 100 / total_files) : 100) << "%   " << std::flush;
-            if (all_done) break;
+            scan_batch(w);
+            return std::move(w.local);
+        };
+        if (total_files > 0) {
+            for (unsigned int t = 0; t < num_threads; ++t)
+                futures.push_back(std::async(std::launch::async, scan_worker, t));
         }
-        std::cerr << "\r[" << total_files << "/" << total_files << "] 100%   \n";
     }
+    else {
+        if (!is_dir) num_threads = 1;
+        std::cerr << "[Info] Scanning: " << target_path << " (" << num_threads
+                  << " threads, engine: " << engine_name_str << ")\n";
+        Logger::info("Scan started: " + target_path + " (" + std::to_string(num_threads) + " threads)");
+
+        if (!producer.joinable()) start_traversal();
+        // Blocks only for the first file of a batch; the rest is whatever is already queued.
+        auto scan_worker = [&]() -> ScanStats {
+            Worker w = make_worker();
+            const size_t batch = w.reader->batch_size();
+            for (size_t i; (i = sampled_next++) < sampled.size();) {
+                take_file(w, std::move(sampled[i]));
+                if (w.batch.size() >= batch) scan_batch(w);
+            }
+            scan_batch(w);
+            FileEntry file;
+            while (pipeline.pop(file)) {
+                take_file(w, std::move(file));
+                while (w.batch.size() < batch && pipeline.try_pop(file)) take_file(w, std::move(file));
+                scan_batch(w);
+            }
+            return std::move(w.local);
+        };
+        for (unsigned int t = 0; t < num_threads; ++t)
+            futures.push_back(std::async(std::launch::async, scan_worker));
+    }
+
+    // Progress indicator (print to stderr every 500ms). The total is shown as "N+" while
+    // traversal is still discovering files.
+    bool progress_shown = false;
+    while (!futures.empty()) {
+        bool all_done = true;
+        for (auto& f : futures) {
+            if (f.wait_for(std::chrono::milliseconds(500)) != std::future_status::ready) {
+                all_done = false;
+                break;
+            }
+        }
+        size_t p = processed.load();
+        size_t d = discovered.load();
+        if (d > 10 && !all_done) {
+            progress_shown = true;
+            if (traversal_done.load())
+                std::cerr << "\r[" << p << "/" << d << "] " << (p * 100 / d) << "%   " << std::flush;
+            else
+                std::cerr << "\r[" << p << "/" << d << "+] listing...   " << std::flush;
+        }
+        if (all_done) break;
+    }
+    if (progress_shown) {
+        size_t d = discovered.load();
+        std::cerr << "\r[" << d << "/" << d << "] 100%          \n";
+    }
+    if (producer.joinable()) producer.join();
 
     // Merge results
     ScanStats results;
@@ -204,21 +685,46 @@ int main(int argc, char* argv[]) {
     auto t_end = std::chrono::high_resolution_clock::now();
     double elapsed = std::chrono::duration<double>(t_end - t_start).count();
 
-    apply_deduction(results, sigs);
+    if (result_cache) {
+        result_cache->save();
+        Logger::info("Result cache: " + std::to_string(cached_files.load()) + " files reused, "
+                     + std::to_string(results.total_files_processed - cached_files.load()) + " scanned");
+    }
+
+    // Deduction (deduct_from) already happened per file, inside the engines.
     Logger::info("Scan complete. Files: " + std::to_string(results.total_files_processed)
                  + ", time: " + std::to_string(elapsed) + "s");
 
-    // Results table
-    std::cout << "\n--- SCAN RESULTS ---\n";
-    std::cout << std::left << std::setw(15) << "Type" << " | " << "Count\n";
-    std::cout << "--------------------------\n";
-    for (auto const& [name, count] : results.counts) {
+    // Results table. With --classify stdout carries the per-file records, so the summary
+    // goes to stderr.
+    std::ostream& out = classify ? std::cerr : std::cout;
+    out << "\n--- SCAN RESULTS ---\n";
+    out << std::left << std::setw(15) << "Type" << " | " << "Count\n";
+    out << "--------------------------\n";
+    for (auto const& [name, count] : results.totals()) {
         if (count > 0)
-            std::cout << std::left << std::setw(15) << name << " | " << count << "\n";
+            out << std::left << std::setw(15) << name << " | " << count << "\n";
+    }
+    out << "--------------------------\n";
+    out << "Files processed: " << results.total_files_processed
+        << "  (" << std::fixed << std::setprecision(2) << elapsed << "s)\n";
+    if (result_cache)
+        out << "Unchanged (cached): " << cached_files.load() << "\n";
+    if (allowlist) {
+        out << "Known files skipped: " << known_files.load() << "\n";
+        Logger::info("Allowlist: " + std::to_string(known_files.load()) + " known files not scanned");
+    }
+    if (content_dedup) {
+        out << "Duplicates skipped: " << content_dedup->reused_files() << " files ("
+            << std::setprecision(1) << content_dedup->bytes_skipped() / (1024.0 * 1024.0) << " MB)\n";
+        Logger::info("Dedup: " + std::to_string(content_dedup->reused_files()) + " duplicate files, "
+                     + std::to_string(content_dedup->bytes_skipped()) + " bytes not scanned");
+    }
+    if (!fallback_files.empty()) {
+        std::sort(fallback_files.begin(), fallback_files.end());
+        out << "Over budget (rescanned with RE2): " << fallback_files.size() << "\n";
+        Logger::info("Budget: " + std::to_string(fallback_files.size()) + " files rescanned with RE2");
     }
-    std::cout << "--------------------------\n";
-    std::cout << "Files processed: " << results.total_files_processed
-              << "  (" << std::fixed << std::setprecision(2) << elapsed << "s)\n";
 
     // Reports
     if (!no_report) {
@@ -228,12 +734,12 @@ int main(int argc, char* argv[]) {
         fs::create_directories(fs::path(json_path).parent_path());
         fs::create_directories(fs::path(txt_path).parent_path());
 
-        ReportWriter::write_json(json_path, results, target_path, engine_name_str);
-        ReportWriter::write_txt(txt_path, results, target_path, engine_name_str);
+        ReportWriter::write_json(json_path, results, target_path, engine_name_str, fallback_files);
+        ReportWriter::write_txt(txt_path, results, target_path, engine_name_str, fallback_files);
         Logger::info("Reports saved: " + json_path + ", " + txt_path);
-        std::cout << "[Reports] " << json_path << ", " << txt_path << "\n";
+        out << "[Reports] " << json_path << ", " << txt_path << "\n";
     }
 
-    std::cout << "[Log]     " << Logger::path() << "\n";
+    out << "[Log]     " << Logger::path() << "\n";
     return 0;
 }
@@ -8,9 +8,28 @@
 #include <iomanip>
 #include <map>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 
 #include "Scanner.h"
 #include "ConfigLoader.h"
+#include "WorkScheduler.h"
+#include "DirWalker.h"
+#include "FileReader.h"
+#include "ContentDedup.h"
 #include "TypeMap.h"
 #include "generator/Generator.h"
 
@@ -19,19 +38,18 @@ namespace fs = std::filesystem;
 // Сигнатуры загружаются из JSON — единый источник истины
 static std::vector<SignatureDefinition> g_sigs;
 
-struct FileEntry {
+struct DatasetFile {
     std::string name;
     std::string content;
     std::string extension;
 };
 
-static std::vector<FileEntry> g_files;
+static std::vector<DatasetFile> g_files;
 static size_t g_total_bytes = 0;
 static GenStats g_expected_stats;
 
 int GetStat(const ScanStats& st, const std::string& key) {
-    auto it = st.counts.find(key);
-    return (it != st.counts.end()) ? it->second : 0;
+    return st.get(key);
 }
 
 void LoadDataset(const fs::path& folder, double mix_ratio) {
@@ -55,7 +73,7 @@ void LoadDataset(const fs::path& folder, double mix_ratio) {
             f.seekg(0);
             f.read(&str[0], size);
 
-            FileEntry fe;
+            DatasetFile fe;
             fe.name = entry.path().filename().string();
             fe.content = std::move(str);
             fe.extension = entry.path().extension().string();
@@ -79,7 +97,7 @@ bool IsCorrectDetection(const std::string& ext, const ScanStats& st, bool strict
     if (key.empty()) return false;
     if (GetStat(st, key) == 0) return false;
 
-    if (strict_mode && st.counts.size() > 1) {
+    if (strict_mode && st.totals().size() > 1) {
         // Разрешаем коллизии для Office форматов (детектятся как ZIP + DOCX)
         if (key == "DOCX" || key == "XLSX" || key == "PPTX") return true;
         return false;
@@ -128,6 +146,8 @@ void VerifyAll(bool strict) {
     check_engine(std::make_unique<Re2Scanner>());
     check_engine(std::make_unique<BoostScanner>());
     check_engine(std::make_unique<HsScanner>());
+    check_engine(std::make_unique<LiteralScanner>());
+    check_engine(std::make_unique<HybridScanner>());
 }
 
 template <typename ScannerT>
@@ -150,11 +170,688 @@ void BM_Scan(benchmark::State& state) {
     size_t bytes_processed = 0;
     for (size_t i = start_idx; i < end_idx; ++i) bytes_processed += g_files[i].content.size();
     state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes_processed);
+    // Match callbacks Hyperscan made per MB: the counting work on top of the automaton.
+    if constexpr (std::is_same_v<ScannerT, HsScanner>) state.counters["callbacks/MB"] = scanner->callbacks_per_mb();
 }
 
+// Startup cost: full hs_compile_multi vs. hs_deserialize_database from the on-disk cache.
+static const char* BENCH_HS_CACHE_DIR = "bench_hs_cache";
+
+void BM_HsStartup_Cold(benchmark::State& state) {
+    for (auto _ : state) {
+        HsScanner scanner;
+        scanner.prepare(g_sigs);
+        benchmark::DoNotOptimize(scanner);
+    }
+}
+
+void BM_HsStartup_Warm(benchmark::State& state) {
+    {
+        HsScanner warmup;
+        warmup.set_cache_dir(BENCH_HS_CACHE_DIR);
+        warmup.prepare(g_sigs);
+    }
+    for (auto _ : state) {
+        HsScanner scanner;
+        scanner.set_cache_dir(BENCH_HS_CACHE_DIR);
+        scanner.prepare(g_sigs);
+        benchmark::DoNotOptimize(scanner);
+    }
+}
+
+BENCHMARK(BM_HsStartup_Cold)->Name("Hyperscan/Startup/Cold")->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HsStartup_Warm)->Name("Hyperscan/Startup/Warm")->Unit(benchmark::kMillisecond);
+
+size_t CurrentRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc.WorkingSetSize;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Startup of N workers: every worker compiles its own engine (the pre-fork model) vs. one
+// prepare() and N fork()s. rss_mb is the peak resident growth while all N engines are alive.
+template <typename ScannerT, bool Shared>
+void BM_Startup(benchmark::State& state) {
+    const auto workers = static_cast<size_t>(state.range(0));
+    double rss_mb = 0;
+    for (auto _ : state) {
+        size_t rss_before = CurrentRssBytes();
+        std::unique_ptr<Scanner> base;
+        if (Shared) {
+            base = std::make_unique<ScannerT>();
+            base->prepare(g_sigs);
+        }
+        std::vector<std::unique_ptr<Scanner>> engines(workers);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < workers; ++t) {
+            threads.emplace_back([&, t] {
+                if (Shared) {
+                    engines[t] = base->fork();
+                }
+                else {
+                    engines[t] = std::make_unique<ScannerT>();
+                    engines[t]->prepare(g_sigs);
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+        size_t rss_after = CurrentRssBytes();
+        if (rss_after > rss_before) rss_mb = std::max(rss_mb, (rss_after - rss_before) / (1024.0 * 1024.0));
+    }
+    state.counters["rss_mb"] = rss_mb;
+}
+
+#define STARTUP_ARGS ->Arg(1)->Arg(8)->Arg(64)->UseRealTime()->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Startup, Re2Scanner, false)->Name("RE2/Startup/PerThreadCompile") STARTUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Startup, Re2Scanner, true)->Name("RE2/Startup/Fork") STARTUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Startup, BoostScanner, false)->Name("Boost/Startup/PerThreadCompile") STARTUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Startup, BoostScanner, true)->Name("Boost/Startup/Fork") STARTUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Startup, HsScanner, false)->Name("Hyperscan/Startup/PerThreadCompile") STARTUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Startup, HsScanner, true)->Name("Hyperscan/Startup/Fork") STARTUP_ARGS;
+#undef STARTUP_ARGS
+
+// Per-match counting cost in the engine callbacks: name-keyed std::map (ScanStats::add)
+// vs. the dense id-indexed array (ScanStats::hit). Same noisy match stream for both.
+std::vector<uint32_t> MakeMatchStream(size_t count) {
+    std::vector<uint32_t> ids(count);
+    uint32_t x = 12345;
+    for (auto& id : ids) {
+        x = x * 1664525u + 1013904223u;
+        id = (x >> 8) % static_cast<uint32_t>(g_sigs.size());
+    }
+    return ids;
+}
+
+void BM_Count_StringMap(benchmark::State& state) {
+    std::vector<std::string> names;
+    for (const auto& s : g_sigs) names.push_back(s.name);
+    auto ids = MakeMatchStream(4096);
+    for (auto _ : state) {
+        ScanStats stats;
+        for (uint32_t id : ids) stats.add(names[id]);
+        benchmark::DoNotOptimize(stats.counts);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ids.size()));
+}
+
+void BM_Count_Dense(benchmark::State& state) {
+    auto names = std::make_shared<SignatureNames>();
+    for (const auto& s : g_sigs) names->push_back(s.name);
+    auto ids = MakeMatchStream(4096);
+    for (auto _ : state) {
+        ScanStats stats;
+        stats.bind(names);
+        for (uint32_t id : ids) stats.hit(id);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ids.size()));
+}
+
+BENCHMARK(BM_Count_StringMap)->Name("Counters/StringMap");
+BENCHMARK(BM_Count_Dense)->Name("Counters/Dense");
+
+// Skewed corpus: a cluster of large "media" files at the front (as directory order tends
+// to group them) followed by many small files. Static contiguous chunking hands the whole
+// cluster to the first worker; the work-stealing scheduler spreads it.
+static std::vector<std::string> g_skewed;
+
+void BuildSkewedDataset() {
+    if (!g_skewed.empty() || g_files.empty()) return;
+    std::string blob;
+    for (const auto& f : g_files) blob += f.content;
+    auto make = [&](size_t size) {
+        std::string out;
+        while (out.size() < size) out.append(blob, 0, std::min(blob.size(), size - out.size()));
+        return out;
+    };
+    for (int i = 0; i < 8; ++i) g_skewed.push_back(make(8 * 1024 * 1024));
+    for (int i = 0; i < 512; ++i) g_skewed.push_back(make(32 * 1024));
+}
+
+enum class Dispatch { STATIC_CHUNKS, STEALING, STEALING_LARGEST_FIRST };
+
+template <Dispatch Mode>
+void BM_Dispatch(benchmark::State& state) {
+    BuildSkewedDataset();
+    const auto workers = static_cast<unsigned>(state.range(0));
+    HsScanner base;
+    base.prepare(g_sigs);
+    std::vector<uint64_t> weights;
+    size_t bytes = 0;
+    for (const auto& f : g_skewed) {
+        weights.push_back(f.size());
+        bytes += f.size();
+    }
+
+    for (auto _ : state) {
+        WorkScheduler sched(weights, workers, Mode == Dispatch::STEALING_LARGEST_FIRST
+                            ? WorkScheduler::Order::LARGEST_FIRST : WorkScheduler::Order::AS_GIVEN);
+        std::vector<std::thread> threads;
+        if (Mode == Dispatch::STATIC_CHUNKS) {
+            size_t chunk = (g_skewed.size() + workers - 1) / workers;
+            for (unsigned w = 0; w < workers; ++w) {
+                threads.emplace_back([&, w] {
+                    auto scanner = base.fork();
+                    ScanStats stats;
+                    size_t end = std::min(g_skewed.size(), (w + 1) * chunk);
+                    for (size_t i = w * chunk; i < end; ++i)
+                        scanner->scan(g_skewed[i].data(), g_skewed[i].size(), stats);
+                });
+            }
+        }
+        else {
+            for (unsigned w = 0; w < workers; ++w) {
+                threads.emplace_back([&, w] {
+                    auto scanner = base.fork();
+                    ScanStats stats;
+                    size_t i;
+                    while (sched.next(w, i)) scanner->scan(g_skewed[i].data(), g_skewed[i].size(), stats);
+                });
+            }
+        }
+        for (auto& t : threads) t.join();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+BENCHMARK_TEMPLATE(BM_Dispatch, Dispatch::STATIC_CHUNKS)->Name("Dispatch/StaticChunks")->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Dispatch, Dispatch::STEALING)->Name("Dispatch/WorkStealing")->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Dispatch, Dispatch::STEALING_LARGEST_FIRST)->Name("Dispatch/WorkStealingLargestFirst")->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Traversal only, files/sec on a wide tree of small files: recursive_directory_iterator
+// plus the separate file_size() stat the scan path used to do, vs. DirWalker (one stat per
+// file, directories listed by N threads). Run twice to compare cold and warm dentry cache.
+static const char* BENCH_WALK_DIR = "bench_walk_tree";
+static size_t g_walk_files = 0;
+
+void BuildWalkTree() {
+    if (g_walk_files) return;
+    fs::remove_all(BENCH_WALK_DIR);
+    for (int d = 0; d < 32; ++d) {
+        for (int s = 0; s < 8; ++s) {
+            fs::path dir = fs::path(BENCH_WALK_DIR) / ("d" + std::to_string(d)) / ("s" + std::to_string(s));
+            fs::create_directories(dir);
+            for (int f = 0; f < 40; ++f) {
+                std::ofstream(dir / ("f" + std::to_string(f) + ".bin")) << "x";
+                g_walk_files++;
+            }
+        }
+    }
+}
+
+void BM_Walk_StdFilesystem(benchmark::State& state) {
+    BuildWalkTree();
+    for (auto _ : state) {
+        size_t n = 0;
+        uint64_t bytes = 0;
+        for (auto const& entry : fs::recursive_directory_iterator(BENCH_WALK_DIR)) {
+            if (entry.is_regular_file() && !entry.is_symlink()) {
+                bytes += fs::file_size(entry.path());
+                n++;
+            }
+        }
+        benchmark::DoNotOptimize(bytes);
+        if (n != g_walk_files) state.SkipWithError("file count mismatch");
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * g_walk_files));
+}
+
+void BM_Walk_DirWalker(benchmark::State& state) {
+    BuildWalkTree();
+    const auto threads = static_cast<unsigned>(state.range(0));
+    for (auto _ : state) {
+        std::atomic<uint64_t> bytes{0};
+        size_t n = DirWalker::walk(BENCH_WALK_DIR, threads, [&](FileEntry&& file) {
+            bytes.fetch_add(file.size, std::memory_order_relaxed);
+        });
+        benchmark::DoNotOptimize(bytes.load());
+        if (n != g_walk_files) state.SkipWithError("file count mismatch");
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * g_walk_files));
+}
+
+BENCHMARK(BM_Walk_StdFilesystem)->Name("Walk/StdFilesystem")->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Walk_DirWalker)->Name("Walk/DirWalker")->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// End-to-end read + scan of a tree of small files through each I/O backend. Cold runs
+// drop the files from the page cache before every iteration (posix_fadvise DONTNEED, no
+// root needed); on platforms without it cold and warm are the same measurement.
+static const char* BENCH_IO_DIR = "bench_io_tree";
+static std::vector<FileEntry> g_io_files;
+static uint64_t g_io_bytes = 0;
+
+void BuildIoTree() {
+    if (!g_io_files.empty() || g_files.empty()) return;
+    fs::remove_all(BENCH_IO_DIR);
+    std::string blob;
+    for (const auto& f : g_files) blob += f.content;
+    for (int d = 0; d < 16; ++d) {
+        fs::path dir = fs::path(BENCH_IO_DIR) / ("d" + std::to_string(d));
+        fs::create_directories(dir);
+        for (int f = 0; f < 256; ++f) {
+            size_t size = std::min(blob.size(), size_t{4096} << ((d + f) % 5)); // 4..64 KB
+            size_t off = (static_cast<size_t>(d) * 7919 + f * 104729) % (blob.size() - size + 1);
+            FileEntry e;
+            e.path = (dir / ("f" + std::to_string(f) + ".bin")).string();
+            e.size = size;
+            std::ofstream(e.path, std::ios::binary).write(blob.data() + off, static_cast<std::streamsize>(size));
+            g_io_bytes += size;
+            g_io_files.push_back(std::move(e));
+        }
+    }
+}
+
+void DropPageCache() {
+#ifdef POSIX_FADV_DONTNEED
+    for (const auto& f : g_io_files) {
+        int fd = ::open(f.path.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#endif
+}
+
+template <IoBackend Backend, bool Cold>
+void BM_Io(benchmark::State& state) {
+    BuildIoTree();
+    const auto workers = static_cast<unsigned>(state.range(0));
+    HsScanner base;
+    base.prepare(g_sigs);
+    for (auto _ : state) {
+        if (Cold) {
+            state.PauseTiming();
+            DropPageCache();
+            state.ResumeTiming();
+        }
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> threads;
+        for (unsigned w = 0; w < workers; ++w) {
+            threads.emplace_back([&] {
+                auto scanner = base.fork();
+                auto reader = FileReader::create(Backend);
+                ScanStats stats;
+                const size_t batch = reader->batch_size();
+                for (size_t i; (i = next.fetch_add(batch)) < g_io_files.size();) {
+                    reader->read(g_io_files.data() + i, std::min(batch, g_io_files.size() - i),
+                        [&](const FileEntry&, const char* data, size_t size) { scanner->scan(data, size, stats); },
+                        [&](const FileEntry&, const std::string&) {});
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_io_bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * g_io_files.size()));
+}
+
+#define IO_ARGS ->Arg(1)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::MMAP, true)->Name("Io/Mmap/Cold") IO_ARGS;
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::PREAD, true)->Name("Io/Pread/Cold") IO_ARGS;
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::URING, true)->Name("Io/Uring/Cold") IO_ARGS;
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::MMAP, false)->Name("Io/Mmap/Warm") IO_ARGS;
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::PREAD, false)->Name("Io/Pread/Warm") IO_ARGS;
+BENCHMARK_TEMPLATE(BM_Io, IoBackend::URING, false)->Name("Io/Uring/Warm") IO_ARGS;
+
+// Content dedup on a corpus where Arg% of the files are copies of earlier ones: the
+// hash of every file is always paid, the scan only for the first copy of each content.
+static std::vector<std::string> g_dup_files;
+
+void BuildDuplicateCorpus(int dup_percent) {
+    g_dup_files.clear();
+    std::string blob;
+    for (const auto& f : g_files) blob += f.content;
+    if (blob.empty()) return;
+    constexpr size_t FILES = 1024, FILE_BYTES = 64 * 1024;
+    uint32_t x = 2463534242u;
+    auto next = [&] { x ^= x << 13; x ^= x >> 17; x ^= x << 5; return x; };
+    for (size_t i = 0; i < FILES; ++i) {
+        if (!g_dup_files.empty() && next() % 100 < static_cast<uint32_t>(dup_percent)) {
+            g_dup_files.push_back(g_dup_files[next() % g_dup_files.size()]);
+            continue;
+        }
+        std::string f;
+        size_t off = next() % blob.size();
+        while (f.size() < FILE_BYTES) {
+            size_t n = std::min(blob.size() - off, FILE_BYTES - f.size());
+            f.append(blob, off, n);
+            off = 0;
+        }
+        std::memcpy(&f[0], &i, sizeof(i)); // distinct even when the offsets repeat
+        g_dup_files.push_back(std::move(f));
+    }
+}
+
+template <bool Dedup>
+void BM_Dedup(benchmark::State& state) {
+    BuildDuplicateCorpus(static_cast<int>(state.range(0)));
+    Re2Scanner scanner;
+    scanner.prepare(g_sigs);
+    size_t bytes = 0;
+    for (const auto& f : g_dup_files) bytes += f.size();
+
+    uint64_t skipped = 0;
+    for (auto _ : state) {
+        ContentDedup dedup(scanner.signature_names());
+        ScanStats total, file_stats;
+        for (const auto& f : g_dup_files) {
+            if (Dedup) {
+                const uint64_t hash = content_hash(f.data(), f.size());
+                auto claim = dedup.acquire(hash, f.size(), file_stats);
+                if (claim != ContentDedup::Claim::REUSED) scanner.scan(f.data(), f.size(), file_stats);
+                if (claim == ContentDedup::Claim::FIRST) dedup.publish(hash, f.size(), file_stats);
+            }
+            else {
+                scanner.scan(f.data(), f.size(), file_stats);
+            }
+            total += file_stats;
+            file_stats.reset();
+        }
+        benchmark::DoNotOptimize(total.hits.data());
+        skipped = dedup.bytes_skipped();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["skipped_MB"] = static_cast<double>(skipped) / (1024.0 * 1024.0);
+}
+
+#define DEDUP_ARGS ->Arg(0)->Arg(50)->Arg(90)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Dedup, false)->Name("Dedup/Off") DEDUP_ARGS;
+BENCHMARK_TEMPLATE(BM_Dedup, true)->Name("Dedup/On") DEDUP_ARGS;
+#undef DEDUP_ARGS
+
+// Cost of container subtypes as they are added: Arg extra subtypes of the ZIP magic, as
+// tree children (discriminator run only after a ZIP header) vs. the same `head.*?marker`
+// patterns as plain text signatures, which every engine scans for blindly.
+template <typename ScannerT, bool Tree>
+void BM_Subtypes(benchmark::State& state) {
+    auto sigs = g_sigs;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        const std::string marker = "subtype" + std::to_string(i) + "/main.xml";
+        SignatureDefinition def;
+        def.name = "ZIPSUB" + std::to_string(i);
+        if (Tree) {
+            def.hex_head = "504B0304";
+            def.text_pattern = marker;
+        }
+        else {
+            def.type = SignatureType::TEXT;
+            def.text_pattern = "\\x50\\x4B\\x03\\x04.*?" + marker;
+        }
+        sigs.push_back(def);
+    }
+    ScannerT scanner;
+    scanner.prepare(sigs);
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+#define SUBTYPE_ARGS ->Arg(0)->Arg(8)->Arg(32)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Subtypes, Re2Scanner, false)->Name("Subtypes/RE2/Flat") SUBTYPE_ARGS;
+BENCHMARK_TEMPLATE(BM_Subtypes, Re2Scanner, true)->Name("Subtypes/RE2/Tree") SUBTYPE_ARGS;
+BENCHMARK_TEMPLATE(BM_Subtypes, BoostScanner, false)->Name("Subtypes/Boost/Flat") SUBTYPE_ARGS;
+BENCHMARK_TEMPLATE(BM_Subtypes, BoostScanner, true)->Name("Subtypes/Boost/Tree") SUBTYPE_ARGS;
+BENCHMARK_TEMPLATE(BM_Subtypes, HsScanner, false)->Name("Subtypes/Hyperscan/Flat") SUBTYPE_ARGS;
+BENCHMARK_TEMPLATE(BM_Subtypes, HsScanner, true)->Name("Subtypes/Hyperscan/Tree") SUBTYPE_ARGS;
+#undef SUBTYPE_ARGS
+
+// Bounded gaps (max_gap) on every binary head/tail and head/marker signature: Arg is the
+// gap, 0 = the unbounded `head.*?tail` patterns. A head whose tail is further away costs
+// a window of Arg bytes instead of a search to the end of the buffer.
+template <typename ScannerT>
+void BM_Bounded(benchmark::State& state) {
+    auto sigs = g_sigs;
+    for (auto& s : sigs)
+        if (s.type == SignatureType::BINARY && !s.hex_head.empty() && (!s.hex_tail.empty() || !s.text_pattern.empty()))
+            s.max_gap = static_cast<uint64_t>(state.range(0));
+    ScannerT scanner;
+    scanner.prepare(sigs);
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+#define BOUNDED_ARGS ->Arg(0)->Arg(64)->Arg(4096)->Arg(65535)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Bounded, Re2Scanner)->Name("Bounded/RE2") BOUNDED_ARGS;
+BENCHMARK_TEMPLATE(BM_Bounded, BoostScanner)->Name("Bounded/Boost") BOUNDED_ARGS;
+BENCHMARK_TEMPLATE(BM_Bounded, HsScanner)->Name("Bounded/Hyperscan") BOUNDED_ARGS;
+#undef BOUNDED_ARGS
+
+// File-type magics: the head of every binary signature alone, searched through the whole
+// file (Search) vs. anchored at offset 0 (Offset), where each is one masked compare.
+template <typename ScannerT, bool Anchored>
+void BM_Anchored(benchmark::State& state) {
+    std::vector<SignatureDefinition> sigs;
+    for (const auto& s : g_sigs) {
+        if (s.type != SignatureType::BINARY || s.hex_head.empty()) continue;
+        SignatureDefinition def;
+        def.name = s.name;
+        def.hex_head = s.hex_head;
+        if (Anchored) def.offset = 0;
+        sigs.push_back(def);
+    }
+    ScannerT scanner;
+    scanner.prepare(sigs);
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+BENCHMARK_TEMPLATE(BM_Anchored, Re2Scanner, false)->Name("Anchored/RE2/Search")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Anchored, Re2Scanner, true)->Name("Anchored/RE2/Offset")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Anchored, BoostScanner, false)->Name("Anchored/Boost/Search")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Anchored, BoostScanner, true)->Name("Anchored/Boost/Offset")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Anchored, HsScanner, false)->Name("Anchored/Hyperscan/Search")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Anchored, HsScanner, true)->Name("Anchored/Hyperscan/Offset")->Unit(benchmark::kMillisecond);
+
+// Every count of every file (Scan) vs. the first-match type of each (Classify), which
+// stops reading a file once its type is known.
+template <typename ScannerT, bool Classify>
+void BM_Classify(benchmark::State& state) {
+    ScannerT scanner;
+    scanner.prepare(g_sigs);
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) {
+            if (Classify) scanner.classify(f.content.data(), f.content.size(), stats);
+            else scanner.scan(f.content.data(), f.content.size(), stats);
+        }
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+BENCHMARK_TEMPLATE(BM_Classify, Re2Scanner, false)->Name("Classify/RE2/Scan")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, Re2Scanner, true)->Name("Classify/RE2/Classify")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, BoostScanner, false)->Name("Classify/Boost/Scan")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, BoostScanner, true)->Name("Classify/Boost/Classify")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, HsScanner, false)->Name("Classify/Hyperscan/Scan")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, HsScanner, true)->Name("Classify/Hyperscan/Classify")->Unit(benchmark::kMillisecond);
+
+// RE2 counting: RE2::Set, then one pass per matched pattern (TwoPhase), vs. one pass for
+// the leading literals of every signature with RE2 confirming at each (SinglePass).
+template <Re2Scanner::Counting Counting>
+void BM_Re2Counting(benchmark::State& state) {
+    Re2Scanner scanner(Counting);
+    scanner.prepare(g_sigs);
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+BENCHMARK_TEMPLATE(BM_Re2Counting, Re2Scanner::Counting::TWO_PHASE)->Name("RE2/Counting/TwoPhase")->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Re2Counting, Re2Scanner::Counting::SINGLE_PASS)->Name("RE2/Counting/SinglePass")->Unit(benchmark::kMillisecond);
+
+// The shipped set grown to `count` signatures with random 4-byte magics, every other one
+// with a 2-byte tail.
+std::vector<SignatureDefinition> GrownSignatures(int64_t count) {
+    auto sigs = g_sigs;
+    std::mt19937 rng(42);
+    auto hex = [&](int bytes) {
+        static const char digits[] = "0123456789ABCDEF";
+        std::string out;
+        for (int i = 0; i < bytes; ++i) {
+            const unsigned b = rng() & 0xFF;
+            out += digits[b >> 4];
+            out += digits[b & 0xF];
+        }
+        return out;
+    };
+    for (int64_t i = static_cast<int64_t>(sigs.size()); i < count; ++i) {
+        SignatureDefinition def;
+        def.name = "SYN" + std::to_string(i);
+        def.hex_head = hex(4);
+        if (i % 2) def.hex_tail = hex(2);
+        sigs.push_back(def);
+    }
+    return sigs;
+}
+
+// Boost as the signature set grows to Arg signatures (GrownSignatures). One regex_search
+// pass per signature (PerSignature) vs. one pass for every leading literal and one
+// alternation for the rest (Combined).
+template <BoostScanner::Matching Matching>
+void BM_BoostMatching(benchmark::State& state) {
+    BoostScanner scanner(Matching);
+    scanner.prepare(GrownSignatures(state.range(0)));
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+#define MATCHING_ARGS ->Arg(27)->Arg(100)->Arg(500)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_BoostMatching, BoostScanner::Matching::PER_SIGNATURE)->Name("Boost/Matching/PerSignature") MATCHING_ARGS;
+BENCHMARK_TEMPLATE(BM_BoostMatching, BoostScanner::Matching::COMBINED)->Name("Boost/Matching/Combined") MATCHING_ARGS;
+#undef MATCHING_ARGS
+
+// The literal pass of LiteralScanner by kernel, for Arg signatures (GrownSignatures): one
+// position at a time against the pair bitmap (Scalar) vs. Teddy over 16 (SSSE3) or 32
+// (AVX2) positions. At 100 the tables pass too much and every kernel runs the scalar one;
+// a kernel the CPU lacks runs the best one it has.
+template <LeadingLiterals::Kernel Kernel>
+void BM_LiteralKernel(benchmark::State& state) {
+    LiteralScanner scanner(Kernel);
+    scanner.prepare(GrownSignatures(state.range(0)));
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner.scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+#define KERNEL_ARGS ->Arg(27)->Arg(100)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_LiteralKernel, LeadingLiterals::Kernel::SCALAR)->Name("Literal/Kernel/Scalar") KERNEL_ARGS;
+BENCHMARK_TEMPLATE(BM_LiteralKernel, LeadingLiterals::Kernel::SSSE3)->Name("Literal/Kernel/SSSE3") KERNEL_ARGS;
+BENCHMARK_TEMPLATE(BM_LiteralKernel, LeadingLiterals::Kernel::AVX2)->Name("Literal/Kernel/AVX2") KERNEL_ARGS;
+#undef KERNEL_ARGS
+
+// The regex engine over all Arg signatures (GrownSignatures: the added ones without a tail
+// are plain magics) vs. the hybrid engine, where those and the shipped magics go to the
+// literal pass and the engine gets the rest.
+template <EngineType Regex, bool Hybrid>
+void BM_Hybrid(benchmark::State& state) {
+    std::unique_ptr<Scanner> scanner = Hybrid ? std::make_unique<HybridScanner>(Regex) : Scanner::create(Regex);
+    scanner->prepare(GrownSignatures(state.range(0)));
+
+    for (auto _ : state) {
+        ScanStats stats;
+        for (const auto& f : g_files) scanner->scan(f.content.data(), f.content.size(), stats);
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+}
+
+#define HYBRID_ARGS ->Arg(27)->Arg(500)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Hybrid, EngineType::HYPERSCAN, false)->Name("Hybrid/Hyperscan/Whole") HYBRID_ARGS;
+BENCHMARK_TEMPLATE(BM_Hybrid, EngineType::HYPERSCAN, true)->Name("Hybrid/Hyperscan/Split") HYBRID_ARGS;
+BENCHMARK_TEMPLATE(BM_Hybrid, EngineType::RE2, false)->Name("Hybrid/RE2/Whole") HYBRID_ARGS;
+BENCHMARK_TEMPLATE(BM_Hybrid, EngineType::RE2, true)->Name("Hybrid/RE2/Split") HYBRID_ARGS;
+#undef HYBRID_ARGS
+
+// One logical buffer held as separately allocated pieces of Arg KB (decompressed blocks,
+// ring-buffer segments): copied into one buffer for scan() vs. scan_vectored(). The
+// dataset files are joined end to end and cut into pieces. Hyperscan scans the pieces
+// where they lie (HS_MODE_VECTORED); RE2 and Boost join them below VECTORED_JOIN_BYTES,
+// so their two rows should agree.
+template <EngineType Engine, bool Vectored>
+void BM_Vectored(benchmark::State& state) {
+    auto scanner = Scanner::create(Engine);
+    scanner->prepare(g_sigs);
+    const size_t piece = static_cast<size_t>(state.range(0)) * 1024;
+    std::vector<std::string> pieces(1);
+    for (const auto& f : g_files) {
+        for (size_t off = 0; off < f.content.size();) {
+            if (pieces.back().size() == piece) pieces.emplace_back();
+            const size_t take = std::min(piece - pieces.back().size(), f.content.size() - off);
+            pieces.back().append(f.content, off, take);
+            off += take;
+        }
+    }
+    std::vector<ScanSpan> spans;
+    for (const auto& p : pieces) spans.push_back({ p.data(), p.size() });
+
+    for (auto _ : state) {
+        ScanStats stats;
+        if (Vectored) {
+            scanner->scan_vectored(spans, stats);
+        }
+        else {
+            std::string joined;
+            joined.reserve(g_total_bytes);
+            for (const auto& p : pieces) joined += p;
+            scanner->scan(joined.data(), joined.size(), stats);
+        }
+        benchmark::DoNotOptimize(stats.hits.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * g_total_bytes));
+    state.counters["pieces"] = static_cast<double>(pieces.size());
+}
+
+#define VECTORED_ARGS ->Arg(64)->Arg(4096)->Unit(benchmark::kMillisecond)
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::HYPERSCAN, false)->Name("Vectored/Hyperscan/Joined") VECTORED_ARGS;
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::HYPERSCAN, true)->Name("Vectored/Hyperscan/Pieces") VECTORED_ARGS;
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::RE2, false)->Name("Vectored/RE2/Joined") VECTORED_ARGS;
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::RE2, true)->Name("Vectored/RE2/Pieces") VECTORED_ARGS;
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::BOOST, false)->Name("Vectored/Boost/Joined") VECTORED_ARGS;
+BENCHMARK_TEMPLATE(BM_Vectored, EngineType::BOOST, true)->Name("Vectored/Boost/Pieces") VECTORED_ARGS;
+#undef VECTORED_ARGS
+
 BENCHMARK_TEMPLATE(BM_Scan, Re2Scanner)->Name("RE2")->Unit(benchmark::kMillisecond)->Threads(1)->Threads(8);
 BENCHMARK_TEMPLATE(BM_Scan, BoostScanner)->Name("Boost")->Unit(benchmark::kMillisecond)->Threads(1)->Threads(8);
 BENCHMARK_TEMPLATE(BM_Scan, HsScanner)->Name("Hyperscan")->Unit(benchmark::kMillisecond)->Threads(1)->Threads(8);
+BENCHMARK_TEMPLATE(BM_Scan, LiteralScanner)->Name("Literal")->Unit(benchmark::kMillisecond)->Threads(1)->Threads(8);
+BENCHMARK_TEMPLATE(BM_Scan, HybridScanner)->Name("Hybrid")->Unit(benchmark::kMillisecond)->Threads(1)->Threads(8);
 
 int main(int argc, char** argv) {
     g_sigs = ConfigLoader::load("signatures.json");
@@ -162,6 +859,7 @@ int main(int argc, char** argv) {
         std::cerr << "[Fatal] Failed to load signatures.json\n";
         return 1;
     }
+    fs::remove_all(BENCH_HS_CACHE_DIR);
 
     std::cout << ">>> Preparing Benchmark Data (Mix=0.2)...\n";
     LoadDataset("bench_data_stress", 0.2);
@@ -172,6 +870,8 @@ int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
     if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
     ::benchmark::RunSpecifiedBenchmarks();
+    fs::remove_all(BENCH_WALK_DIR);
+    fs::remove_all(BENCH_IO_DIR);
 
     return 0;
 }
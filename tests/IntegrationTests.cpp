@@ -3,7 +3,9 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <algorithm>
+#include <random>
 
 #include "Scanner.h"
 #include "ConfigLoader.h"
@@ -33,8 +35,7 @@ protected:
     void TearDown() override { fs::remove_all(temp_dir); }
 
     int GetCount(const ScanStats& stats, const std::string& name) {
-        auto it = stats.counts.find(name);
-        return (it != stats.counts.end()) ? it->second : 0;
+        return stats.get(name);
     }
 
     ScanStats ScanPath(const fs::path& path) {
@@ -70,7 +71,7 @@ TEST_F(IntegrationTest, Folder_Scan_With_Generator) {
     // Deduction is tested separately in DeductionTest and works correctly on real-world files.
 
     std::cout << "--- Scan Report (seed=" << TEST_SEED << ") ---\n";
-    for (auto const& [name, count] : actual.counts) std::cout << name << ": " << count << "\n";
+    for (auto const& [name, count] : actual.totals()) std::cout << name << ": " << count << "\n";
 
     for (auto const& [type_name, count] : expected.counts) {
         if (count == 0) continue;
@@ -95,7 +96,7 @@ TEST_F(IntegrationTest, Bin_Concat_Scan) {
     // NOTE: apply_deduction omitted — see Folder_Scan_With_Generator for explanation.
 
     std::cout << "--- BIN Scan Report (seed=" << TEST_SEED << ") ---\n";
-    for (auto const& [name, count] : actual.counts) std::cout << name << ": " << count << "\n";
+    for (auto const& [name, count] : actual.totals()) std::cout << name << ": " << count << "\n";
 
     for (auto const& [type_name, count] : expected.counts) {
         if (count == 0) continue;
@@ -112,7 +113,7 @@ TEST_F(IntegrationTest, Pcap_Dump_Scan) {
     // NOTE: apply_deduction omitted — see Folder_Scan_With_Generator for explanation.
 
     std::cout << "--- PCAP Scan Report (seed=" << TEST_SEED << ") ---\n";
-    for (auto const& [name, count] : actual.counts) std::cout << name << ": " << count << "\n";
+    for (auto const& [name, count] : actual.totals()) std::cout << name << ": " << count << "\n";
 
     for (auto const& [type_name, count] : expected.counts) {
         if (count == 0) continue;
@@ -120,3 +121,233 @@ TEST_F(IntegrationTest, Pcap_Dump_Scan) {
             << "Not found in PCAP: " << type_name;
     }
 }
+
+// Intra-file parallelism: segment counts must equal one sequential scan for every engine,
+// including matches cut by a segment boundary and HEAD_TAIL pairs many segments apart.
+TEST_F(IntegrationTest, Parallel_Segments_Match_Single_Thread) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "parallel_test.bin";
+    fs::path pcap_path = temp_dir / "parallel_test.pcap";
+    gen.generate_count(bin_path, 10, OutputMode::BIN, 0.2, TEST_SEED);
+    gen.generate_count(pcap_path, 10, OutputMode::PCAP, 0.2, TEST_SEED);
+
+    for (EngineType type : { EngineType::BOOST, EngineType::RE2, EngineType::LITERAL, EngineType::HYPERSCAN }) {
+        auto engine = Scanner::create(type);
+        engine->prepare(sigs);
+        for (const auto& path : { bin_path, pcap_path }) {
+            boost::iostreams::mapped_file_source mmap(path.string());
+            ASSERT_TRUE(mmap.is_open());
+            ScanStats single;
+            engine->scan(mmap.data(), mmap.size(), single);
+
+            for (size_t segment : { size_t{4096}, size_t{65536}, size_t{1024 * 1024} }) {
+                ScanStats parallel;
+                engine->scan_parallel(mmap.data(), mmap.size(), parallel, 4, segment);
+                EXPECT_EQ(parallel.totals(), single.totals())
+                    << "Engine: " << engine->name() << ", file: " << path.filename()
+                    << ", segment: " << segment;
+            }
+        }
+    }
+}
+
+// Same check on a seeded multi-megabyte dump with bare ZIP/OLE headers no child claims:
+// an unpaired head or a header without its discriminator must not be counted twice or lost
+// when a segment boundary falls next to it.
+TEST_F(IntegrationTest, Parallel_Unclaimed_Headers_Match_Single_Thread) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "parallel_large.bin";
+    gen.generate_size(bin_path, 16, OutputMode::BIN, 0.3, TEST_SEED);
+
+    std::string data;
+    {
+        boost::iostreams::mapped_file_source mmap(bin_path.string());
+        ASSERT_TRUE(mmap.is_open());
+        data.assign(mmap.data(), mmap.size());
+    }
+    const std::string ole("\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1", 8);
+    const std::string zip("PK\x03\x04", 4);
+    const std::string eocd("PK\x05\x06", 4);
+    const size_t mb = 1024 * 1024;
+
+    // Headers straddling 1 MB segment boundaries and at seeded offsets inside the dump.
+    std::mt19937 rng(TEST_SEED);
+    std::uniform_int_distribution<size_t> offset(0, data.size() - 64);
+    for (size_t i = 1; i < 8; ++i) {
+        data.replace(i * mb - 3, ole.size(), ole);
+        data.replace(i * 2 * mb - 2, zip.size(), zip);
+    }
+    for (int i = 0; i < 16; ++i) {
+        data.replace(offset(rng), ole.size(), ole);
+        data.replace(offset(rng), zip.size(), zip);
+    }
+    // A tail past every generated discriminator: these heads can only stand alone.
+    data += std::string(4096, '\0') + ole + std::string(100, '\0') + zip + std::string(5000, 'z')
+          + eocd + std::string(100, '\0') + zip;
+
+    for (EngineType type : { EngineType::BOOST, EngineType::RE2, EngineType::LITERAL, EngineType::HYPERSCAN }) {
+        auto engine = Scanner::create(type);
+        engine->prepare(sigs);
+        ScanStats single;
+        engine->scan(data.data(), data.size(), single);
+        EXPECT_GT(single.get("OLE"), 0) << "Engine: " << engine->name();
+        EXPECT_GT(single.get("ZIP"), 0) << "Engine: " << engine->name();
+
+        for (size_t segment : { size_t{65536}, mb, 3 * mb }) {
+            ScanStats parallel;
+            engine->scan_parallel(data.data(), data.size(), parallel, 4, segment);
+            EXPECT_EQ(parallel.totals(), single.totals())
+                << "Engine: " << engine->name() << ", segment: " << segment;
+        }
+    }
+}
+
+// RE2 single-pass counting (leads found in one pass, matches confirmed there) must count
+// exactly what the two-phase Set filter + per-pattern passes count.
+TEST_F(IntegrationTest, Re2_Single_Pass_Matches_Two_Phase) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "re2_counting.bin";
+    fs::path pcap_path = temp_dir / "re2_counting.pcap";
+    gen.generate_count(bin_path, 20, OutputMode::BIN, 0.2, TEST_SEED);
+    gen.generate_count(pcap_path, 20, OutputMode::PCAP, 0.2, TEST_SEED);
+
+    Re2Scanner single(Re2Scanner::Counting::SINGLE_PASS), two_phase(Re2Scanner::Counting::TWO_PHASE);
+    single.prepare(sigs);
+    two_phase.prepare(sigs);
+    for (const auto& path : { bin_path, pcap_path }) {
+        boost::iostreams::mapped_file_source mmap(path.string());
+        ASSERT_TRUE(mmap.is_open());
+        ScanStats a, b;
+        single.scan(mmap.data(), mmap.size(), a);
+        two_phase.scan(mmap.data(), mmap.size(), b);
+        EXPECT_FALSE(b.totals().empty());
+        EXPECT_EQ(a.totals(), b.totals()) << "file: " << path.filename();
+    }
+}
+
+// Every literal kernel must count what the scalar one counts, and that what the two-phase
+// RE2 count gives: short, case-folded and overlapping literals included.
+TEST_F(IntegrationTest, Literal_Kernels_Match_Scalar) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "literal_kernels.bin";
+    fs::path pcap_path = temp_dir / "literal_kernels.pcap";
+    gen.generate_count(bin_path, 20, OutputMode::BIN, 0.2, TEST_SEED);
+    gen.generate_count(pcap_path, 20, OutputMode::PCAP, 0.2, TEST_SEED);
+
+    auto all = sigs;
+    auto text = [&](const std::string& name, const std::string& pattern) {
+        SignatureDefinition def;
+        def.name = name;
+        def.type = SignatureType::TEXT;
+        def.text_pattern = pattern;
+        all.push_back(def);
+    };
+    text("LT", "<");
+    text("ENTITY", "&[a-z]+;");
+    text("DATA_WORD", "data\\w*");
+    text("AAA", "aaa");
+
+    using Kernel = LeadingLiterals::Kernel;
+    Re2Scanner reference(Re2Scanner::Counting::TWO_PHASE);
+    reference.prepare(all);
+    for (Kernel kernel : { Kernel::SCALAR, Kernel::SSSE3, Kernel::AVX2 }) {
+        LiteralScanner engine(kernel);
+        engine.prepare(all);
+        for (const auto& path : { bin_path, pcap_path }) {
+            boost::iostreams::mapped_file_source mmap(path.string());
+            ASSERT_TRUE(mmap.is_open());
+            ScanStats a, b;
+            engine.scan(mmap.data(), mmap.size(), a);
+            reference.scan(mmap.data(), mmap.size(), b);
+            EXPECT_FALSE(b.totals().empty());
+            EXPECT_EQ(a.totals(), b.totals()) << "kernel: " << static_cast<int>(kernel) << ", file: " << path.filename();
+        }
+    }
+}
+
+// The hybrid engine splits the set between the literal pass and the regex engine; merged,
+// block, stream, segment and classify results must be that engine's over the whole set.
+TEST_F(IntegrationTest, Hybrid_Matches_Regex_Engine) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "hybrid.bin";
+    fs::path pcap_path = temp_dir / "hybrid.pcap";
+    gen.generate_count(bin_path, 20, OutputMode::BIN, 0.2, TEST_SEED);
+    gen.generate_count(pcap_path, 20, OutputMode::PCAP, 0.2, TEST_SEED);
+
+    std::set<std::string> parents;
+    for (const auto& s : sigs)
+        if (!s.deduct_from.empty()) parents.insert(s.deduct_from);
+    size_t literal = 0;
+    for (const auto& s : sigs) literal += HybridScanner::literal_only(s, parents);
+    EXPECT_GT(literal, 0u);
+    EXPECT_LT(literal, sigs.size());
+
+    for (EngineType regex : { EngineType::RE2, EngineType::HYPERSCAN }) {
+        HybridScanner hybrid(regex);
+        hybrid.prepare(sigs);
+        auto reference = Scanner::create(regex);
+        reference->prepare(sigs);
+        ASSERT_EQ(hybrid.signature_names()->size(), reference->signature_names()->size());
+        for (const auto& path : { bin_path, pcap_path }) {
+            boost::iostreams::mapped_file_source mmap(path.string());
+            ASSERT_TRUE(mmap.is_open());
+            ScanStats expected, block, streamed, parallel, type, expected_type;
+            reference->scan(mmap.data(), mmap.size(), expected);
+            hybrid.scan(mmap.data(), mmap.size(), block);
+            EXPECT_FALSE(expected.totals().empty());
+            EXPECT_EQ(block.totals(), expected.totals()) << hybrid.name() << ", file: " << path.filename();
+
+            // Chunked streams can differ from a block scan (unbounded text), so stream against stream.
+            ScanStats expected_streamed;
+            for (auto* engine : { static_cast<Scanner*>(&hybrid), reference.get() }) {
+                auto stream = engine->open_stream(engine == &hybrid ? streamed : expected_streamed);
+                for (size_t at = 0; at < mmap.size(); at += 65536)
+                    stream->write(mmap.data() + at, std::min<size_t>(65536, mmap.size() - at));
+            }
+            EXPECT_EQ(streamed.totals(), expected_streamed.totals()) << hybrid.name() << ", stream: " << path.filename();
+
+            hybrid.fork()->scan_parallel(mmap.data(), mmap.size(), parallel, 4, 65536);
+            EXPECT_EQ(parallel.totals(), expected.totals()) << hybrid.name() << ", parallel: " << path.filename();
+
+            hybrid.classify(mmap.data(), mmap.size(), type);
+            reference->classify(mmap.data(), mmap.size(), expected_type);
+            EXPECT_EQ(type.totals(), expected_type.totals()) << hybrid.name() << ", classify: " << path.filename();
+        }
+    }
+}
+
+TEST_F(IntegrationTest, Boost_Combined_Matches_Per_Signature) {
+    DataSetGenerator gen;
+    fs::path bin_path = temp_dir / "boost_matching.bin";
+    fs::path pcap_path = temp_dir / "boost_matching.pcap";
+    gen.generate_count(bin_path, 20, OutputMode::BIN, 0.2, TEST_SEED);
+    gen.generate_count(pcap_path, 20, OutputMode::PCAP, 0.2, TEST_SEED);
+
+    // Signatures without a leading literal go through the combined alternation, one of
+    // them in a deduct_from relation.
+    auto all = sigs;
+    auto text = [&](const std::string& name, const std::string& pattern, const std::string& parent = "") {
+        SignatureDefinition def;
+        def.name = name;
+        def.type = SignatureType::TEXT;
+        def.text_pattern = pattern;
+        def.deduct_from = parent;
+        all.push_back(def);
+    };
+    text("TAG", "<[a-z]+>");
+    text("WORDS", "(?:data|file)\\w+");
+    text("ANY_HTML", "[<]html", "HTML");
+
+    BoostScanner combined(BoostScanner::Matching::COMBINED), alone(BoostScanner::Matching::PER_SIGNATURE);
+    combined.prepare(all);
+    alone.prepare(all);
+    for (const auto& path : { bin_path, pcap_path }) {
+        boost::iostreams::mapped_file_source mmap(path.string());
+        ASSERT_TRUE(mmap.is_open());
+        ScanStats a, b;
+        combined.scan(mmap.data(), mmap.size(), a);
+        alone.scan(mmap.data(), mmap.size(), b);
+        EXPECT_FALSE(b.totals().empty());
+        EXPECT_EQ(a.totals(), b.totals()) << "file: " << path.filename();
+    }
+}
@@ -5,16 +5,29 @@
 #include <algorithm>
 #include <fstream>
 #include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+#include <boost/regex.hpp>
 
 #include "Scanner.h"
 #include "ConfigLoader.h"
+#include "WorkScheduler.h"
+#include "BoundedQueue.h"
+#include "DirWalker.h"
+#include "FileReader.h"
+#include "ResultCache.h"
+#include "ContentDedup.h"
+#include "KnownFileIndex.h"
+#include "EngineTuner.h"
 
 // ==========================================
 // 1. СИГНАТУРЫ ДЛЯ ТЕСТОВ
 // ==========================================
 static const std::vector<SignatureDefinition> TEST_SIGS = {
-    { "PDF", "25504446", "2525454F46", "", SignatureType::BINARY },
-    { "ZIP", "504B0304", "", "", SignatureType::BINARY },
+    { "PDF", "25504446", "2525454F46", "", SignatureType::BINARY, "" },
+    { "ZIP", "504B0304", "", "", SignatureType::BINARY, "" },
     { "DOCX", "504B0304", "", "word/document.xml", SignatureType::BINARY, "ZIP" }
 };
 
@@ -31,8 +44,7 @@ protected:
     }
 
     int GetCount(const ScanStats& stats, const std::string& name) {
-        auto it = stats.counts.find(name);
-        return (it != stats.counts.end()) ? it->second : 0;
+        return stats.get(name);
     }
 
     void RunVerify(const std::string& data, const std::string& type_name, int expected_count) {
@@ -45,7 +57,7 @@ protected:
 template <typename T>
 T ScannerTest<T>::scanner;
 
-using ScannerTypes = ::testing::Types<Re2Scanner, BoostScanner, HsScanner>;
+using ScannerTypes = ::testing::Types<Re2Scanner, BoostScanner, HsScanner, LiteralScanner, HybridScanner>;
 TYPED_TEST_SUITE(ScannerTest, ScannerTypes);
 
 // ==========================================
@@ -62,19 +74,183 @@ TYPED_TEST(ScannerTest, Detection_ZIP) {
     this->RunVerify(data, "ZIP", 1);
 }
 
-TYPED_TEST(ScannerTest, Office_ZIP_And_DOCX_Both_Detected) {
+TYPED_TEST(ScannerTest, Office_ZIP_Attributed_To_DOCX) {
     std::string data = "\x50\x4B\x03\x04...word/document.xml...";
     ScanStats stats;
     this->scanner.scan(data.data(), data.size(), stats);
-    EXPECT_GE(this->GetCount(stats, "ZIP"), 1);
-    EXPECT_EQ(this->GetCount(stats, "DOCX"), 1);
+    EXPECT_EQ(this->GetCount(stats, "ZIP"), 0) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(stats, "DOCX"), 1) << "Engine: " << this->scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Deduction_By_Position_Within_File) {
+    // A DOCX, then a plain ZIP: only the ZIP header that holds the marker is a DOCX.
+    std::string data = "\x50\x4B\x03\x04...word/document.xml..." + std::string(64, '\0') + "\x50\x4B\x03\x04 plain";
+    ScanStats stats;
+    this->scanner.scan(data.data(), data.size(), stats);
+    EXPECT_EQ(this->GetCount(stats, "ZIP"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(stats, "DOCX"), 1) << "Engine: " << this->scanner.name();
+
+    // A DOCX marker in one file never takes a ZIP from another.
+    ScanStats two_files;
+    std::string zip = "\x50\x4B\x03\x04 plain";
+    std::string marker = "no header, word/document.xml";
+    this->scanner.scan(zip.data(), zip.size(), two_files);
+    this->scanner.scan(marker.data(), marker.size(), two_files);
+    EXPECT_EQ(this->GetCount(two_files, "ZIP"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(two_files, "DOCX"), 0) << "Engine: " << this->scanner.name();
+
+    // Streams resolve the same way, across chunk boundaries.
+    ScanStats streamed;
+    auto stream = this->scanner.open_stream(streamed);
+    for (size_t off = 0; off < data.size(); off += 5) stream->write(data.data() + off, std::min<size_t>(5, data.size() - off));
+    stream->close();
+    EXPECT_EQ(streamed.totals(), stats.totals()) << "Engine: " << this->scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Deduction_By_Position_On_Every_Path) {
+    const std::vector<SignatureDefinition> sigs = {
+        { "ZIP", "504B0304", "", "", SignatureType::BINARY, "" },
+        { "DOCX", "504B0304", "", "word/document.xml", SignatureType::BINARY, "ZIP" },
+        { "XLSX", "504B0304", "", "xl/workbook.xml", SignatureType::BINARY, "ZIP" },
+        { "BOX", "B0B0", "E0E0", "", SignatureType::BINARY, "" },
+        { "ITEM", "B0B0", "", "item", SignatureType::BINARY, "BOX" }
+    };
+    TypeParam scanner;
+    scanner.prepare(sigs);
+    // Two children on one ZIP header take it once, the next header stays a ZIP. The BOX
+    // match holding the ITEM is the ITEM's; the BOX search resumes after the ITEM and
+    // finds a second head before the tail. Counts alone would give ZIP 0 and BOX 0.
+    const std::string zip = "\x50\x4B\x03\x04";
+    std::string data = zip + " word/document.xml xl/workbook.xml " + zip + " plain ";
+    data += "\xB0\xB0 item \xB0\xB0 " + std::string(300, '.') + "\xE0\xE0";
+
+    ScanStats block;
+    scanner.scan(data.data(), data.size(), block);
+    EXPECT_EQ(block.get("ZIP"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("DOCX"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("XLSX"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("BOX"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("ITEM"), 1) << "Engine: " << scanner.name();
+
+    for (size_t chunk : { size_t{1}, size_t{5}, data.size() }) {
+        ScanStats streamed;
+        auto stream = scanner.open_stream(streamed);
+        for (size_t off = 0; off < data.size(); off += chunk)
+            stream->write(data.data() + off, std::min(chunk, data.size() - off));
+        stream->close();
+        EXPECT_EQ(streamed.totals(), block.totals()) << "Engine: " << scanner.name() << ", chunk: " << chunk;
+    }
+    for (size_t segment : { size_t{16}, size_t{100} }) {
+        ScanStats parallel;
+        scanner.scan_parallel(data.data(), data.size(), parallel, 4, segment);
+        EXPECT_EQ(parallel.totals(), block.totals()) << "Engine: " << scanner.name() << ", segment: " << segment;
+    }
+    const std::vector<ScanSpan> spans = { { data.data(), 30 }, { data.data() + 30, data.size() - 30 } };
+    ScanStats vectored;
+    scanner.scan_vectored(spans, vectored);
+    EXPECT_EQ(vectored.totals(), block.totals()) << "Engine: " << scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Tree_Child_Only_After_Magic) {
+    // DOCX is evaluated only after a ZIP header: a marker before it does not count.
+    std::string data = "word/document.xml, then \x50\x4B\x03\x04 plain";
+    ScanStats stats;
+    this->scanner.scan(data.data(), data.size(), stats);
+    EXPECT_EQ(this->GetCount(stats, "ZIP"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(stats, "DOCX"), 0) << "Engine: " << this->scanner.name();
+
+    // Same children as the full `head.*?text_pattern` patterns the stream runs.
+    std::string mixed = "word/document.xml \x50\x4B\x03\x04 a word/document.xml \x50\x4B\x03\x04"
+                        "\x50\x4B\x03\x04 word/document.xml word/document.xml \x50\x4B\x03\x04 end";
+    ScanStats block, streamed;
+    this->scanner.scan(mixed.data(), mixed.size(), block);
+    auto stream = this->scanner.open_stream(streamed);
+    stream->write(mixed.data(), mixed.size());
+    stream->close();
+    EXPECT_EQ(this->GetCount(block, "DOCX"), 2) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(streamed, "DOCX"), 2) << "Engine: " << this->scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Bounded_Gap_Length_And_Offset) {
+    const std::vector<SignatureDefinition> sigs = {
+        { "GAP", "AA11", "BB22", "", SignatureType::BINARY, "", 4 },
+        { "LEN", "CC33", "", "end", SignatureType::BINARY, "", 0, 10 },
+        { "OFF", "DD44", "", "", SignatureType::BINARY, "", 0, 0, 16 }
+    };
+    TypeParam scanner;
+    scanner.prepare(sigs);
+    // One of each within bounds: the second GAP is 12 bytes apart, the first LEN marker is
+    // 5 bytes from its head (too short, the match runs on to the second marker), the
+    // second OFF ends past 16 bytes.
+    std::string data = std::string("\xDD\x44") + "\xAA\x11" "xx\xBB\x22" + "\xCC\x33" "end" + "....."
+                     + "\xAA\x11" "0123456789ab\xBB\x22" + " \xCC\x33" " 0123456 end" + "\xDD\x44";
+    ScanStats block, streamed;
+    scanner.scan(data.data(), data.size(), block);
+    auto stream = scanner.open_stream(streamed);
+    for (size_t i = 0; i < data.size(); i += 3) stream->write(data.data() + i, std::min<size_t>(3, data.size() - i));
+    stream->close();
+    for (const auto* stats : {&block, &streamed}) {
+        EXPECT_EQ(stats->get("GAP"), 1) << "Engine: " << scanner.name();
+        EXPECT_EQ(stats->get("LEN"), 1) << "Engine: " << scanner.name();
+        EXPECT_EQ(stats->get("OFF"), 1) << "Engine: " << scanner.name();
+    }
+}
+
+TYPED_TEST(ScannerTest, Anchored_Offsets_And_Masked_Bytes) {
+    const std::vector<SignatureDefinition> sigs = {
+        { "START", "89504E47", "", "", SignatureType::BINARY, "", 0, 0, 0, 0 },
+        { "AT4", "4D5A????50450000", "", "", SignatureType::BINARY, "", 0, 0, 0, 4 },
+        { "EOCD", "504B0506", "", "", SignatureType::BINARY, "", 0, 0, 0, -22 },
+        { "MASKED", "4D5A????50450000", "", "", SignatureType::BINARY, "" }
+    };
+    TypeParam scanner;
+    scanner.prepare(sigs);
+    // Anchors count once per file, at their offset only; the searched masked head counts
+    // both of its occurrences.
+    const std::string pe("MZ\x90\x00PE\x00\x00", 8);
+    std::string data = "\x89PNG" + pe + "\x89PNG" + pe + std::string("PK\x05\x06", 4) + std::string(18, '\0');
+    ScanStats block, streamed;
+    scanner.scan(data.data(), data.size(), block);
+    auto stream = scanner.open_stream(streamed);
+    for (size_t i = 0; i < data.size(); i += 3) stream->write(data.data() + i, std::min<size_t>(3, data.size() - i));
+    stream->close();
+    for (const auto* stats : {&block, &streamed}) {
+        EXPECT_EQ(stats->get("START"), 1) << "Engine: " << scanner.name();
+        EXPECT_EQ(stats->get("AT4"), 1) << "Engine: " << scanner.name();
+        EXPECT_EQ(stats->get("EOCD"), 1) << "Engine: " << scanner.name();
+        EXPECT_EQ(stats->get("MASKED"), 2) << "Engine: " << scanner.name();
+    }
+    // Nothing at the anchors: a shifted copy matches none of them.
+    const std::string shifted = " " + data + " ";
+    ScanStats other;
+    scanner.scan(shifted.data(), shifted.size(), other);
+    EXPECT_EQ(other.get("START") + other.get("AT4") + other.get("EOCD"), 0) << "Engine: " << scanner.name();
+    EXPECT_EQ(other.get("MASKED"), 2) << "Engine: " << scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Classify_First_Match) {
+    auto classify = [this](const std::string& data) {
+        ScanStats stats;
+        this->scanner.classify(data.data(), data.size(), stats);
+        return stats.totals();
+    };
+    const std::string zip("\x50\x4B\x03\x04", 4);
+    // The first match is the type; what follows is not counted.
+    const auto pdf = classify("\x25\x50\x44\x46_a_\x25\x25\x45\x4F\x46" + zip + "...word/document.xml");
+    EXPECT_EQ(pdf, (std::map<std::string, int>{{"PDF", 1}})) << "Engine: " << this->scanner.name();
+    // A parent waits for its children, here past the first prefix searched.
+    const auto docx = classify(zip + std::string(100000, '.') + "word/document.xml");
+    EXPECT_EQ(docx, (std::map<std::string, int>{{"DOCX", 1}})) << "Engine: " << this->scanner.name();
+    const auto plain = classify(zip + "_content_");
+    EXPECT_EQ(plain, (std::map<std::string, int>{{"ZIP", 1}})) << "Engine: " << this->scanner.name();
+    EXPECT_TRUE(classify("").empty()) << "Engine: " << this->scanner.name();
 }
 
 TYPED_TEST(ScannerTest, Empty_Data) {
     std::string data = "";
     ScanStats stats;
     this->scanner.scan(data.data(), data.size(), stats);
-    EXPECT_EQ(stats.counts.size(), 0u);
+    EXPECT_EQ(stats.totals().size(), 0u);
 }
 
 // ==========================================
@@ -85,7 +261,7 @@ TYPED_TEST(ScannerTest, Single_Byte) {
     std::string data = "\x00";
     ScanStats stats;
     this->scanner.scan(data.data(), data.size(), stats);
-    EXPECT_EQ(stats.counts.size(), 0u);
+    EXPECT_EQ(stats.totals().size(), 0u);
 }
 
 TYPED_TEST(ScannerTest, All_Zeros) {
@@ -105,6 +281,261 @@ TYPED_TEST(ScannerTest, Multiple_PDF_In_Same_Buffer) {
     EXPECT_GE(this->GetCount(stats, "PDF"), 2) << "Engine: " << this->scanner.name();
 }
 
+// ==========================================
+// 4.1 СТРИМИНГ (совпадения на границе чанков)
+// ==========================================
+
+TYPED_TEST(ScannerTest, Stream_Head_Split_Across_Chunks) {
+    std::string data = "\x25\x50\x44\x46_some_binary_data_\x25\x25\x45\x4F\x46";
+    ScanStats stats;
+    auto stream = this->scanner.open_stream(stats);
+    stream->write(data.data(), 2);                 // "%P" | "DF..."
+    stream->write(data.data() + 2, data.size() - 2);
+    stream->close();
+    EXPECT_EQ(this->GetCount(stats, "PDF"), 1) << "Engine: " << this->scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Stream_Byte_By_Byte_Counted_Once) {
+    std::string data = "\x50\x4B\x03\x04...word/document.xml..." + std::string(64, '\xCC')
+                     + "\x25\x50\x44\x46_data_\x25\x25\x45\x4F\x46";
+    ScanStats stats;
+    {
+        auto stream = this->scanner.open_stream(stats);
+        for (char c : data) stream->write(&c, 1);
+    } // destructor closes the stream
+    EXPECT_EQ(this->GetCount(stats, "DOCX"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(stats, "PDF"), 1) << "Engine: " << this->scanner.name();
+}
+
+TYPED_TEST(ScannerTest, Stream_Matches_Block_Scan) {
+    std::string pdf = "\x25\x50\x44\x46_payload_\x25\x25\x45\x4F\x46";
+    std::string data;
+    for (int i = 0; i < 5; ++i) data += pdf + std::string(37 * i, '\xCC') + "\x50\x4B\x03\x04zz";
+
+    ScanStats block;
+    this->scanner.scan(data.data(), data.size(), block);
+
+    for (size_t chunk : { 1u, 3u, 7u, 64u, 1000u }) {
+        ScanStats streamed;
+        auto stream = this->scanner.open_stream(streamed);
+        for (size_t off = 0; off < data.size(); off += chunk)
+            stream->write(data.data() + off, std::min(chunk, data.size() - off));
+        stream->close();
+        EXPECT_EQ(this->GetCount(streamed, "PDF"), this->GetCount(block, "PDF"))
+            << "Engine: " << this->scanner.name() << ", chunk: " << chunk;
+        EXPECT_EQ(this->GetCount(streamed, "ZIP"), this->GetCount(block, "ZIP"))
+            << "Engine: " << this->scanner.name() << ", chunk: " << chunk;
+    }
+}
+
+TYPED_TEST(ScannerTest, Stream_Matches_Block_Scan_Across_Megabytes) {
+    const std::vector<SignatureDefinition> sigs = {
+        { "PDF", "25504446", "2525454F46", "", SignatureType::BINARY, "" },
+        { "ZIP", "504B0304", "", "", SignatureType::BINARY, "" },
+        { "DOCX", "504B0304", "", "word/document.xml", SignatureType::BINARY, "ZIP" },
+        { "KEY", "", "", "key=[0-9]{1,8};", SignatureType::TEXT, "" },
+        { "EMAIL", "", "", "From:\\s.+\\r?\\n(?:To|Subject):", SignatureType::TEXT, "" }
+    };
+    TypeParam scanner;
+    scanner.prepare(sigs);
+    const std::string pdf_head = "\x25\x50\x44\x46", pdf_tail = "\x25\x25\x45\x4F\x46", zip = "\x50\x4B\x03\x04";
+    const size_t mb = 1024 * 1024;
+    // Heads several carry windows before their tails, a DOCX marker 2 MB after its ZIP
+    // header, short matches on every 64 KB boundary, and two e-mail headers 3 MB apart:
+    // the greedy `.+` makes them one match.
+    std::string data(6 * mb + 12345, '\0');
+    auto put = [&data](size_t at, const std::string& s) { data.replace(at, s.size(), s); };
+    put(100, pdf_head);
+    put(50000, pdf_head);
+    put(3 * mb + 500, pdf_tail);
+    put(3 * mb + 600, pdf_head + "x" + pdf_tail);
+    put(mb + 1000, "From: a\r\nTo: b");
+    put(4 * mb + 2007, "From: c\r\nSubject: d");
+    put(2 * mb + 11, zip);
+    put(4 * mb + 99, "word/document.xml");
+    put(4 * mb + 200, zip);
+    put(5 * mb + 100, pdf_head);
+    for (size_t at = 64 * 1024 - 7; at + 16 < data.size(); at += 64 * 1024) put(at, "key=" + std::to_string(at) + ";");
+
+    ScanStats block;
+    scanner.scan(data.data(), data.size(), block);
+    EXPECT_EQ(block.get("PDF"), 2) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("ZIP"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("DOCX"), 1) << "Engine: " << scanner.name();
+    EXPECT_EQ(block.get("EMAIL"), 1) << "Engine: " << scanner.name();
+    EXPECT_GT(block.get("KEY"), 90) << "Engine: " << scanner.name();
+
+    // 64 KB writes go through the carry; 3 MB ones are searched in place.
+    for (size_t chunk : { 64 * 1024 - size_t{1}, 3 * mb }) {
+        ScanStats streamed;
+        auto stream = scanner.open_stream(streamed);
+        for (size_t off = 0; off < data.size(); off += chunk)
+            stream->write(data.data() + off, std::min(chunk, data.size() - off));
+        stream->close();
+        EXPECT_EQ(streamed.totals(), block.totals()) << "Engine: " << scanner.name() << ", chunk: " << chunk;
+    }
+}
+
+TYPED_TEST(ScannerTest, Small_Writes_Stream_In_Bounded_Time) {
+    const std::vector<SignatureDefinition> sigs = {
+        { "PDF", "25504446", "2525454F46", "", SignatureType::BINARY, "" },
+        { "KEY", "", "", "key=[0-9]{1,8};", SignatureType::TEXT, "" },
+        { "EMAIL", "", "", "From:\\s.+\\r?\\n(?:To|Subject):", SignatureType::TEXT, "" }
+    };
+    TypeParam scanner;
+    scanner.prepare(sigs);
+    const size_t mb = 1024 * 1024;
+    // A PDF head whose tail comes megabytes later and an unmatched e-mail pattern keep
+    // the resume cursors far behind: every write would search the whole carry again.
+    std::string data(4 * mb, '.');
+    auto put = [&data](size_t at, const std::string& s) { data.replace(at, s.size(), s); };
+    put(10, "\x25\x50\x44\x46");
+    put(4 * mb - 100, "\x25\x25\x45\x4F\x46");
+    for (size_t at = 1000; at + 16 < data.size(); at += 4096) put(at, "key=" + std::to_string(at) + ";");
+
+    auto stream_ms = [&](size_t chunk, size_t size, ScanStats& stats) {
+        auto start = std::chrono::steady_clock::now();
+        auto stream = scanner.open_stream(stats);
+        for (size_t off = 0; off < size; off += chunk) stream->write(data.data() + off, std::min(chunk, size - off));
+        stream->close();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    ScanStats whole;
+    const double whole_ms = stream_ms(data.size(), data.size(), whole);
+    EXPECT_EQ(whole.get("PDF"), 1) << "Engine: " << scanner.name();
+
+    // Packet-sized writes are gathered into carry-sized searches: linear in the input.
+    for (size_t chunk : { size_t{1}, size_t{64} }) {
+        ScanStats streamed;
+        const double ms = stream_ms(chunk, data.size(), streamed);
+        EXPECT_EQ(streamed.totals(), whole.totals()) << "Engine: " << scanner.name() << ", chunk: " << chunk;
+        EXPECT_LT(ms, 20 * whole_ms + 3000) << "Engine: " << scanner.name() << ", chunk: " << chunk;
+    }
+}
+
+// ==========================================
+// 4.2 FORK: общая скомпилированная база, свой контекст на поток
+// ==========================================
+
+TYPED_TEST(ScannerTest, Fork_Concurrent_Scans_Match_Original) {
+    std::string pdf = "\x25\x50\x44\x46_data_\x25\x25\x45\x4F\x46";
+    std::string data;
+    for (int i = 0; i < 50; ++i) data += pdf + std::string(i, '\xCC') + "\x50\x4B\x03\x04...word/document.xml";
+
+    ScanStats expected;
+    this->scanner.scan(data.data(), data.size(), expected);
+
+    constexpr int THREADS = 4;
+    std::vector<ScanStats> results(THREADS);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < THREADS; ++t) {
+        workers.emplace_back([&, t] {
+            auto local = this->scanner.fork();
+            for (int rep = 0; rep < 10; ++rep) local->scan(data.data(), data.size(), results[t]);
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    for (const auto& r : results) {
+        for (const char* type : { "PDF", "ZIP", "DOCX" }) {
+            EXPECT_EQ(this->GetCount(r, type), 10 * this->GetCount(expected, type))
+                << "Engine: " << this->scanner.name() << ", type: " << type;
+        }
+    }
+}
+
+// ==========================================
+// 4.3 ПАРАЛЛЕЛЬНОЕ СКАНИРОВАНИЕ ОДНОГО БУФЕРА (сегменты с перекрытием)
+// ==========================================
+
+TYPED_TEST(ScannerTest, Parallel_Segments_Match_Block_Scan) {
+    const std::string pdf_head = "\x25\x50\x44\x46", pdf_tail = "\x25\x25\x45\x4F\x46";
+    const std::string zip = "\x50\x4B\x03\x04";
+    std::string data;
+    // Tails far behind their heads, nested heads, a head with no tail, and a DOCX marker
+    // many segments after its ZIP header.
+    data += pdf_head + std::string(700, '\xCC') + pdf_tail;
+    data += pdf_head + "x" + pdf_head + std::string(300, '\x00') + pdf_tail + pdf_tail;
+    data += zip + std::string(900, 'z') + "word/document.xml";
+    for (int i = 0; i < 40; ++i) data += std::string(i * 3, '\x11') + pdf_head + "!" + pdf_tail + zip;
+    data += pdf_head + std::string(500, '\xEE');
+
+    ScanStats block;
+    this->scanner.scan(data.data(), data.size(), block);
+    ASSERT_GT(this->GetCount(block, "PDF"), 40);
+
+    for (size_t segment : { size_t{16}, size_t{64}, size_t{200} }) {
+        for (unsigned threads : { 2u, 4u }) {
+            ScanStats parallel;
+            this->scanner.scan_parallel(data.data(), data.size(), parallel, threads, segment);
+            EXPECT_EQ(parallel.totals(), block.totals())
+                << "Engine: " << this->scanner.name() << ", segment: " << segment << ", threads: " << threads;
+        }
+    }
+}
+
+// ==========================================
+// 4.4 ВЕКТОРНЫЙ СКАН РАЗРОЗНЕННЫХ БУФЕРОВ (scan_vectored)
+// ==========================================
+
+TYPED_TEST(ScannerTest, Vectored_Pieces_Match_Block_Scan) {
+    const std::string pdf = "\x25\x50\x44\x46_payload_\x25\x25\x45\x4F\x46";
+    const std::string zip = "\x50\x4B\x03\x04zz";
+    std::string small;
+    for (int i = 0; i < 12; ++i) small += pdf + std::string(11 * i, '\xCC') + zip;
+    // A piece larger than the stream carry, with matches across both of its edges.
+    const std::string large = "_x\x25\x25\x45\x4F\x46" + pdf + std::string(STREAM_CARRY_BYTES + 4096, '\xCC')
+                            + zip + pdf + "\x25\x50\x44\x46";
+    const std::string data = small + "\x25\x50\x44\x46" + large + "\x25\x25\x45\x4F\x46" + small;
+
+    ScanStats block;
+    this->scanner.scan(data.data(), data.size(), block);
+    ASSERT_EQ(this->GetCount(block, "PDF"), 28);
+
+    // Separate copies of the pieces, cut every `cut` bytes outside the large one.
+    for (size_t cut : { size_t{1}, size_t{7}, size_t{64}, data.size() }) {
+        std::vector<std::string> owned;
+        const size_t large_at = small.size() + 4;
+        for (size_t off = 0; off < data.size();) {
+            size_t len = off == large_at ? large.size() : std::min(cut, (off < large_at ? large_at : data.size()) - off);
+            owned.push_back(data.substr(off, len));
+            off += len;
+        }
+        std::vector<ScanSpan> spans;
+        for (const auto& piece : owned) spans.push_back({ piece.data(), piece.size() });
+
+        ScanStats vectored;
+        this->scanner.scan_vectored(spans, vectored);
+        EXPECT_EQ(vectored.totals(), block.totals()) << "Engine: " << this->scanner.name() << ", cut: " << cut;
+
+        // What scan_vectored() falls back to past VECTORED_JOIN_BYTES: the large piece is
+        // searched where it lies.
+        if (cut < 64) continue;
+        ScanStats streamed;
+        auto stream = this->scanner.open_stream(streamed);
+        for (const auto& span : spans) stream->write(span.data, span.size);
+        stream->close();
+        EXPECT_EQ(streamed.totals(), block.totals()) << "Engine: " << this->scanner.name() << ", cut: " << cut;
+    }
+}
+
+TYPED_TEST(ScannerTest, Vectored_Scan_After_Reprepare) {
+    const std::string pdf = "\x25\x50\x44\x46_payload_\x25\x25\x45\x4F\x46";
+    const std::vector<std::string> owned = { pdf.substr(0, 3), pdf.substr(3, 9), pdf.substr(12) + "\x50\x4B\x03\x04" };
+    std::vector<ScanSpan> spans;
+    for (const auto& piece : owned) spans.push_back({ piece.data(), piece.size() });
+
+    ScanStats before;
+    this->scanner.scan_vectored(spans, before);
+    // prepare() swaps the databases: scratch sized for the old ones must not be reused.
+    this->scanner.prepare(TEST_SIGS);
+    ScanStats after;
+    this->scanner.scan_vectored(spans, after);
+    EXPECT_EQ(this->GetCount(after, "PDF"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(this->GetCount(after, "ZIP"), 1) << "Engine: " << this->scanner.name();
+    EXPECT_EQ(after.totals(), before.totals()) << "Engine: " << this->scanner.name();
+}
+
 // ==========================================
 // 5. FALSE POSITIVE ТЕСТЫ (full signatures.json)
 // ==========================================
@@ -120,15 +551,14 @@ protected:
     }
 
     int GetCount(const ScanStats& stats, const std::string& name) {
-        auto it = stats.counts.find(name);
-        return (it != stats.counts.end()) ? it->second : 0;
+        return stats.get(name);
     }
 };
 
 template <typename T>
 T FalsePositiveTest<T>::scanner;
 
-using FPScannerTypes = ::testing::Types<Re2Scanner, BoostScanner, HsScanner>;
+using FPScannerTypes = ::testing::Types<Re2Scanner, BoostScanner, HsScanner, LiteralScanner, HybridScanner>;
 TYPED_TEST_SUITE(FalsePositiveTest, FPScannerTypes);
 
 TYPED_TEST(FalsePositiveTest, BMP_No_FP_On_Plain_BM) {
@@ -187,6 +617,780 @@ TEST(DeductionTest, Deduction_Does_Not_Go_Negative) {
     EXPECT_EQ(stats.counts["OLE"], 0); // max(0, 1-3) = 0
 }
 
+// ==========================================
+// 6.1 КЭШ СКОМПИЛИРОВАННОЙ БАЗЫ HYPERSCAN
+// ==========================================
+
+TEST(HsCacheTest, Warm_Start_Uses_Serialized_Database) {
+    auto dir = std::filesystem::temp_directory_path() / "devscan_test_hs_cache";
+    std::filesystem::remove_all(dir);
+
+    HsScanner cold;
+    cold.set_cache_dir(dir.string());
+    cold.prepare(TEST_SIGS);
+    ASSERT_TRUE(std::filesystem::exists(dir));
+    EXPECT_FALSE(std::filesystem::is_empty(dir)) << "Compiled database was not persisted";
+
+    HsScanner warm;
+    warm.set_cache_dir(dir.string());
+    warm.prepare(TEST_SIGS);
+    std::string data = "\x25\x50\x44\x46_data_\x25\x25\x45\x4F\x46";
+    ScanStats stats;
+    warm.scan(data.data(), data.size(), stats);
+    EXPECT_EQ(stats.get("PDF"), 1);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(HsCacheTest, Signature_Set_Hash_Changes_With_Content) {
+    auto sigs = TEST_SIGS;
+    uint64_t before = signature_set_hash(sigs);
+    EXPECT_EQ(before, signature_set_hash(TEST_SIGS));
+    sigs[0].hex_tail = "2525454F460A";
+    EXPECT_NE(before, signature_set_hash(sigs));
+}
+
+// ==========================================
+// 6.2 ПЛОТНЫЕ СЧЁТЧИКИ ScanStats
+// ==========================================
+
+TEST(ScanStatsTest, Dense_Hits_Resolved_By_Name) {
+    auto names = std::make_shared<SignatureNames>(SignatureNames{ "PDF", "ZIP" });
+    ScanStats stats;
+    stats.bind(names);
+    stats.hit(1);
+    stats.hit(1);
+    EXPECT_EQ(stats.get("ZIP"), 2);
+    EXPECT_EQ(stats.get("PDF"), 0);
+    EXPECT_EQ(stats.totals().size(), 1u);
+
+    stats.resolve();
+    EXPECT_EQ(stats.counts["ZIP"], 2);
+    EXPECT_EQ(stats.get("ZIP"), 2); // not double-counted after resolve
+}
+
+TEST(ScanStatsTest, Merge_Same_And_Different_Id_Space) {
+    auto a_names = std::make_shared<SignatureNames>(SignatureNames{ "PDF", "ZIP" });
+    auto b_names = std::make_shared<SignatureNames>(SignatureNames{ "ZIP", "GIF" });
+
+    ScanStats a1, a2, b;
+    a1.bind(a_names); a1.hit(0); a1.total_files_processed = 1;
+    a2.bind(a_names); a2.hit(0); a2.hit(1); a2.total_files_processed = 2;
+    b.bind(b_names);  b.hit(0); b.hit(1);
+
+    ScanStats total;
+    total += a1;
+    total += a2;
+    total += b;
+    EXPECT_EQ(total.get("PDF"), 2);
+    EXPECT_EQ(total.get("ZIP"), 2);
+    EXPECT_EQ(total.get("GIF"), 1);
+    EXPECT_EQ(total.total_files_processed, 3);
+}
+
+// ==========================================
+// 6.3 WORK-STEALING ПЛАНИРОВЩИК
+// ==========================================
+
+TEST(WorkSchedulerTest, Every_Job_Dispatched_Exactly_Once) {
+    std::vector<uint64_t> weights(1000);
+    for (size_t i = 0; i < weights.size(); ++i) weights[i] = (i * 7919) % 1000;
+
+    for (auto order : { WorkScheduler::Order::AS_GIVEN, WorkScheduler::Order::LARGEST_FIRST }) {
+        WorkScheduler sched(weights, 8, order);
+        std::vector<std::vector<size_t>> taken(8);
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < 8; ++w) {
+            workers.emplace_back([&, w] {
+                size_t job;
+                while (sched.next(w, job)) taken[w].push_back(job);
+            });
+        }
+        for (auto& t : workers) t.join();
+
+        std::vector<int> seen(weights.size(), 0);
+        for (const auto& list : taken)
+            for (size_t job : list) seen[job]++;
+        EXPECT_TRUE(std::all_of(seen.begin(), seen.end(), [](int c) { return c == 1; }));
+    }
+}
+
+TEST(WorkSchedulerTest, Idle_Worker_Steals_From_Busy_One) {
+    // AS_GIVEN puts jobs 0..3 on worker 0 and 4..7 on worker 1; worker 1 never asks.
+    WorkScheduler sched(std::vector<uint64_t>(8, 1), 2, WorkScheduler::Order::AS_GIVEN);
+    size_t job, count = 0;
+    while (sched.next(0, job)) count++;
+    EXPECT_EQ(count, 8u);
+}
+
+TEST(WorkSchedulerTest, Largest_First_Order) {
+    WorkScheduler sched({ 10, 500, 20, 9000, 300 }, 1, WorkScheduler::Order::LARGEST_FIRST);
+    std::vector<size_t> order;
+    size_t job;
+    while (sched.next(0, job)) order.push_back(job);
+    EXPECT_EQ(order, (std::vector<size_t>{ 3, 1, 4, 2, 0 }));
+}
+
+// ==========================================
+// 6.4 ОЧЕРЕДЬ ОБХОД → СКАНИРОВАНИЕ
+// ==========================================
+
+TEST(BoundedQueueTest, Full_And_Empty_Reported) {
+    BoundedQueue<int> q(4);
+    int v = 0;
+    EXPECT_FALSE(q.try_pop(v));
+    for (int i = 0; i < 4; ++i) {
+        int x = i;
+        EXPECT_TRUE(q.try_push(x));
+    }
+    int extra = 99;
+    EXPECT_FALSE(q.try_push(extra));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.try_pop(v));
+        EXPECT_EQ(v, i);
+    }
+    q.close();
+    EXPECT_FALSE(q.pop(v));
+}
+
+TEST(BoundedQueueTest, Producer_Consumers_Deliver_Every_Item_Once) {
+    // Small capacity forces the producer to wait on full and consumers on empty.
+    BoundedQueue<size_t> q(8);
+    const size_t N = 20000;
+    std::thread producer([&] {
+        for (size_t i = 0; i < N; ++i) q.push(i);
+        q.close();
+    });
+    std::vector<std::vector<size_t>> got(4);
+    std::vector<std::thread> consumers;
+    for (size_t c = 0; c < got.size(); ++c) {
+        consumers.emplace_back([&, c] {
+            size_t v;
+            while (q.pop(v)) got[c].push_back(v);
+        });
+    }
+    producer.join();
+    for (auto& t : consumers) t.join();
+
+    std::vector<int> seen(N, 0);
+    for (const auto& list : got)
+        for (size_t v : list) seen[v]++;
+    EXPECT_TRUE(std::all_of(seen.begin(), seen.end(), [](int c) { return c == 1; }));
+}
+
+// ==========================================
+// 6.5 ПАРАЛЛЕЛЬНЫЙ ОБХОД КАТАЛОГОВ
+// ==========================================
+
+class DirWalkerTest : public ::testing::Test {
+protected:
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "devscan_walker_test";
+
+    void SetUp() override {
+        std::filesystem::remove_all(root);
+        for (int d = 0; d < 6; ++d) {
+            auto dir = root / ("d" + std::to_string(d)) / "nested";
+            std::filesystem::create_directories(dir);
+            for (int f = 0; f < 5; ++f)
+                std::ofstream(dir / ("f" + std::to_string(f))) << std::string(d * 10 + f, 'x');
+        }
+        std::ofstream(root / "top.bin") << "abc";
+    }
+    void TearDown() override { std::filesystem::remove_all(root); }
+
+    std::map<std::string, uint64_t> Walk(const std::filesystem::path& target, unsigned threads) {
+        std::mutex m;
+        std::map<std::string, uint64_t> found;
+        size_t n = DirWalker::walk(target.string(), threads, [&](FileEntry&& e) {
+            std::lock_guard<std::mutex> lock(m);
+            EXPECT_TRUE(found.emplace(std::filesystem::path(e.path).lexically_relative(root).generic_string(), e.size).second);
+        });
+        EXPECT_EQ(n, found.size());
+        return found;
+    }
+};
+
+TEST_F(DirWalkerTest, Every_File_Reported_Once_With_Size) {
+    for (unsigned threads : { 1u, 4u }) {
+        auto found = Walk(root, threads);
+        ASSERT_EQ(found.size(), 31u);
+        EXPECT_EQ(found["top.bin"], 3u);
+        EXPECT_EQ(found["d4/nested/f2"], 42u);
+    }
+}
+
+TEST_F(DirWalkerTest, Symlinks_Not_Followed_And_Single_File_Root) {
+    std::error_code ec;
+    std::filesystem::create_directory_symlink(root / "d0", root / "link_dir", ec);
+    std::filesystem::create_symlink(root / "top.bin", root / "link_file", ec);
+    EXPECT_EQ(Walk(root, 2).size(), 31u);
+
+    auto single = Walk(root / "top.bin", 2);
+    ASSERT_EQ(single.size(), 1u);
+    EXPECT_EQ(single.begin()->second, 3u);
+    EXPECT_TRUE(Walk(root / "missing", 2).empty());
+}
+
+// ==========================================
+// 6.6 I/O-БЭКЕНДЫ (mmap, pread, io_uring)
+// ==========================================
+
+TEST(FileReaderTest, Every_Backend_Reads_Whole_Files) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "devscan_reader_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // Sizes cover empty files, one page, a batch larger than the io_uring queue and a file
+    // above the per-slot io_uring buffer limit.
+    std::vector<FileEntry> files;
+    std::map<std::string, std::string> contents;
+    const std::vector<size_t> sizes = { 0, 1, 4096, 100000, 3 * 1024 * 1024 };
+    for (int i = 0; i < 80; ++i) {
+        std::string data(sizes[i % sizes.size()], '\0');
+        for (size_t j = 0; j < data.size(); ++j) data[j] = static_cast<char>((i * 31 + j * 7) & 0xFF);
+        FileEntry e;
+        e.path = (dir / ("f" + std::to_string(i))).string();
+        e.size = data.size();
+        std::ofstream(e.path, std::ios::binary).write(data.data(), static_cast<std::streamsize>(data.size()));
+        contents[e.path] = std::move(data);
+        files.push_back(e);
+    }
+    FileEntry missing;
+    missing.path = (dir / "missing").string();
+    missing.size = 10;
+    files.push_back(missing);
+
+    for (IoBackend backend : { IoBackend::MMAP, IoBackend::PREAD, IoBackend::URING }) {
+        auto reader = FileReader::create(backend, 8);
+        std::map<std::string, int> read_count;
+        std::vector<std::string> failed;
+        for (size_t off = 0; off < files.size(); off += 32) {
+            size_t n = std::min<size_t>(32, files.size() - off);
+            reader->read(files.data() + off, n,
+                [&](const FileEntry& f, const char* data, size_t size) {
+                    read_count[f.path]++;
+                    EXPECT_EQ(std::string(data, size), contents[f.path]) << reader->name() << ": " << f.path;
+                },
+                [&](const FileEntry& f, const std::string&) { failed.push_back(f.path); });
+        }
+        EXPECT_EQ(read_count.size(), contents.size()) << reader->name();
+        EXPECT_TRUE(std::all_of(read_count.begin(), read_count.end(), [](const auto& kv) { return kv.second == 1; }))
+            << reader->name();
+        EXPECT_EQ(failed, std::vector<std::string>{ missing.path }) << reader->name();
+    }
+    fs::remove_all(dir);
+}
+
+// ==========================================
+// 6.7 КЭШ РЕЗУЛЬТАТОВ (--incremental)
+// ==========================================
+
+TEST(ResultCacheTest, Reuses_Unchanged_Files_Until_Signatures_Change) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "devscan_result_cache_test";
+    fs::remove_all(dir);
+
+    auto names = std::make_shared<const SignatureNames>(SignatureNames{ "PDF", "ZIP", "DOCX" });
+    const uint64_t sig_hash = signature_set_hash(TEST_SIGS);
+    const int64_t old_mtime = std::time(nullptr) - 3600;
+
+    // Identity only matters to the cache: the files themselves are never opened.
+    std::vector<FileEntry> files;
+    for (int i = 0; i < 200; ++i) {
+        FileEntry f;
+        f.path = "/data/f" + std::to_string(i);
+        f.size = 1000 + i;
+        f.device = 1;
+        f.inode = 100 + i;
+        f.mtime = old_mtime;
+        files.push_back(f);
+    }
+    FileEntry racy = files[0];
+    racy.path = "/data/racy";
+    racy.inode = 99;
+    racy.mtime = std::time(nullptr);
+
+    {
+        ResultCache cache(dir.string(), "test", names, sig_hash, "/data");
+        EXPECT_EQ(cache.loaded(), 0u);
+        // Stores from several threads at once, as the scan workers do.
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (size_t i = t; i < files.size(); i += 4) {
+                    ScanStats s;
+                    s.bind(names);
+                    s.hit(0, static_cast<int>(i));
+                    s.hit(2, 1);
+                    cache.store(files[i], s);
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+        ScanStats s;
+        s.bind(names);
+        s.hit(1);
+        cache.store(racy, s);
+        EXPECT_EQ(cache.stored(), files.size());
+        ASSERT_TRUE(cache.save());
+    }
+
+    {
+        ResultCache cache(dir.string(), "test", names, sig_hash, "/data");
+        EXPECT_EQ(cache.loaded(), files.size());
+        ScanStats total;
+        for (const auto& f : files) EXPECT_TRUE(cache.lookup(f, total)) << f.path;
+        EXPECT_EQ(total.get("PDF"), 199 * 200 / 2);
+        EXPECT_EQ(total.get("DOCX"), 200);
+        EXPECT_EQ(total.get("ZIP"), 0);
+        EXPECT_FALSE(cache.lookup(racy, total));
+
+        FileEntry changed = files[5];
+        changed.mtime += 1;
+        EXPECT_FALSE(cache.lookup(changed, total));
+        changed = files[5];
+        changed.size += 1;
+        EXPECT_FALSE(cache.lookup(changed, total));
+        changed = files[5];
+        changed.path = "/data/renamed";
+        EXPECT_FALSE(cache.lookup(changed, total));
+
+        // A rescanned file replaces its old entry.
+        changed = files[5];
+        changed.mtime -= 10;
+        ScanStats s;
+        s.bind(names);
+        s.hit(1, 7);
+        cache.store(changed, s);
+        ASSERT_TRUE(cache.save());
+
+        ResultCache reloaded(dir.string(), "test", names, sig_hash, "/data");
+        EXPECT_EQ(reloaded.loaded(), files.size());
+        ScanStats one;
+        EXPECT_FALSE(reloaded.lookup(files[5], one));
+        EXPECT_TRUE(reloaded.lookup(changed, one));
+        EXPECT_EQ(one.get("ZIP"), 7);
+        EXPECT_EQ(one.get("PDF"), 0);
+    }
+
+    {
+        // A run over another root keeps every entry it did not see...
+        ResultCache other_root(dir.string(), "test", names, sig_hash, "/elsewhere");
+        ASSERT_TRUE(other_root.save());
+        // ...but a run over /data drops the files it no longer finds (deleted or renamed).
+        ResultCache cache(dir.string(), "test", names, sig_hash, "/data");
+        EXPECT_EQ(cache.loaded(), files.size());
+        ScanStats seen;
+        for (size_t i = 100; i < files.size(); ++i) EXPECT_TRUE(cache.lookup(files[i], seen));
+        ASSERT_TRUE(cache.save());
+        ResultCache pruned(dir.string(), "test", names, sig_hash, "/data");
+        EXPECT_EQ(pruned.loaded(), files.size() - 100);
+        EXPECT_FALSE(pruned.lookup(files[0], seen));
+        EXPECT_TRUE(pruned.lookup(files[150], seen));
+    }
+
+    // Any edit of the signature set, or another engine, invalidates every entry.
+    ResultCache other_sigs(dir.string(), "test", names, sig_hash + 1, "/data");
+    EXPECT_EQ(other_sigs.loaded(), 0u);
+    ResultCache other_layout(dir.string(), "test",
+                             std::make_shared<const SignatureNames>(SignatureNames{ "ZIP", "PDF", "DOCX" }), sig_hash,
+                             "/data");
+    EXPECT_EQ(other_layout.loaded(), 0u);
+    ResultCache other_engine(dir.string(), "other", names, sig_hash, "/data");
+    EXPECT_EQ(other_engine.loaded(), 0u);
+    fs::remove_all(dir);
+}
+
+// ==========================================
+// 6.8 ДЕДУПЛИКАЦИЯ ПО СОДЕРЖИМОМУ (--dedup)
+// ==========================================
+
+TEST(ContentDedupTest, Copies_Reuse_First_Result_And_Still_Count) {
+    // Reference XXH64 values.
+    EXPECT_EQ(content_hash("", 0), 0xEF46DB3751D8E999ull);
+    EXPECT_EQ(content_hash("abc", 3), 0x44BC2CF5AD770999ull);
+    std::string long_input(100, 'x');
+    EXPECT_EQ(content_hash(long_input.data(), long_input.size()), content_hash(long_input.data(), long_input.size()));
+    EXPECT_NE(content_hash(long_input.data(), 99), content_hash(long_input.data(), 100));
+
+    auto scanner = Scanner::create(EngineType::RE2);
+    scanner->prepare(TEST_SIGS);
+    ContentDedup dedup(scanner->signature_names());
+
+    // 7 distinct contents, each copied 25 times, scanned by 4 threads at once.
+    std::vector<std::string> contents;
+    for (int i = 0; i < 7; ++i) {
+        std::string c = "%PDF-" + std::to_string(i) + " body %%EOF";
+        if (i % 2) c += " PK\x03\x04 word/document.xml";
+        contents.push_back(c);
+    }
+    std::vector<size_t> order;
+    for (int k = 0; k < 25; ++k)
+        for (size_t i = 0; i < contents.size(); ++i) order.push_back(i);
+
+    ScanStats expected;
+    for (size_t i : order) scanner->scan(contents[i].data(), contents[i].size(), expected);
+
+    std::atomic<size_t> scanned{0};
+    std::atomic<uint64_t> scanned_bytes{0};
+    std::vector<ScanStats> totals(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            auto w = scanner->fork();
+            ScanStats file_stats;
+            for (size_t n = t; n < order.size(); n += 4) {
+                const std::string& c = contents[order[n]];
+                const uint64_t hash = content_hash(c.data(), c.size());
+                auto claim = dedup.acquire(hash, c.size(), file_stats);
+                if (claim != ContentDedup::Claim::REUSED) {
+                    w->scan(c.data(), c.size(), file_stats);
+                    scanned++;
+                    scanned_bytes += c.size();
+                }
+                if (claim == ContentDedup::Claim::FIRST) dedup.publish(hash, c.size(), file_stats);
+                totals[t] += file_stats;
+                file_stats.reset();
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    ScanStats merged;
+    for (const auto& s : totals) merged += s;
+    EXPECT_EQ(merged.totals(), expected.totals());
+    EXPECT_EQ(dedup.reused_files() + scanned.load(), order.size());
+    EXPECT_GE(scanned.load(), contents.size());
+    EXPECT_GT(dedup.reused_files(), 0u);
+    uint64_t all_bytes = 0;
+    for (size_t i : order) all_bytes += contents[i].size();
+    EXPECT_EQ(dedup.bytes_skipped() + scanned_bytes.load(), all_bytes);
+
+    // A first copy that failed to scan is released: the next copy is first in its place.
+    ScanStats file_stats;
+    const std::string lost = "%PDF- never published %%EOF";
+    const uint64_t lost_hash = content_hash(lost.data(), lost.size());
+    ASSERT_EQ(dedup.acquire(lost_hash, lost.size(), file_stats), ContentDedup::Claim::FIRST);
+    EXPECT_EQ(dedup.acquire(lost_hash, lost.size(), file_stats), ContentDedup::Claim::IN_PROGRESS);
+    dedup.release(lost_hash, lost.size());
+    EXPECT_EQ(dedup.acquire(lost_hash, lost.size(), file_stats), ContentDedup::Claim::FIRST);
+    // A published result is never released.
+    const std::string& kept = contents[0];
+    const uint64_t kept_hash = content_hash(kept.data(), kept.size());
+    dedup.release(kept_hash, kept.size());
+    EXPECT_EQ(dedup.acquire(kept_hash, kept.size(), file_stats), ContentDedup::Claim::REUSED);
+}
+
+// ==========================================
+// 6.9 ИНДЕКС ИЗВЕСТНЫХ ФАЙЛОВ (--allowlist)
+// ==========================================
+
+TEST(KnownFileIndexTest, Built_Index_Finds_Exactly_Indexed_Contents) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "devscan_allowlist_test";
+    fs::path index_path = fs::temp_directory_path() / "devscan_allowlist_test.idx";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+
+    // 300 contents, some stored twice; an empty file is never indexed.
+    std::vector<std::string> contents;
+    for (int i = 0; i < 300; ++i) {
+        std::string c = "known file " + std::to_string(i) + std::string(static_cast<size_t>(i * 7), 'x');
+        contents.push_back(c);
+        std::ofstream(dir / ("f" + std::to_string(i)), std::ios::binary) << c;
+        if (i % 10 == 0) std::ofstream(dir / "sub" / ("copy" + std::to_string(i)), std::ios::binary) << c;
+    }
+    std::ofstream(dir / "empty").close();
+
+    EXPECT_EQ(KnownFileIndex::build(dir.string(), index_path.string(), 4), contents.size());
+    auto index = KnownFileIndex::open(index_path.string());
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->size(), contents.size());
+    auto known = [&](const std::string& c) { return index->contains(c.data(), c.size(), content_hash(c.data(), c.size())); };
+    for (const auto& c : contents) EXPECT_TRUE(known(c));
+    for (int i = 0; i < 300; ++i) EXPECT_FALSE(known("unknown file " + std::to_string(i)));
+    EXPECT_FALSE(known(""));
+
+    // An XXH64 collision is not enough: size and SHA-256 must match the record too.
+    const uint64_t indexed = content_hash(contents[5].data(), contents[5].size());
+    std::string forged = contents[5];
+    forged.back() ^= 1;
+    EXPECT_FALSE(index->contains(forged.data(), forged.size(), indexed));
+    EXPECT_FALSE(index->contains(contents[5].data(), contents[5].size() - 1, indexed));
+
+    auto hex = [](const KnownFileIndex::Digest& d) {
+        std::string s;
+        for (unsigned char b : d) { s += "0123456789abcdef"[b >> 4]; s += "0123456789abcdef"[b & 15]; }
+        return s;
+    };
+    EXPECT_EQ(hex(KnownFileIndex::sha256("", 0)), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(hex(KnownFileIndex::sha256("abc", 3)), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    const std::string two_blocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    EXPECT_EQ(hex(KnownFileIndex::sha256(two_blocks.data(), two_blocks.size())),
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    const std::string million(1000000, 'a');
+    EXPECT_EQ(hex(KnownFileIndex::sha256(million.data(), million.size())),
+              "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    std::ofstream(index_path, std::ios::binary | std::ios::trunc) << "not an index";
+    EXPECT_EQ(KnownFileIndex::open(index_path.string()), nullptr);
+    EXPECT_EQ(KnownFileIndex::open((dir / "missing.idx").string()), nullptr);
+
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    EXPECT_EQ(KnownFileIndex::build(dir.string(), index_path.string(), 1), 0u);
+    index = KnownFileIndex::open(index_path.string());
+    ASSERT_NE(index, nullptr);
+    EXPECT_FALSE(known(contents[0]));
+
+    fs::remove_all(dir);
+    fs::remove(index_path);
+}
+
+// ==========================================
+// 6.10 АВТОВЫБОР ДВИЖКА (-e auto)
+// ==========================================
+
+TEST(EngineTunerTest, Trials_Prepare_Engines_And_Pick_Least_Estimated_Time) {
+    std::string pdf = std::string(4096, 'x') + "%PDF-1.4 body %%EOF" + std::string(4096, 'y');
+    std::vector<std::string> sample = { pdf, std::string(65536, 'z') };
+    auto trials = EngineTuner::measure(TEST_SIGS, sample, "", false, { EngineType::RE2, EngineType::BOOST });
+    ASSERT_EQ(trials.size(), 2u);
+    for (auto& t : trials) {
+        ASSERT_TRUE(t.ok);
+        EXPECT_GE(t.prepare_ms, 0.0);
+        EXPECT_GE(t.scan_ms, 0.0);
+        // The trial's scanner is prepared and usable as the run's engine.
+        ScanStats stats;
+        t.scanner->scan(pdf.data(), pdf.size(), stats);
+        EXPECT_EQ(stats.get("PDF"), 1) << t.scanner->name();
+    }
+    EXPECT_LT(EngineTuner::pick(trials, 1.0), trials.size());
+
+    // Compile time decides a small run, scan time a large one; a failed engine never wins.
+    std::vector<EngineTuner::Trial> fake(3);
+    fake[0] = { EngineType::HYPERSCAN, nullptr, 50.0, 1.0, true };
+    fake[1] = { EngineType::RE2, nullptr, 1.0, 5.0, true };
+    fake[2] = { EngineType::BOOST, nullptr, 0.0, 0.0, false };
+    EXPECT_EQ(EngineTuner::pick(fake, 1.0), 1u);
+    EXPECT_EQ(EngineTuner::pick(fake, 100.0), 0u);
+    fake[0].ok = fake[1].ok = false;
+    EXPECT_EQ(EngineTuner::pick(fake, 1.0), fake.size());
+}
+
+TEST(EngineTunerTest, Choice_Remembered_Per_Signature_Set) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "devscan_tuner_test";
+    fs::remove_all(dir);
+
+    for (EngineType e : { EngineType::HYPERSCAN, EngineType::RE2, EngineType::BOOST,
+                          EngineType::LITERAL, EngineType::HYBRID }) {
+        EngineType back = EngineType::BOOST;
+        EXPECT_TRUE(EngineTuner::from_key(EngineTuner::key(e), back));
+        EXPECT_EQ(back, e);
+    }
+    EngineType engine = EngineType::HYPERSCAN;
+    EXPECT_FALSE(EngineTuner::from_key("auto", engine));
+
+    EXPECT_FALSE(EngineTuner::load(dir.string(), 1, false, engine));
+    ASSERT_TRUE(EngineTuner::save(dir.string(), 1, false, EngineType::RE2));
+    EXPECT_TRUE(EngineTuner::load(dir.string(), 1, false, engine));
+    EXPECT_EQ(engine, EngineType::RE2);
+    EXPECT_FALSE(EngineTuner::load(dir.string(), 2, false, engine)); // another signature set
+    EXPECT_FALSE(EngineTuner::load(dir.string(), 1, true, engine));  // timed on scan(), not classify()
+    ASSERT_TRUE(EngineTuner::save(dir.string(), 1, false, EngineType::HYBRID));
+    EXPECT_TRUE(EngineTuner::load(dir.string(), 1, false, engine));
+    EXPECT_EQ(engine, EngineType::HYBRID);
+    ASSERT_TRUE(EngineTuner::save(dir.string(), 1, true, EngineType::HYPERSCAN));
+    EXPECT_TRUE(EngineTuner::load(dir.string(), 1, true, engine));
+    EXPECT_EQ(engine, EngineType::HYPERSCAN);
+    EXPECT_TRUE(EngineTuner::load(dir.string(), 1, false, engine));
+    EXPECT_EQ(engine, EngineType::HYBRID);
+
+    // No cache directory: nothing is remembered.
+    EXPECT_FALSE(EngineTuner::save("", 1, false, EngineType::RE2));
+    EXPECT_FALSE(EngineTuner::load("", 1, false, engine));
+    fs::remove_all(dir);
+}
+
+// ==========================================
+// 6.11 БЮДЖЕТ ВРЕМЕНИ НА ФАЙЛ (--file-budget)
+// ==========================================
+
+static SignatureDefinition text_signature(const std::string& name, const std::string& pattern) {
+    SignatureDefinition def;
+    def.name = name;
+    def.type = SignatureType::TEXT;
+    def.text_pattern = pattern;
+    return def;
+}
+
+TEST(ScanBudgetTest, Boost_Runaway_Backtracking_Is_Over_Budget) {
+    // No closing tag: every `<html` makes the lazy `.*?` run to the end of the buffer.
+    const std::vector<SignatureDefinition> sigs = { text_signature("HTML", "<html.*?</html>") };
+    std::string data;
+    while (data.size() < 1024 * 1024) data += "<html> aaaa ";
+
+    BoostScanner boost(BoostScanner::Matching::PER_SIGNATURE);
+    boost.prepare(sigs);
+    ScanStats stats;
+    EXPECT_THROW(boost.scan(data.data(), data.size(), stats), ScanBudgetExceeded);
+
+    // RE2, the fallback, is linear in the input and ignores the budget.
+    Re2Scanner re2;
+    re2.prepare(sigs);
+    re2.set_time_budget(std::chrono::milliseconds(1));
+    ScanStats fallback;
+    re2.scan(data.data(), data.size(), fallback);
+    EXPECT_EQ(fallback.get("HTML"), 0);
+}
+
+TEST(ScanBudgetTest, Deadline_Stops_Scan_And_Is_Kept_By_Forks) {
+    const std::vector<SignatureDefinition> sigs = { text_signature("KEY", "key=[0-9]+;") };
+    std::string data;
+    while (data.size() < 4 * 1024 * 1024) data += "key=123;";
+    const int all = static_cast<int>(data.size() / 8);
+    const std::string one = "..key=1;..";
+
+    std::vector<std::unique_ptr<Scanner>> engines;
+    engines.push_back(std::make_unique<BoostScanner>());
+    engines.push_back(std::make_unique<BoostScanner>(BoostScanner::Matching::PER_SIGNATURE));
+    engines.push_back(std::make_unique<HybridScanner>(EngineType::BOOST));
+    for (auto& engine : engines) {
+        engine->prepare(sigs);
+        engine->set_time_budget(std::chrono::milliseconds(1));
+        auto fork = engine->fork();
+        ScanStats stats;
+        EXPECT_THROW(fork->scan(data.data(), data.size(), stats), ScanBudgetExceeded) << engine->name();
+        // Nothing of the stopped scan is carried into the next one.
+        ScanStats small;
+        fork->scan(one.data(), one.size(), small);
+        EXPECT_EQ(small.get("KEY"), 1) << engine->name();
+
+        fork->set_time_budget(std::chrono::milliseconds(0));
+        ScanStats whole;
+        fork->scan(data.data(), data.size(), whole);
+        EXPECT_EQ(whole.get("KEY"), all) << engine->name();
+    }
+}
+
+TEST(ScanBudgetTest, Split_And_Streamed_Scans_Are_Over_Budget) {
+    const std::vector<SignatureDefinition> sigs = { text_signature("KEY", "key=[0-9]+;") };
+    std::string data;
+    while (data.size() < 4 * 1024 * 1024) data += "key=123;";
+    const int all = static_cast<int>(data.size() / 8);
+    auto stream_in_chunks = [&](Scanner& scanner, ScanStats& stats) {
+        auto stream = scanner.open_stream(stats);
+        for (size_t off = 0; off < data.size(); off += 64 * 1024)
+            stream->write(data.data() + off, std::min<size_t>(64 * 1024, data.size() - off));
+        stream->close();
+    };
+
+    std::vector<std::unique_ptr<Scanner>> engines;
+    engines.push_back(std::make_unique<BoostScanner>());
+    engines.push_back(std::make_unique<BoostScanner>(BoostScanner::Matching::PER_SIGNATURE));
+    engines.push_back(std::make_unique<HybridScanner>(EngineType::BOOST));
+    for (auto& engine : engines) {
+        engine->prepare(sigs);
+        engine->set_time_budget(std::chrono::milliseconds(1));
+        auto fork = engine->fork();
+        ScanStats split, streamed;
+        EXPECT_THROW(fork->scan_parallel(data.data(), data.size(), split, 4, 64 * 1024), ScanBudgetExceeded)
+            << engine->name();
+        EXPECT_THROW(stream_in_chunks(*fork, streamed), ScanBudgetExceeded) << engine->name();
+
+        fork->set_time_budget(std::chrono::milliseconds(0));
+        ScanStats whole_split, whole_streamed;
+        fork->scan_parallel(data.data(), data.size(), whole_split, 4, 64 * 1024);
+        stream_in_chunks(*fork, whole_streamed);
+        EXPECT_EQ(whole_split.get("KEY"), all) << engine->name();
+        EXPECT_EQ(whole_streamed.get("KEY"), all) << engine->name();
+    }
+}
+
+// ==========================================
+// 6.12 LEFTMOST-СЧЁТ ПО ОТЧЁТАМ HYPERSCAN (SOM)
+// ==========================================
+
+// What Hyperscan reports for `re` with HS_FLAG_SOM_LEFTMOST: every end offset it matches
+// at, with the leftmost start of a match ending there, in order of end.
+static std::vector<std::pair<size_t, size_t>> som_reports(const std::string& re, const std::string& data) {
+    const boost::regex rx(re);
+    std::vector<std::pair<size_t, size_t>> out; // [from, to)
+    for (size_t to = 1; to <= data.size(); ++to)
+        for (size_t from = 0; from < to; ++from)
+            if (boost::regex_match(data.begin() + from, data.begin() + to, rx)) {
+                out.emplace_back(from, to);
+                break;
+            }
+    return out;
+}
+
+// LeftmostCount over those reports, of the whole pattern or of its head and tail.
+static int leftmost_count(const std::string& pattern, const std::string& data) {
+    LeftmostCount count;
+    count.reset(1);
+    int n = 0;
+    std::string head, tail;
+    if (!LeftmostCount::split(pattern, head, tail)) {
+        for (auto [from, to] : som_reports(pattern, data)) n += count.match(0, from, to);
+        return n;
+    }
+    struct Report {
+        size_t from, to;
+        bool tail;
+    };
+    std::vector<Report> reports;
+    for (auto [from, to] : som_reports(head, data)) reports.push_back({from, to, false});
+    for (auto [from, to] : som_reports(tail, data)) reports.push_back({from, to, true});
+    std::stable_sort(reports.begin(), reports.end(), [](const Report& a, const Report& b) { return a.to < b.to; });
+    for (const auto& r : reports) {
+        if (!r.tail) count.head(0, r.from, r.to);
+        else n += count.tail(0, r.from, r.to);
+    }
+    return n;
+}
+
+TEST(LeftmostCountTest, Counts_From_Match_Ends_Agree_With_Re2_And_Boost) {
+    const std::vector<std::pair<std::string, std::string>> cases = {
+        { "<html.*?</html>", "<html>a</html> <html><html>b</html></html></html> x <html>c</html><html>" },
+        { "key=[0-9]+;", "key=1;key=22;;key=;key=333;key=4" },
+        { "aaa", "aaaaaaa" },
+        { "From:\\s.+\\nTo:", "From: a\nTo: b\nFrom: c\nTo: d" },
+        { "\\x50\\x4B.*?word/document\\.xml", "PK..word/document.xml PK PK word/document.xml word/document.xml" },
+    };
+    for (const auto& [pattern, data] : cases) {
+        const std::vector<SignatureDefinition> sigs = { text_signature("SIG", pattern) };
+        Re2Scanner re2;
+        BoostScanner boost;
+        re2.prepare(sigs);
+        boost.prepare(sigs);
+        ScanStats by_re2, by_boost;
+        re2.scan(data.data(), data.size(), by_re2);
+        boost.scan(data.data(), data.size(), by_boost);
+        EXPECT_EQ(by_boost.get("SIG"), by_re2.get("SIG")) << pattern;
+        EXPECT_EQ(leftmost_count(pattern, data), by_re2.get("SIG")) << pattern;
+    }
+    // One `<html` before three closing tags: three ends reported, one match.
+    const std::string storm = "<html></html></html></html>";
+    EXPECT_EQ(som_reports("<html.*?</html>", storm).size(), 3u);
+    EXPECT_EQ(leftmost_count("<html.*?</html>", storm), 1);
+}
+
+TEST(LeftmostCountTest, Split_Takes_Only_A_Top_Level_Lazy_Gap) {
+    std::string head, tail;
+    ASSERT_TRUE(LeftmostCount::split("<html.*?</html>", head, tail));
+    EXPECT_EQ(head, "<html");
+    EXPECT_EQ(tail, "</html>");
+    ASSERT_TRUE(LeftmostCount::split("\\x50\\x4B\\x03\\x04.*?[Ww]ord/(?:document|styles)\\.xml", head, tail));
+    EXPECT_EQ(head, "\\x50\\x4B\\x03\\x04");
+    EXPECT_EQ(tail, "[Ww]ord/(?:document|styles)\\.xml");
+
+    for (const char* whole : { "(a.*?b)", "a.*?b|c", "[.*?]x", "a\\.*?b", "(?i)a.*?b", "a.*?b+", "a+.*?b", "a.*b" })
+        EXPECT_FALSE(LeftmostCount::split(whole, head, tail)) << whole;
+}
+
 // ==========================================
 // 7. CONFIGLOADER ТЕСТЫ
 // ==========================================
@@ -265,3 +1469,61 @@ TEST_F(ConfigLoaderTest, Deduct_From_Invalid_Ref) {
     ASSERT_EQ(sigs.size(), 1u);
     EXPECT_EQ(sigs[0].deduct_from, "NONEXISTENT");
 }
+
+TEST_F(ConfigLoaderTest, Bounds_Parsed_And_Invalid_Ignored) {
+    WriteTemp(R"([
+        {"name": "A", "hex_head": "AA", "hex_tail": "BB", "max_gap": 100, "min_length": 4, "max_offset": 4096},
+        {"name": "B", "hex_head": "AA", "max_gap": 10},
+        {"name": "C", "type": "text", "text_pattern": "x", "max_offset": -1},
+        {"name": "D", "hex_head": "AA", "text_pattern": "m", "max_gap": 70000}
+    ])");
+    auto sigs = ConfigLoader::load(temp_file.string());
+    ASSERT_EQ(sigs.size(), 4u);
+    EXPECT_EQ(sigs[0].max_gap, 100u);
+    EXPECT_EQ(sigs[0].min_length, 4u);
+    EXPECT_EQ(sigs[0].max_offset, 4096u);
+    EXPECT_EQ(sigs[1].max_gap, 0u);    // no tail or marker to bound
+    EXPECT_EQ(sigs[2].max_offset, 0u); // negative
+    EXPECT_EQ(sigs[3].max_gap, 0u);    // above MAX_GAP
+}
+
+TEST_F(ConfigLoaderTest, Offsets_And_Wildcards_Parsed) {
+    WriteTemp(R"([
+        {"name": "A", "hex_head": "4D5A????50450000", "offset": 0},
+        {"name": "B", "hex_head": "504B0506", "offset": -22},
+        {"name": "C", "hex_head": "AA", "offset": "anywhere"},
+        {"name": "D", "hex_head": "AA", "hex_tail": "BB", "offset": 0},
+        {"name": "E", "hex_head": "AA", "offset": 0, "deduct_from": "C"},
+        {"name": "F", "hex_head": "A?BB", "offset": "start"}
+    ])");
+    auto sigs = ConfigLoader::load(temp_file.string());
+    ASSERT_EQ(sigs.size(), 6u);
+    EXPECT_EQ(sigs[0].hex_head, "4D5A????50450000");
+    EXPECT_EQ(sigs[0].offset, 0);
+    EXPECT_EQ(sigs[1].offset, -22);
+    EXPECT_FALSE(sigs[2].anchored());
+    EXPECT_FALSE(sigs[3].anchored()); // has a tail
+    EXPECT_FALSE(sigs[4].anchored()); // in a deduct_from relation
+    EXPECT_TRUE(sigs[5].hex_head.empty()); // "A?" is not a whole-byte wildcard
+    EXPECT_FALSE(sigs[5].anchored());
+}
+
+TEST_F(ConfigLoaderTest, Tree_Groups_Subtypes_Under_Shared_Magic) {
+    WriteTemp(R"([
+        {"name": "OLE", "hex_head": "D0CF11E0A1B11AE1"},
+        {"name": "DOC", "hex_head": "D0CF11E0A1B11AE1", "text_pattern": "WordDocument", "deduct_from": "OLE"},
+        {"name": "XLS", "hex_head": "d0cf11e0a1b11ae1", "text_pattern": "Workbook", "deduct_from": "OLE"},
+        {"name": "ZIP", "hex_head": "504B0304", "hex_tail": "504B0506"},
+        {"name": "DOCX", "hex_head": "504B0304", "text_pattern": "word/document.xml", "deduct_from": "ZIP"},
+        {"name": "LONE", "hex_head": "CAFE", "text_pattern": "marker"}
+    ])");
+    auto sigs = ConfigLoader::load(temp_file.string());
+    ASSERT_EQ(sigs.size(), 6u);
+    SignatureTree tree = ConfigLoader::build_tree(sigs);
+    ASSERT_EQ(tree.groups.size(), 2u);
+    EXPECT_EQ(tree.group_of, (std::vector<int>{-1, 1, 1, -1, 0, -1}));
+    EXPECT_EQ(tree.groups[0].parent, 3); // ZIP
+    EXPECT_EQ(tree.groups[0].children, (std::vector<uint32_t>{4}));
+    EXPECT_EQ(tree.groups[1].parent, 0); // OLE
+    EXPECT_EQ(tree.groups[1].children, (std::vector<uint32_t>{1, 2}));
+}